@@ -0,0 +1,89 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+// Timing helpers shared by the benchmarks. They run on the host or, built with the NDK, on a device through adb
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+
+#define BENCH_ROUNDS 5
+
+static inline double benchNow() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double) t.tv_sec + (double) t.tv_nsec * 1e-9;
+}
+
+// Keeps the compiler from dropping work whose result is never used
+static inline void benchKeep(const void* p) {
+    __asm__ volatile("" : : "r"(p) : "memory");
+}
+
+// Seconds per call of body, the best of BENCH_ROUNDS rounds. Iterations are doubled until a round takes
+// roundSeconds, so short bodies aren't lost in the clock's resolution
+template <typename Body>
+static double benchSeconds(Body body, double roundSeconds = 0.05) {
+    size_t iterations = 1;
+    for (;;) {
+        double start = benchNow();
+        for (size_t i = 0; i < iterations; i++)
+            body();
+        if (benchNow() - start >= roundSeconds)
+            break;
+        iterations *= 2;
+    }
+
+    double best = 1e30;
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        double start = benchNow();
+        for (size_t i = 0; i < iterations; i++)
+            body();
+        double perCall = (benchNow() - start) / (double) iterations;
+        best = perCall < best ? perCall : best;
+    }
+    return best;
+}
+
+static inline int benchHexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Embedded test vectors are hex strings, returns the number of bytes or -1
+static inline long benchHexDecode(const char* hex, unsigned char* out, size_t max) {
+    size_t size = 0;
+    for (; hex[0] && hex[1]; hex += 2) {
+        int high = benchHexValue(hex[0]), low = benchHexValue(hex[1]);
+        if (high < 0 || low < 0 || size == max)
+            return -1;
+        out[size++] = (unsigned char) (high << 4 | low);
+    }
+    return hex[0] ? -1 : (long) size;
+}
+
+// Whole file into a malloc'ed buffer, NULL on failure
+static inline unsigned char* benchReadFile(const char* path, size_t& size) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+        return NULL;
+
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    unsigned char* data = length >= 0 ? (unsigned char*) malloc((size_t) length + 1) : NULL;
+    if (data != NULL && fread(data, 1, (size_t) length, file) != (size_t) length) {
+        free(data);
+        data = NULL;
+    }
+    fclose(file);
+
+    size = (size_t) length;
+    return data;
+}
+
+#endif // BENCH_H
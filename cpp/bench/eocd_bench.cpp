@@ -0,0 +1,160 @@
+// Locating the EOCD, and the APK Signing Block right before the Central Directory, in copies of an APK given ZIP
+// comments of the maximum 65535 bytes. The comments are filled so as to defeat the scanner's filter as far as possible:
+//  - plain: no byte of the signature
+//  - "PK": every block passes the two-byte filter
+//  - decoys: full EOCD signatures whose comment length doesn't check out, each one restarts the scan
+// The byte-wise scan is the one findEOCDOffset used before, for comparison
+//
+// eocd_bench <apk> [seconds per round]
+
+#include <string.h>
+
+#include "bench.h"
+
+#include "apkview_helper.h"
+#include "unzip_helper.h"
+#include "apksigningblock_helper.h"
+
+#define MAX_COMMENT_SIZE 0xffff
+
+typedef enum {
+    COMMENT_NONE = 0,
+    COMMENT_PLAIN,
+    COMMENT_PK,
+    COMMENT_DECOYS,
+    COMMENT_KIND_COUNT
+} CommentKind;
+
+static const char* COMMENT_NAMES[COMMENT_KIND_COUNT] = { "none", "plain", "\"PK\"", "decoys" };
+
+static void fillComment(unsigned char* comment, size_t size, CommentKind kind) {
+    for (size_t i = 0; i < size; i++) {
+        switch (kind) {
+            case COMMENT_PK:
+                comment[i] = i & 1 ? 'K' : 'P';
+                break;
+            case COMMENT_DECOYS:
+                comment[i] = "PK\x05\x06"[i & 3];
+                break;
+            default:
+                comment[i] = (unsigned char) ('a' + i % 26);
+                break;
+        }
+    }
+}
+
+// One byte at a time from the end, with an unaligned 32-bit load at every position
+static off_t findEOCDOffsetBytewise(const ApkView& view) {
+    off_t offset = view.size - EOCD_SEARCH_SIZE;
+    if (offset < 0) offset = 0;
+
+    size_t size = (size_t) (view.size - offset);
+    const unsigned char* data = acquireApkSpan(view, offset, size);
+    if (data == NULL || size < EOCD_MIN_SIZE)
+        return -1;
+
+    for (size_t pos = size - EOCD_MIN_SIZE + 1; pos-- > 0;) {
+        if (readLE32(data + pos) == EOCD_SIGNATURE && readLE16(data + pos + 20) == size - pos - EOCD_MIN_SIZE)
+            return offset + (off_t) pos;
+    }
+    return -1;
+}
+
+// The APK up to the end of its EOCD, then a comment of the given kind
+static int writeCommentedCopy(const char* path, const unsigned char* apk, size_t eocdEnd, CommentKind kind) {
+    size_t commentSize = kind == COMMENT_NONE ? 0 : MAX_COMMENT_SIZE;
+    unsigned char* copy = (unsigned char*) malloc(eocdEnd + commentSize);
+    if (copy == NULL)
+        return -1;
+
+    memcpy(copy, apk, eocdEnd);
+    copy[eocdEnd - 2] = (unsigned char) commentSize;
+    copy[eocdEnd - 1] = (unsigned char) (commentSize >> 8);
+    fillComment(copy + eocdEnd, commentSize, kind);
+
+    FILE* file = fopen(path, "wb");
+    size_t written = file ? fwrite(copy, 1, eocdEnd + commentSize, file) : 0;
+    if (file)
+        fclose(file);
+    free(copy);
+    return written == eocdEnd + commentSize ? 0 : -1;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <apk> [seconds per round]\n", argv[0]);
+        return 1;
+    }
+    double roundSeconds = argc > 2 ? atof(argv[2]) : 0.05;
+
+    // Where the original EOCD ends, its own comment is dropped
+    MyArena* arena = my_arena_create();
+    ApkView view;
+    if (arena == NULL || openApkView(argv[1], arena, view) < 0) {
+        fprintf(stderr, "Failed to open %s\n", argv[1]);
+        return 1;
+    }
+    off_t eocdOffset = findEOCDOffset(view);
+    closeApkView(view);
+
+    size_t apkSize;
+    unsigned char* apk = benchReadFile(argv[1], apkSize);
+    if (eocdOffset < 0 || apk == NULL) {
+        fprintf(stderr, "No EOCD in %s\n", argv[1]);
+        return 1;
+    }
+    size_t eocdEnd = (size_t) eocdOffset + EOCD_MIN_SIZE;
+
+    const char* tmpDir = getenv("TMPDIR");
+    char path[512];
+    snprintf(path, sizeof(path), "%s/eocd_bench.apk", tmpDir ? tmpDir : "/tmp");
+
+    printf("us per call\n");
+    printf("%-8s %12s %12s %10s %16s\n", "comment", "scan", "byte-wise", "speedup", "+ signing block");
+
+    int failed = 0;
+    for (int kind = 0; kind < COMMENT_KIND_COUNT; kind++) {
+        if (writeCommentedCopy(path, apk, eocdEnd, (CommentKind) kind) < 0 || openApkView(path, arena, view) < 0) {
+            fprintf(stderr, "Failed to write %s\n", path);
+            failed = 1;
+            break;
+        }
+
+        if (findEOCDOffset(view) != eocdOffset || findEOCDOffsetBytewise(view) != eocdOffset) {
+            fprintf(stderr, "%s: EOCD found at %ld and %ld instead of %ld\n", COMMENT_NAMES[kind],
+                    (long) findEOCDOffset(view), (long) findEOCDOffsetBytewise(view), (long) eocdOffset);
+            failed = 1;
+            closeApkView(view);
+            continue;
+        }
+
+        volatile off_t found;
+        double scan = benchSeconds([&] { found = findEOCDOffset(view); }, roundSeconds);
+        double bytewise = benchSeconds([&] { found = findEOCDOffsetBytewise(view); }, roundSeconds);
+        (void) found;
+
+        // Only for APKs signed with v2 or later
+        ApkSigningBlock block;
+        double withBlock = -1;
+        if (openAPKSigningBlock(view, eocdOffset, block) == 0) {
+            withBlock = benchSeconds([&] {
+                ApkSigningBlock opened;
+                openAPKSigningBlock(view, findEOCDOffset(view), opened);
+                benchKeep(&opened);
+            }, roundSeconds);
+        }
+
+        printf("%-8s %12.2f %12.2f %9.1fx ", COMMENT_NAMES[kind], scan * 1e6, bytewise * 1e6, bytewise / scan);
+        if (withBlock < 0)
+            printf("%16s\n", "no v2+ block");
+        else
+            printf("%16.2f\n", withBlock * 1e6);
+
+        closeApkView(view);
+    }
+
+    unlink(path);
+    free(apk);
+    my_arena_destroy(arena);
+    return failed;
+}
@@ -0,0 +1,170 @@
+// Inflate throughput on the META-INF and classes*.dex entries of a real APK, in MB/s of output. Each entry is
+// inflated in one call, streamed through a 32 KiB ring window the way entry digests are checked, and by zlib for
+// reference. Every output is compared with zlib's before anything is timed
+//
+// inflate_bench <apk> [seconds per round]
+
+#include <string.h>
+#include <zlib.h>
+
+#include "bench.h"
+
+#include "apkview_helper.h"
+#include "unzip_helper.h"
+#include "inflate_helper.h"
+
+typedef struct {
+    double oneShot;
+    double streamed;
+    double zlib;
+    size_t bytes;
+} InflateTotals;
+
+static bool hasPrefix(const ZipEntry& entry, const char* prefix) {
+    size_t length = strlen(prefix);
+    return entry.nameLength >= length && memcmp(entry.name, prefix, length) == 0;
+}
+
+static bool isBenchmarked(const ZipEntry& entry) {
+    if (entry.compressionMethod != 8)
+        return false;
+    if (hasPrefix(entry, ZIP_META_INF_PREFIX))
+        return true;
+    return hasPrefix(entry, "classes") && entry.nameLength >= 4 && memcmp(entry.name + entry.nameLength - 4, ".dex", 4) == 0;
+}
+
+static int zlibInflate(uint8_t* dst, size_t dstSize, const uint8_t* src, size_t srcSize) {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+        return -1;
+
+    stream.next_in = (Bytef*) src;
+    stream.avail_in = (uInt) srcSize;
+    stream.next_out = dst;
+    stream.avail_out = (uInt) dstSize;
+    int ret = inflate(&stream, Z_FINISH);
+    inflateEnd(&stream);
+    return ret == Z_STREAM_END && stream.total_out == dstSize ? 0 : -1;
+}
+
+// Output only goes through the window, a running sum stands in for the digest
+static uint64_t streamInflate(InflateStream* stream, uint8_t* window, const uint8_t* src, size_t srcSize, size_t& produced) {
+    inflateStreamInit(stream, window, INFLATE_WINDOW_SIZE, true);
+    inflateStreamInput(stream, src, srcSize, true);
+
+    uint64_t sum = 0;
+    produced = 0;
+    InflateResult ret;
+    do {
+        const uint8_t* out;
+        size_t outLen;
+        ret = inflateStreamNext(stream, &out, &outLen);
+        if (outLen)
+            sum += out[0] + out[outLen - 1];
+        produced += outLen;
+    } while (ret == INFLATE_OK);
+
+    return ret == INFLATE_END ? sum : (uint64_t) -1;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <apk> [seconds per round]\n", argv[0]);
+        return 1;
+    }
+    double roundSeconds = argc > 2 ? atof(argv[2]) : 0.05;
+
+    MyArena* arena = my_arena_create();
+    ApkView view;
+    ZipIndex index;
+    off_t eocdOffset;
+    if (arena == NULL || openApkView(argv[1], arena, view) < 0) {
+        fprintf(stderr, "Failed to open %s\n", argv[1]);
+        return 1;
+    }
+    if ((eocdOffset = findEOCDOffset(view)) < 0 || buildZipIndex(view, eocdOffset, index) < 0) {
+        fprintf(stderr, "Failed to index %s\n", argv[1]);
+        return 1;
+    }
+
+    InflateStream* stream = (InflateStream*) malloc(sizeof(InflateStream));
+    uint8_t* window = (uint8_t*) malloc(INFLATE_WINDOW_SIZE);
+    if (stream == NULL || window == NULL)
+        return 1;
+
+    printf("MB/s of inflated output\n");
+    printf("%-40s %10s %10s %10s %10s %10s\n", "entry", "size", "ratio", "one-shot", "streamed", "zlib");
+
+    InflateTotals totals = {};
+    int failed = 0;
+    for (size_t i = 0; i < index.count; i++) {
+        const ZipEntry& entry = index.entries[i];
+        if (!isBenchmarked(entry) || entry.uncompressedSize == 0)
+            continue;
+
+        off_t dataOffset = getLocalFileDataOffset(view, entry);
+        const uint8_t* src = dataOffset < 0 ? NULL : acquireApkSpan(view, dataOffset, entry.compressedSize);
+        uint8_t* expected = (uint8_t*) malloc(entry.uncompressedSize);
+        uint8_t* dst = (uint8_t*) malloc(entry.uncompressedSize);
+        size_t srcSize = entry.compressedSize, dstSize = entry.uncompressedSize;
+        if (src == NULL || expected == NULL || dst == NULL || zlibInflate(expected, dstSize, src, srcSize) < 0) {
+            fprintf(stderr, "%.*s: unreadable\n", (int) entry.nameLength, entry.name);
+            failed = 1;
+            free(expected);
+            free(dst);
+            continue;
+        }
+
+        size_t outLen = dstSize, streamed;
+        uint64_t streamSum = streamInflate(stream, window, src, srcSize, streamed);
+        if (inflate(dst, &outLen, src, srcSize) != INFLATE_OK || outLen != dstSize || memcmp(dst, expected, dstSize) != 0
+            || streamSum == (uint64_t) -1 || streamed != dstSize) {
+            fprintf(stderr, "%.*s: output doesn't match zlib's\n", (int) entry.nameLength, entry.name);
+            failed = 1;
+            free(expected);
+            free(dst);
+            continue;
+        }
+
+        double oneShot = benchSeconds([&] {
+            size_t len = dstSize;
+            inflate(dst, &len, src, srcSize);
+            benchKeep(dst);
+        }, roundSeconds);
+        double streamTime = benchSeconds([&] {
+            size_t produced;
+            volatile uint64_t sum = streamInflate(stream, window, src, srcSize, produced);
+            (void) sum;
+        }, roundSeconds);
+        double zlib = benchSeconds([&] {
+            zlibInflate(dst, dstSize, src, srcSize);
+            benchKeep(dst);
+        }, roundSeconds);
+
+        printf("%-40.*s %10zu %9.1fx %10.0f %10.0f %10.0f\n", (int) (entry.nameLength < 40 ? entry.nameLength : 40), entry.name,
+               dstSize, (double) dstSize / (double) srcSize, dstSize / oneShot / 1e6, dstSize / streamTime / 1e6, dstSize / zlib / 1e6);
+
+        totals.oneShot += oneShot;
+        totals.streamed += streamTime;
+        totals.zlib += zlib;
+        totals.bytes += dstSize;
+
+        free(expected);
+        free(dst);
+    }
+
+    if (totals.bytes) {
+        printf("%-40s %10zu %10s %10.0f %10.0f %10.0f\n", "total", totals.bytes, "",
+               totals.bytes / totals.oneShot / 1e6, totals.bytes / totals.streamed / 1e6, totals.bytes / totals.zlib / 1e6);
+    } else {
+        fprintf(stderr, "No deflated META-INF or classes*.dex entries in %s\n", argv[1]);
+        failed = 1;
+    }
+
+    free(stream);
+    free(window);
+    closeApkView(view);
+    my_arena_destroy(arena);
+    return failed;
+}
@@ -0,0 +1,158 @@
+// Looking up the APK of a package in a synthetic 10,000 line /proc/self/maps, the size of a big app's. Compared with
+// the old way of copying every line into a string and tokenizing a copy of it, and with just reading the file
+//
+// maps_bench [lines] [seconds per round]
+
+#include <string.h>
+#include <string>
+
+#include "bench.h"
+
+#include "path_helper.h"
+
+#define PACKAGE_NAME "com.example.app"
+#define APK_PATH "/data/app/~~Qm9vZ2xlUGxheQ==/" PACKAGE_NAME "-dGhpcyBpcyBmaW5l==/base.apk"
+
+typedef enum {
+    APK_LAST = 0, // The app's own mapping comes after everything else
+    APK_ABSENT,   // Every line is looked at
+    APK_PLACEMENT_COUNT
+} ApkPlacement;
+
+static const char* PLACEMENT_NAMES[APK_PLACEMENT_COUNT] = { "last line", "absent" };
+
+// What a big app maps: anonymous regions, libraries, framework APKs and jars, another package's APK
+static const char* const PATHS[] = {
+    "",
+    "[anon:dalvik-main space (region space)]",
+    "[anon:libc_malloc]",
+    "/system/lib64/libc.so",
+    "/apex/com.android.art/lib64/libart.so",
+    "/system/framework/framework-res.apk",
+    "/system/framework/arm64/boot-framework.oat",
+    "/data/app/~~c29tZXRoaW5n==/" PACKAGE_NAME "x-b3RoZXI==/base.apk",
+    "/dev/__properties__/u:object_r:vendor_default_prop:s0",
+    "/data/dalvik-cache/arm64/system@framework@services.jar@classes.dex",
+};
+
+static int writeMaps(const char* path, size_t lines, ApkPlacement placement) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL)
+        return -1;
+
+    unsigned long address = 0x12c00000UL;
+    for (size_t i = 0; i < lines; i++) {
+        bool isApk = placement == APK_LAST && i == lines - 1;
+        const char* mapped = isApk ? APK_PATH : PATHS[(i * 7) % (sizeof(PATHS) / sizeof(PATHS[0]))];
+        unsigned long size = 4096UL << (i % 5);
+        bool isFile = mapped[0] == '/';
+        int written = fprintf(file, "%lx-%lx %s %08lx %s %lu", address, address + size, i % 3 ? "r--p" : "r-xp",
+                              isFile ? (unsigned long) (i % 11) * 4096 : 0, isFile ? "fd:05" : "00:00", isFile ? 1000 + i : 0);
+        // Like the kernel, names are padded to the same column
+        if (mapped[0])
+            fprintf(file, "%*s%s", written < 73 ? 73 - written : 1, "", mapped);
+        fputc('\n', file);
+        address += size + 4096;
+    }
+
+    return fclose(file);
+}
+
+// The old scan: each line is gathered into a string, then a copy of it is tokenized to get at the path. The package
+// is looked for as "/<package>-" so that both scans agree on which lines match
+static bool lineCopyScan(int fd, const char* packageName) {
+    std::string directory = std::string("/") + packageName + "-";
+    char buffer[MAPS_BUFFER_SIZE];
+    std::string line;
+    ssize_t bytes;
+    bool found = false;
+
+    while (!found && (bytes = read(fd, buffer, sizeof(buffer))) > 0) {
+        for (ssize_t i = 0; i < bytes && !found; i++) {
+            if (buffer[i] != '\n') {
+                line.push_back(buffer[i]);
+                continue;
+            }
+
+            char* copy = strdup(line.c_str());
+            char* save;
+            char* token = strtok_r(copy, " ", &save);
+            for (int field = 0; token != NULL && field < 5; field++)
+                token = strtok_r(NULL, " ", &save);
+
+            if (token != NULL && strstr(token, directory.c_str()) != NULL) {
+                const char* dot = strrchr(token, '.');
+                found = dot != NULL && strcasecmp(dot, ".apk") == 0;
+            }
+            free(copy);
+            line.clear();
+        }
+    }
+    return found;
+}
+
+static size_t readAll(int fd) {
+    char buffer[MAPS_BUFFER_SIZE];
+    size_t total = 0;
+    ssize_t bytes;
+    while ((bytes = read(fd, buffer, sizeof(buffer))) > 0)
+        total += (size_t) bytes;
+    return total;
+}
+
+int main(int argc, char** argv) {
+    size_t lines = argc > 1 ? (size_t) atol(argv[1]) : 10000;
+    double roundSeconds = argc > 2 ? atof(argv[2]) : 0.05;
+
+    const char* tmpDir = getenv("TMPDIR");
+    char path[512];
+    snprintf(path, sizeof(path), "%s/maps_bench.txt", tmpDir ? tmpDir : "/tmp");
+
+    printf("%zu lines, us per lookup\n", lines);
+    printf("%-10s %12s %16s %12s %10s\n", "apk", "in place", "line copy (old)", "read only", "speedup");
+
+    int failed = 0;
+    for (int placement = 0; placement < APK_PLACEMENT_COUNT; placement++) {
+        int fd;
+        if (writeMaps(path, lines, (ApkPlacement) placement) != 0 || (fd = open(path, O_RDONLY)) < 0) {
+            fprintf(stderr, "Failed to write %s\n", path);
+            return 1;
+        }
+
+        // The in place scan only allocates the path it returns, one arena serves every run
+        MyArena* arena = my_arena_create();
+        bool expected = placement == APK_LAST;
+        lseek(fd, 0, SEEK_SET);
+        char* found = getApkPathFromMapsFd(arena, fd, PACKAGE_NAME);
+        lseek(fd, 0, SEEK_SET);
+        if ((found != NULL) != expected || (found != NULL && strcmp(found, APK_PATH) != 0)
+            || lineCopyScan(fd, PACKAGE_NAME) != expected) {
+            fprintf(stderr, "%s: wrong result %s\n", PLACEMENT_NAMES[placement], found ? found : "(none)");
+            failed = 1;
+        }
+
+        double inPlace = benchSeconds([&] {
+            lseek(fd, 0, SEEK_SET);
+            benchKeep(getApkPathFromMapsFd(arena, fd, PACKAGE_NAME));
+        }, roundSeconds);
+        double lineCopy = benchSeconds([&] {
+            lseek(fd, 0, SEEK_SET);
+            volatile bool result = lineCopyScan(fd, PACKAGE_NAME);
+            (void) result;
+        }, roundSeconds);
+        double readOnly = benchSeconds([&] {
+            lseek(fd, 0, SEEK_SET);
+            volatile size_t total = readAll(fd);
+            (void) total;
+        }, roundSeconds);
+
+        printf("%-10s %12.1f %16.1f %12.1f %9.1fx\n", PLACEMENT_NAMES[placement],
+               inPlace * 1e6, lineCopy * 1e6, readOnly * 1e6, lineCopy / inPlace);
+
+        my_arena_destroy(arena);
+        close(fd);
+    }
+
+    unlink(path);
+    return failed;
+}
@@ -0,0 +1,63 @@
+// mylibc memory and string functions against the C library (bionic on a device, glibc on the host) over a sweep of
+// sizes, in nanoseconds per call. Buffers start misaligned by the given number of bytes
+//
+// mylibc_bench [misalignment] [seconds per round]
+
+#include <string.h>
+
+#include "bench.h"
+
+#include "mylibc.h"
+
+#define MAX_SIZE (1024 * 1024)
+
+static const size_t SIZES[] = { 1, 3, 7, 8, 15, 16, 31, 32, 63, 64, 100, 255, 256, 1024, 4096, 16384, 65536, MAX_SIZE };
+
+int main(int argc, char** argv) {
+    size_t misalignment = argc > 1 ? (size_t) atoi(argv[1]) % 64 : 0;
+    double roundSeconds = argc > 2 ? atof(argv[2]) : 0.02;
+
+    // Two copies of the same bytes so that compares run to the end, with no zero byte before the terminator
+    unsigned char* a = (unsigned char*) malloc(MAX_SIZE + 128);
+    unsigned char* b = (unsigned char*) malloc(MAX_SIZE + 128);
+    if (a == NULL || b == NULL)
+        return 1;
+    for (size_t i = 0; i < MAX_SIZE + 128; i++)
+        a[i] = b[i] = (unsigned char) (i % 255 + 1);
+
+    unsigned char* src = a + misalignment;
+    unsigned char* dst = b + misalignment;
+
+    printf("misalignment %zu, ns per call, mylibc / libc\n", misalignment);
+    printf("%8s %18s %18s %18s %18s\n", "size", "memcpy", "memset", "memcmp", "strlen");
+
+    for (size_t size : SIZES) {
+        double myCopy = benchSeconds([&] { my_memcpy(dst, src, size); benchKeep(dst); }, roundSeconds);
+        double copy = benchSeconds([&] { memcpy(dst, src, size); benchKeep(dst); }, roundSeconds);
+
+        double mySet = benchSeconds([&] { my_memset(dst, 0x5a, size); benchKeep(dst); }, roundSeconds);
+        double set = benchSeconds([&] { memset(dst, 0x5a, size); benchKeep(dst); }, roundSeconds);
+        my_memcpy(dst, src, size);
+
+        volatile int compared;
+        double myCompare = benchSeconds([&] { benchKeep(src); compared = my_memcmp(dst, src, size); }, roundSeconds);
+        double compare = benchSeconds([&] { benchKeep(src); compared = memcmp(dst, src, size); }, roundSeconds);
+
+        // src is a string of exactly size bytes for the duration
+        unsigned char saved = src[size];
+        src[size] = '\0';
+        volatile size_t length;
+        double myLength = benchSeconds([&] { benchKeep(src); length = my_strlen((const char*) src); }, roundSeconds);
+        double libcLength = benchSeconds([&] { benchKeep(src); length = strlen((const char*) src); }, roundSeconds);
+        src[size] = saved;
+        (void) compared;
+        (void) length;
+
+        printf("%8zu %8.1f / %-7.1f %8.1f / %-7.1f %8.1f / %-7.1f %8.1f / %-7.1f\n", size,
+               myCopy * 1e9, copy * 1e9, mySet * 1e9, set * 1e9, myCompare * 1e9, compare * 1e9, myLength * 1e9, libcLength * 1e9);
+    }
+
+    free(a);
+    free(b);
+    return 0;
+}
@@ -0,0 +1,159 @@
+// RSA verification at the key sizes APKs are signed with: parsing the public key, which includes R^2 mod n, and
+// PKCS#1 v1.5 and PSS verification with SHA-256 and e = 65537
+//
+// rsa_bench [seconds per round]
+
+#include "bench.h"
+
+#include "rsa_helper.h"
+
+// Signatures of SHA-256("droidgrity"), PSS with a 32-byte salt
+typedef struct {
+    const char* name;
+    const char* publicKey;
+    const char* pkcs1Signature;
+    const char* pssSignature;
+} RsaVector;
+
+static const RsaVector VECTORS[] = {
+    {
+        "RSA-2048",
+        // RSAPublicKey
+        "3082010a0282010100988acefa203a9ce3cabfa655b640202be27f6639e50708423ae64e3ccc18aa908fb4728b47dd1b31300253b1f78222"
+        "3b16c48ddf637b6c1610ac9e54abc440612c748a27fc44a7cc5d9f659803ef100204e90b67640209864bd545f39a61f91b0809c7eabe5610"
+        "03f3cf728ac3757b8ce370084dd518b62318fb9f0e5c728430c58d69a1b71f2d2d914ae5a4c107df33d70ad8b5cfd3ea412f7fee19f6d409"
+        "c0926d4682a9c7d8c9a90456cb3876125f0e3f01dc16039c2ecbf4d0e9a557dd05309ac371b692026c12bda130f2b47e1c59ab9663358b79"
+        "d32c4715da417c2ee7f2eed20a72acd6ecc400b1e89dc004a3695433c905c7ce6fd6a089a71bacf4cf0203010001",
+        // PKCS#1 v1.5 signature
+        "5940d46eea18d995a9363a39e357aa0644bf0c0bf49b4377bf7452426ed841c5bcc646558b7b213e77621d2d7b695e18d59578a87437a7f7"
+        "138c167ea09592b81736d68cad7853d5fe99dcd8c4d70bbba9906b4b88788cc1c96b8d5b65f5216f0831443d29d54590801b0e9c1159a9f1"
+        "86191577396f2514f1b7c8bc11a4205e715c3eb354bb49b12b01a0806fc34ceb40b2bd8b6701e3bf143af8881b3c66c851c637f73a95ab26"
+        "333e3b9b96b8774445d599d8d9716b0d76c369b5ccf1b69c61c1131bd00d114297f4f76fee409a4213da250d302fe059e82012881b3e5e83"
+        "70e5773c3ead0ea2d5721be0970f3898f87ec9e4efd158f4b0fe81c13a4ed6ae",
+        // PSS signature
+        "110465b0a67c1472ee09789f0049f0acc68bcf860395d1f0e6bb8243e37ed9ff4c0d2c04e0388b27babf29ca740d7b50661551856f91d601"
+        "2d3de76a37c83246a85e695f2dd98c44369d81e18bf49ee45e0138fa7d7176fbfdc8bf9e1c778dd4560ec0ba748824ff5b3ce74cf47b0556"
+        "f82b0de12f5dce1f072da234f523f14bededd1acb74cc327e6439d7d1cc8a0d4b9260fcc083ace7698aaeef024f22f9cf0d38ea8e614cc09"
+        "195d76913536de5e5a4502aefdd82411b323388c57f612a26204c370ebab6fc3c0776ee61daa103c3b1d9c131acc05350754d64242e07f7f"
+        "dc113fdbc2dbee793fe76684b44cc3d0588ac2e3c3f789935038f02c261e7e42",
+    },
+    {
+        "RSA-3072",
+        // RSAPublicKey
+        "3082018a0282018100ab3c494ccbc4f6b3b0a9d07c8c9da34ad78c4b1ad8a12f3b0bf81a191b34ff0b3176194ef452c1efe273be79491801"
+        "b077e43321989fe46500f30895a8748f81c2a2373d3511660651266d1cf2771296c8d82e0e5424f80c39a69a6e7d5dd263a2e029ba3f1d3c"
+        "4c82fbdc13fe80a506690410aaafab421dada74811aa45a77a6686430f3517baaff61413a38b45f118e5f240f3948bbc1cd24200b052a387"
+        "7686cf3539b880dbe56b90016073f7a5f55b5f90943e3600888dc717a778a7ec70c468beb2d5d26a39228dbdb8496538f82eab0318855950"
+        "f5cd8c22d8c3e1e2883402b6eb6c90d04b4491b29b5359a9b536d98456193fc45ce1699d3db7a8f33494bf9c21fbddede48b6019ea367c3f"
+        "9795cbe09cf991c89d0620b731a6ecf68e999d008465f4b9dc5202d79aa952986f9fa05202e7878abda98ac19b93f12cda919ad0aa2b9e42"
+        "fabe3d7e72b8c89517649289b23fcc82d3ece868e1d78fb162fb14ebfe9a5a595cc413eacfb4931d41fbbff2f812dd75186bdd7245a409d3"
+        "4b0203010001",
+        // PKCS#1 v1.5 signature
+        "57cd53b292725eeb81502f023b98f9ca945b64a1f946800b14f945ec75c58a5c685cd87b5acc49fa1aea49ae4aec2b3a51ea05b6753af986"
+        "ae4c5216cb8eece43ead931de47105bdb0868e6ea2360991dc11bccd19f3f5983d266977186cb5b6018fd95f5816871318437cb8e61dd57b"
+        "386338568e79a8da1f832876ad29fb842f66c837bafd33348e25df00f905aeb2fa603a783ac67d789de7bf4afe1e775d0ca15cacc8986fb9"
+        "8b39ce0894ad5f0c603a8218ea5c6d87ea09a65d91bb612c76d2a1dc96d59234bba2e13437b851750dc717b05ebd98b4afe27bf11968162e"
+        "b5cf4b31808500f3f057a1360dc8d689d0cc2addeb87bfa0beedab6d5b1352b40c80ab1915e29a7e4805982a5f08e105b43e79403646274c"
+        "485acdce115d86fa7e9cbb2a28798fcbfdd6af52e0e1830af186326f21ac5c9456c5980df0ab49e056e0943d3f6d17cb824cb3696b00f4fe"
+        "0b54a4f17ae0b2cf182264bd38c79f2acd3029c8f17dd308d7f4b24a64b13b72bad36caafc08d886d1b962cbf7b50726",
+        // PSS signature
+        "82c5ca4d0f3e4b36d0fd82ff75d21ed342efa4a747eebd2c408ee34cccdce1381cb198006a88d1b872bbe86a1953dd7c3c73dfaa63e47d7b"
+        "78450ce9aca06891a59812f637f5cee1e5c9b52c65f2300a4091f6c34f8543d97d5b2c465ecd658b4c13fe96f2df53d5b94186249b85ce6f"
+        "50cfe8a8c6f0d719e4f2cd29188c2722b2bce3b5f92ba4a333971a94b363d83d8649245e93c04e7d556be11fe55d1f016c5a6ab07b9efbc9"
+        "7441ced5d17658e94d51f16df6fcc4cea334fbc3001e123cc325771cd2998731953de0d03c3fafa81f937bf986322f2cd35ef81fe89d2b0b"
+        "8e21ff3bd74607e88ec9f2351db820c4292049263ab4dd760da7df281d4f6a5bf7d0330fad7bab4a78b6c543b17b59a21bf2a524956a2def"
+        "21d7af8b80172f98b38fce54c9e4158f35f983b092deb39cbd7a4bb9f2d22f503e15d6d97916807a78e7310d3e065d5deaf106efaadf2bcb"
+        "8a9602fc016fcdd9e612f997548021d7e75b7cf244f2ff4d29d2987e41765090abb4e42ae07f0c20c6f7b57fdc5ff98e",
+    },
+    {
+        "RSA-4096",
+        // RSAPublicKey
+        "3082020a02820201009fe18c9622240d652db2be716d86388448f9f29cbe2dcc61f2d20a59e61ed6009e97f7d995c73020deb81c8339de16"
+        "7765266d2677bb43341ca953e092527f8ce0e26e02b7880bbb008eba240c83d3bca8660cee8e837900275e16e5bd8cf56a5c8c5f43a26502"
+        "df0ea56b07ed470a83e0224045159571472ac049686686f6cf0dde6d3c527c9db929b8cdf42b66243aaa391e9394c1e5182d1e68898ff4f7"
+        "c96d873b309e407248c8f152ebaf71dd69f6783ab73d8a4a9f1d616a87fb291180089794125a5ede9eff8dbb9739b48651e9efd5c5d35e6d"
+        "d4e48c92325f8a78a95d51fa27d4d81ecef94f94066e2bc19a5d1e0caec16a4376e3a5336d0c285c9be0d571ea206c7263ffedbe59d41ec0"
+        "77de8237546b97242088162ee6d01fb2f24db4b136b44439d736d3ed4018ea47dfcb2de2ea1e974d43c746ae443f72ad09d58ffc6b615bfc"
+        "0dd33046df807145cc128f3a206375a34a315b6000672956b57abadf174defad49e88942fd5565ce393090dba164827746d82ac21a4606cb"
+        "8c8b902d3c52d2044ebdca2e5fdf08cbc7b53c3814bf380fc115f51e5dbbcb930e31c5ba84709ef34528ea9656bf7aa4a28cd18236ab6cc6"
+        "64114833c8633e321aabce272e286e030e5d6bf0ad6871a98966de280522c2865a002be7b98f4505524ea4944396cd6a692dc5ead1bd91a7"
+        "3064bff0a0c3dfd94dce3b0700ac9b3b150203010001",
+        // PKCS#1 v1.5 signature
+        "592437a00888fd2bf8f8653615723b1efe82743aaeaa437b6ad69d2276fc6e20ffe7587a9fe0c663eb22850637b705581f57a73a4dbecd9f"
+        "71d6f5769d3c9cd16a158ee36b584631eb65dab0f73289f96ed9dbd74fef8ba9415db180026cb6c39d66048e58fa9e48a1ed9573c223d31d"
+        "36706c12a5dda49c6611cd0ff1626aa3dee0728a2958782d94f57bb2723e9da7a39091d0173fc2742239abfb02154e02ed927567c7ceae36"
+        "a07aca2378973971f3743ac5d32da97b8ed072f18341a6bd39452de5cd4d202111e4f02786f1e9d6ce47ae928f2a4cdf95a7a5d539507e83"
+        "9bf34fa503846c95b3e2731151969211228fa62c9d0d6c5fb3c85170e574c237af6f0291825bfa3b90bfeeec09de383fc5124c7352a63083"
+        "5ce340133a0c0c84fbf0177c0f3e06423d0a78717e164198acec8761bcb1d52c22f41407263dfb16cef3490839edca3dad8cb16625e82996"
+        "842c6d781eb82202b3d00f6205fd9f4b307da6ce237353f965b84214e5adca01ea87a4acbf8052a6eaac0074fb71acd3fabab30516177408"
+        "cfc61317d924403772651205adf23012b9fee49d3d4064a13dae4f2a17c5c0720656a2ea95a76a6dc8e201521f3c65421b723d270a8c27bf"
+        "9eaae2212ca5d1e4b134b6df1d23b8be9e48056d4063c1fc86d95c4c7e6e4610ed42380aaff341c1a597c0eedee9cbdd262707963f169caf"
+        "982c1844ffa46269",
+        // PSS signature
+        "7caa60fdacdf998159d35fcb4ff3cf36f7966fffafbf0b318a975ac06415e53d1d0443ed3179335b4d630b21801f33d6b64d6a0560626fea"
+        "82325127790df98e2279592ad22337b521d6d9a6dfa368de915d6cd993062b91491fcd7fb8eea93b9d5eb885e1cb7a27dd3836942effa82a"
+        "c118a3243790d8acdd7183dffcce14150469ec91701060a046ab468ce107c889b788f440b21c23c3fc4223e03f5be594cd79cbfb852683f4"
+        "35d88330a6b469c7a858c74ebec5388898ceaa940eef958e41624a98f6af997df21503f8c90c0daea6d0363fd59b22e75021cebe1c4e7c4f"
+        "ccae91fe749198e1295d7868702c25cb80bd0730e0918b1a108ee18cabd5de1220021b4e386faf23881715566a6937758ef03b6e46c3993b"
+        "f30a4efefe9d2e27b20126296d058086c7ded04b75a8fd27ae9aaf71a88a756ab4f0f2f0736f44ca1a14ead96c9ce3e18473971189f8b9b7"
+        "6475cb7fd09739d45fbd218b2f7eda4300f6a287774ac1912360e92121bc0aee3b0c67db1f76a944093e98666071a6ac70bf588a5cba3ec3"
+        "73ade679609586f1be921f421fec14629469ca2a056e82ab71eeecbbc37fb3b4476a7e7d4f98f054ff3a66dc04be49eac0bef537f1ebb07f"
+        "5931ddb62ac97db477648a65708eca1c89749ab7613de3844d21ecc8b1d219a569fe5b026f1942aaea8cae5eded7c5f96d7b2953827707c0"
+        "7bafe9b724804dcc",
+    },
+};
+
+static const char MESSAGE[] = "droidgrity";
+
+int main(int argc, char** argv) {
+    double roundSeconds = argc > 1 ? atof(argv[1]) : 0.05;
+
+    unsigned char digest[SHA256_BYTES_SIZE];
+    sha256_bytes((const unsigned char*) MESSAGE, sizeof(MESSAGE) - 1, digest);
+
+    printf("%-9s %12s %14s %12s %14s\n", "key", "parse (us)", "pkcs1 (us)", "pss (us)", "pkcs1 (op/s)");
+
+    int failed = 0;
+    for (const RsaVector& vector : VECTORS) {
+        unsigned char der[RSA_MAX_BITS / 8 + 32], pkcs1[RSA_MAX_BITS / 8], pss[RSA_MAX_BITS / 8];
+        long derSize = benchHexDecode(vector.publicKey, der, sizeof(der));
+        long pkcs1Size = benchHexDecode(vector.pkcs1Signature, pkcs1, sizeof(pkcs1));
+        long pssSize = benchHexDecode(vector.pssSignature, pss, sizeof(pss));
+
+        static RsaPublicKey key;
+        if (derSize < 0 || pkcs1Size < 0 || pssSize < 0 || parseRsaPublicKey(der, (size_t) derSize, key) < 0) {
+            fprintf(stderr, "%s: invalid test vector\n", vector.name);
+            return 1;
+        }
+
+        // Timings only mean something for signatures that verify, and a flipped bit must still be caught
+        int pkcs1Ok = verifyRsaPkcs1Signature(key, RSA_HASH_SHA256, digest, pkcs1, (size_t) pkcs1Size);
+        int pssOk = verifyRsaPssSignature(key, RSA_HASH_SHA256, digest, pss, (size_t) pssSize);
+        pkcs1[pkcs1Size / 2] ^= 1;
+        int tamperedOk = verifyRsaPkcs1Signature(key, RSA_HASH_SHA256, digest, pkcs1, (size_t) pkcs1Size);
+        pkcs1[pkcs1Size / 2] ^= 1;
+        if (pkcs1Ok != 0 || pssOk != 0 || tamperedOk == 0) {
+            fprintf(stderr, "%s: pkcs1 %d, pss %d, tampered %d\n", vector.name, pkcs1Ok, pssOk, tamperedOk);
+            failed = 1;
+            continue;
+        }
+
+        static RsaPublicKey parsed;
+        double parse = benchSeconds([&] {
+            parseRsaPublicKey(der, (size_t) derSize, parsed);
+            benchKeep(&parsed);
+        }, roundSeconds);
+        double pkcs1Time = benchSeconds([&] {
+            volatile int result = verifyRsaPkcs1Signature(key, RSA_HASH_SHA256, digest, pkcs1, (size_t) pkcs1Size);
+            (void) result;
+        }, roundSeconds);
+        double pssTime = benchSeconds([&] {
+            volatile int result = verifyRsaPssSignature(key, RSA_HASH_SHA256, digest, pss, (size_t) pssSize);
+            (void) result;
+        }, roundSeconds);
+
+        printf("%-9s %12.1f %14.1f %12.1f %14.0f\n", vector.name, parse * 1e6, pkcs1Time * 1e6, pssTime * 1e6, 1 / pkcs1Time);
+    }
+
+    return failed;
+}
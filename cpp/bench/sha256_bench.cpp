@@ -0,0 +1,86 @@
+// SHA-256 throughput in MB/s, three ways over the same buffers:
+//  - byte loop: every byte goes through the 64-byte buffer, the way sha256_append used to work
+//  - bulk scalar: whole blocks compressed straight from the input with the portable kernel
+//  - bulk: sha256_bytes with the kernel picked for this CPU (SHA-NI, ARMv8 Crypto Extensions or scalar)
+//
+// sha256_bench [seconds per round]
+
+#include <string.h>
+
+#include "bench.h"
+
+#include "sha256_helper.h"
+
+static const size_t SIZES[] = { 64, 1024, 4096, 64 * 1024, 1024 * 1024, 16 * 1024 * 1024 };
+
+// The old sha256_append, one byte at a time into the buffer and a block compressed each time it fills up
+static void sha256ByteLoop(const uint8_t* data, size_t size, uint8_t* digest) {
+    struct sha256 sha;
+    sha256_init(&sha);
+    for (size_t i = 0; i < size; i++) {
+        sha.buffer[sha.buffer_counter++] = data[i];
+        sha.n_bits += 8;
+        if (sha.buffer_counter == 64) {
+            sha.buffer_counter = 0;
+            sha256_block_scalar(sha.state, sha.buffer, 1);
+        }
+    }
+    sha256_finalize_bytes(&sha, digest);
+}
+
+// Sizes are whole blocks, so the rest of the message is only padding
+static void sha256BulkScalar(const uint8_t* data, size_t size, uint8_t* digest) {
+    struct sha256 sha;
+    sha256_init(&sha);
+    sha256_block_scalar(sha.state, data, size / 64);
+    sha.n_bits = (uint64_t) size << 3;
+    sha256_finalize_bytes(&sha, digest);
+}
+
+static const char* kernelName() {
+    sha256_block_fn fn = sha256_get_block_fn();
+#if defined(__aarch64__)
+    if (fn == sha256_block_armv8) return "armv8";
+#elif defined(__x86_64__) || defined(__i386__)
+    if (fn == sha256_block_shani) return "shani";
+#endif
+    return fn == sha256_block_scalar ? "scalar" : "unknown";
+}
+
+int main(int argc, char** argv) {
+    double roundSeconds = argc > 1 ? atof(argv[1]) : 0.05;
+
+    size_t maxSize = SIZES[sizeof(SIZES) / sizeof(SIZES[0]) - 1];
+    uint8_t* data = (uint8_t*) malloc(maxSize);
+    if (data == NULL)
+        return 1;
+    for (size_t i = 0; i < maxSize; i++)
+        data[i] = (uint8_t) (i * 131 + (i >> 9));
+
+    printf("MB/s, bulk uses the %s kernel\n", kernelName());
+    printf("%10s %12s %12s %12s %10s\n", "size", "byte loop", "bulk scalar", "bulk", "speedup");
+
+    int failed = 0;
+    for (size_t size : SIZES) {
+        uint8_t expected[SHA256_BYTES_SIZE], scalar[SHA256_BYTES_SIZE], bulk[SHA256_BYTES_SIZE];
+        sha256ByteLoop(data, size, expected);
+        sha256BulkScalar(data, size, scalar);
+        sha256_bytes(data, size, bulk);
+        if (memcmp(expected, scalar, sizeof(expected)) != 0 || memcmp(expected, bulk, sizeof(expected)) != 0) {
+            fprintf(stderr, "Digests of %zu bytes don't match\n", size);
+            failed = 1;
+            continue;
+        }
+
+        uint8_t digest[SHA256_BYTES_SIZE];
+        double byteLoop = benchSeconds([&] { sha256ByteLoop(data, size, digest); benchKeep(digest); }, roundSeconds);
+        double bulkScalar = benchSeconds([&] { sha256BulkScalar(data, size, digest); benchKeep(digest); }, roundSeconds);
+        double bulkBest = benchSeconds([&] { sha256_bytes(data, size, digest); benchKeep(digest); }, roundSeconds);
+
+        printf("%10zu %12.0f %12.0f %12.0f %9.1fx\n", size,
+               size / byteLoop / 1e6, size / bulkScalar / 1e6, size / bulkBest / 1e6, byteLoop / bulkBest);
+    }
+
+    free(data);
+    return failed;
+}
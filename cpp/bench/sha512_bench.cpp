@@ -0,0 +1,59 @@
+// SHA-512 throughput in MB/s next to SHA-256, to see which content digest is cheaper on this CPU. SHA-256 is shown
+// with the portable kernel and with the one picked for this CPU, SHA-512 only has a portable one
+//
+// sha512_bench [seconds per round]
+
+#include <string.h>
+
+#include "bench.h"
+
+#include "sha256_helper.h"
+#include "sha512_helper.h"
+
+static const size_t SIZES[] = { 128, 1024, 4096, 64 * 1024, 1024 * 1024, 16 * 1024 * 1024 };
+
+// FIPS 180-2, SHA-512("abc")
+static const char ABC_DIGEST[] =
+        "ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a"
+        "2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9ac94fa54ca49f";
+
+static void sha256Scalar(const uint8_t* data, size_t size, uint8_t* digest) {
+    struct sha256 sha;
+    sha256_init(&sha);
+    sha256_block_scalar(sha.state, data, size / 64);
+    sha.n_bits = (uint64_t) size << 3;
+    sha256_finalize_bytes(&sha, digest);
+}
+
+int main(int argc, char** argv) {
+    double roundSeconds = argc > 1 ? atof(argv[1]) : 0.05;
+
+    char hex[SHA512_HEX_SIZE];
+    sha512_hex("abc", 3, hex);
+    if (strcmp(hex, ABC_DIGEST) != 0) {
+        fprintf(stderr, "SHA-512(\"abc\") is %s\n", hex);
+        return 1;
+    }
+
+    size_t maxSize = SIZES[sizeof(SIZES) / sizeof(SIZES[0]) - 1];
+    uint8_t* data = (uint8_t*) malloc(maxSize);
+    if (data == NULL)
+        return 1;
+    for (size_t i = 0; i < maxSize; i++)
+        data[i] = (uint8_t) (i * 131 + (i >> 9));
+
+    printf("MB/s\n");
+    printf("%10s %12s %14s %12s\n", "size", "sha512", "sha256 scalar", "sha256");
+
+    for (size_t size : SIZES) {
+        uint8_t digest[SHA512_BYTES_SIZE];
+        double sha512 = benchSeconds([&] { sha512_bytes(data, size, digest); benchKeep(digest); }, roundSeconds);
+        double sha256Portable = benchSeconds([&] { sha256Scalar(data, size, digest); benchKeep(digest); }, roundSeconds);
+        double sha256 = benchSeconds([&] { sha256_bytes(data, size, digest); benchKeep(digest); }, roundSeconds);
+
+        printf("%10zu %12.0f %14.0f %12.0f\n", size, size / sha512 / 1e6, size / sha256Portable / 1e6, size / sha256 / 1e6);
+    }
+
+    free(data);
+    return 0;
+}
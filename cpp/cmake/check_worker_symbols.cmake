@@ -0,0 +1,31 @@
+# Lists the undefined symbols of every object in OBJECTS with NM and fails on the ones a pool worker can't reach:
+# libc's memory functions and the guards of function-local statics
+#
+# cmake -DNM=<nm> -DOBJECTS=<a.o;b.o;...> -P check_worker_symbols.cmake
+
+if(NOT NM OR NOT OBJECTS)
+    message(FATAL_ERROR "NM and OBJECTS are required")
+endif()
+
+set(failed FALSE)
+foreach(object IN LISTS OBJECTS)
+    execute_process(
+            COMMAND ${NM} -u ${object}
+            OUTPUT_VARIABLE symbols
+            RESULT_VARIABLE result
+    )
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "${NM} failed on ${object}")
+    endif()
+
+    string(REGEX MATCHALL "[ \t](mem(cpy|set|move|cmp)|__mem[a-z_]*chk|__cxa_guard_[a-z]+)[^\n]*" found "${symbols}")
+    foreach(symbol IN LISTS found)
+        string(STRIP "${symbol}" symbol)
+        message(SEND_ERROR "${object} references ${symbol}")
+        set(failed TRUE)
+    endforeach()
+endforeach()
+
+if(failed)
+    message(FATAL_ERROR "Code that runs on pool workers must not call into libc")
+endif()
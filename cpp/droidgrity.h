@@ -6,18 +6,27 @@
 #include "sys/types.h"
 
 #include "mylibc.h"
+#include "myarena.h"
 #include "utils/logging.h"
 #include "utils/common.h"
 
 #include "helpers/path_helper.h"
 #include "helpers/sha256_helper.h"
+#include "helpers/apkview_helper.h"
 #include "helpers/unzip_helper.h"
+#include "helpers/jarsignature_helper.h"
 #include "helpers/apksigningblock_helper.h"
+#include "helpers/verdictcache_helper.h"
+#include "helpers/parallel_helper.h"
 
-int getCertDataFromJarSignature(int fd, off_t eocdOffset, size_t& certSize, unsigned char* certData);
+int getCertDataFromJarSignature(const ApkView& view, const ZipIndex& zipIndex, size_t& certSize, unsigned char* certData);
 
-int getCertDataFromAPKSigningBlock(int fd, off_t eocdOffset, size_t& certSize, unsigned char* certData);
+int getCertDataFromAPKSigningBlock(const ApkSigningBlock& signingBlock, size_t& certSize, unsigned char* certData);
 
-int verifyCertificateFromAPK(const char* apkPath, unsigned char* knownCertHash, size_t hashLen);
+int verifyContentDigestFromAPKSigningBlock(const ApkView& view, const ApkSigningBlock& signingBlock, off_t eocdOffset);
+
+int verifyCertificateFromAPK(MyArena* arena, const char* apkPath, unsigned char* knownCertHash, size_t hashLen, ApkIdentity& identity);
+
+int verifyCertificateFromAPKs(const ApkPathList& apks, unsigned char* knownCertHash, size_t hashLen, ApkIdentity* identities);
 
 #endif // DROIDGRITY_H
\ No newline at end of file
@@ -8,18 +8,65 @@
 #include "utils/common.h"
 #include "mylibc.h"
 
+#include "helpers/apkview_helper.h"
 #include "helpers/unzip_helper.h"
+#include "helpers/contentdigest_helper.h"
+#include "helpers/pkcs7_helper.h"
 
 #define APK_SIG_BLOCK_MAGIC "APK Sig Block 42"
-#define APK_SIG_V2_SCHEME_BLOCK_ID 0x7109871a
 #define APK_SIG_BLOCK_MAGIC_LEN 16
+#define APK_SIG_BLOCK_FOOTER_SIZE (8 + APK_SIG_BLOCK_MAGIC_LEN) // size of block (uint64) | magic
+
+// ID-value pair IDs
+#define APK_SIG_V2_SCHEME_BLOCK_ID 0x7109871a
+#define APK_SIG_V3_SCHEME_BLOCK_ID 0xf05368c0
+#define APK_SIG_V31_SCHEME_BLOCK_ID 0x1b93ad61
+#define APK_SIG_VERITY_PADDING_BLOCK_ID 0x42726577
+#define APK_SIG_SOURCE_STAMP_V1_BLOCK_ID 0x2b09189e
+#define APK_SIG_SOURCE_STAMP_V2_BLOCK_ID 0x6dff800d
+
+// Signature algorithm IDs : https://source.android.com/docs/security/features/apksigning/v2#signature-algorithm-ids
+#define SIG_RSA_PSS_WITH_SHA256 0x0101
+#define SIG_RSA_PSS_WITH_SHA512 0x0102
+#define SIG_RSA_PKCS1_V1_5_WITH_SHA256 0x0103
+#define SIG_RSA_PKCS1_V1_5_WITH_SHA512 0x0104
+#define SIG_ECDSA_WITH_SHA256 0x0201
+#define SIG_ECDSA_WITH_SHA512 0x0202
+#define SIG_DSA_WITH_SHA256 0x0301
 
 #define BUFFER_SIZE 8192
+#define APK_SIG_CERT_MAX_SIZE BUFFER_SIZE // Size of the caller's certificate buffer
+
+typedef enum {
+    APK_SIG_PAIR_V2 = 0,
+    APK_SIG_PAIR_V3 = 1,
+    APK_SIG_PAIR_V31 = 2,
+    APK_SIG_PAIR_VERITY_PADDING = 3,
+    APK_SIG_PAIR_SOURCE_STAMP_V1 = 4,
+    APK_SIG_PAIR_SOURCE_STAMP_V2 = 5,
+    APK_SIG_PAIR_COUNT = 6
+} ApkSigningBlockPairType;
+
+// Value of an ID-value pair, points into the block span
+typedef struct {
+    const unsigned char* data;
+    size_t size;
+} ApkSigningBlockPair;
+
+typedef struct {
+    const unsigned char* data; // Whole block, from the leading size field to the magic
+    off_t offset;
+    size_t size;
+    ApkSigningBlockPair pairs[APK_SIG_PAIR_COUNT]; // data is NULL for pairs the block doesn't have
+} ApkSigningBlock;
+
+// The block stays valid as long as both the view and its arena are
+int openAPKSigningBlock(const ApkView& view, off_t eocdOffset, ApkSigningBlock& block);
 
-off_t locateAPKSigningBlock(int fd, off_t eocdOffset);
+int getCertificateFromAPKSigningBlock(const ApkSigningBlock& block, size_t& certSize, unsigned char* certData);
 
-int extractCertificateFromSignatureV2SchemeBlock(const unsigned char* signatureV2SchemeBlock, size_t& certSize, unsigned char* certData);
+int getContentDigestFromAPKSigningBlock(const ApkSigningBlock& block, ContentDigestType& type, unsigned char* digest);
 
-int parseAPKSigningBlock(int fd, off_t blockOffset, size_t& certSize, unsigned char* certData);
+int verifySignerFromAPKSigningBlock(const ApkSigningBlock& block);
 
 #endif // APKSIGNINGBLOCK_HELPER_H
\ No newline at end of file
@@ -0,0 +1,47 @@
+#ifndef APKVIEW_HELPER_H
+#define APKVIEW_HELPER_H
+
+#include <sys/types.h> // For some types...
+
+#include "utils/logging.h"
+#include "mylibc.h"
+#include "myarena.h"
+
+// What tells one version of a file from another without reading it. ctime can't be set from userspace,
+// so a file rewritten and given back its old mtime still shows up as changed
+typedef struct {
+    uint64_t device;
+    uint64_t inode;
+    int64_t size;
+    int64_t mtimeSec;
+    int64_t mtimeNsec;
+    int64_t ctimeSec;
+    int64_t ctimeNsec;
+} ApkIdentity;
+
+// Read-only view of the whole APK. It is mapped with a single mmap when possible, otherwise reads fall back to pread
+typedef struct {
+    int fd;
+    const unsigned char* data; // Whole APK when mapped, NULL when reads go through pread
+    off_t size;
+    MyArena* arena; // Every allocation made while verifying the APK, owned by the caller of openApkView
+    ApkIdentity identity; // Of the file actually opened, whatever its path points to later
+} ApkView;
+
+void getApkIdentity(const struct stat& st, ApkIdentity& identity);
+
+int openApkView(const char* apkPath, MyArena* arena, ApkView& view);
+
+void closeApkView(ApkView& view);
+
+// Bounds-checked span over [offset, offset + size). Points into the mapping, or into buffer filled with pread
+// when the APK isn't mapped. Returns NULL when the span is out of the APK or can't be read
+const unsigned char* getApkSpan(const ApkView& view, off_t offset, size_t size, void* buffer);
+
+// Same for spans too large for a caller buffer, without a mapping the bytes are read into the view's arena
+const unsigned char* acquireApkSpan(const ApkView& view, off_t offset, size_t size);
+
+// Hint that [offset, offset + size) is about to be read from start to end, the kernel starts reading it in the background
+void prefetchApkSpan(const ApkView& view, off_t offset, size_t size);
+
+#endif // APKVIEW_HELPER_H
@@ -0,0 +1,30 @@
+#ifndef CONTENTDIGEST_HELPER_H
+#define CONTENTDIGEST_HELPER_H
+
+#include <sys/types.h> // For some types...
+
+#include "utils/logging.h"
+#include "utils/common.h"
+#include "mylibc.h"
+
+#include "helpers/apkview_helper.h"
+#include "helpers/sha256_helper.h"
+#include "helpers/sha256_mb_helper.h"
+#include "helpers/sha512_helper.h"
+#include "helpers/parallel_helper.h"
+
+// APK Signature Scheme v2/v3 content digests : https://source.android.com/docs/security/features/apksigning/v2#integrity-protected-contents
+#define CONTENT_DIGEST_CHUNK_SIZE (1024 * 1024)
+#define CONTENT_DIGEST_MAX_SIZE SHA512_BYTES_SIZE
+
+typedef enum {
+    CONTENT_DIGEST_SHA256 = 1,
+    CONTENT_DIGEST_SHA512 = 2
+} ContentDigestType;
+
+size_t getContentDigestSize(ContentDigestType type);
+
+// Computes the top-level digest over the ZIP entries, the Central Directory and the EOCD, chunks are hashed in parallel
+int computeContentDigest(const ApkView& view, off_t signingBlockOffset, off_t centralDirOffset, off_t eocdOffset, ContentDigestType type, unsigned char* digest);
+
+#endif // CONTENTDIGEST_HELPER_H
@@ -0,0 +1,264 @@
+#ifndef DER_HELPER_H
+#define DER_HELPER_H
+
+#include <sys/types.h> // For some types...
+#include <stdint.h>
+
+#include "mylibc.h"
+#include "utils/logging.h"
+
+// Tags:
+// https://en.wikipedia.org/wiki/X.690
+#define TAG_BOOLEAN         0x01
+#define TAG_INTEGER         0x02
+#define TAG_BITSTRING       0x03
+#define TAG_OCTETSTRING     0x04
+#define TAG_NULL            0x05
+#define TAG_OBJECTID        0x06
+#define TAG_UTCTIME         0x17
+#define TAG_GENERALIZEDTIME 0x18
+#define TAG_SEQUENCE        0x30
+#define TAG_SET             0x31
+
+#define TAG_OPTIONAL    0xA0 // [0] constructed, context specific
+#define TAG_CONTEXT(n)  (TAG_OPTIONAL | (n))
+#define TAG_CONTEXT_PRIMITIVE(n) (0x80 | (n))
+
+#define DER_NO_CAPTURE -1
+
+// One tag | length | content triple, everything points into the parsed data
+typedef struct {
+    uint8_t tag;
+    const unsigned char* header; // Start of the whole element, tag included
+    const unsigned char* data;   // Content
+    size_t size;                 // Content size
+} DerElement;
+
+// Reads the elements of [pos, end) one after the other. It is only a pair of pointers, so it lives on the stack
+// and any number of them can walk the same data at once
+typedef struct {
+    const unsigned char* pos;
+    const unsigned char* end;
+} DerCursor;
+
+// The cursor primitives are inline so that schemas below compile into straight code
+
+inline void derInit(DerCursor& cursor, const void* data, size_t size) {
+    cursor.pos = (const unsigned char*) data;
+    cursor.end = cursor.pos + size;
+}
+
+inline bool derAtEnd(const DerCursor& cursor) {
+    return cursor.pos >= cursor.end;
+}
+
+// Tag of the next element, -1 at the end
+inline int derPeekTag(const DerCursor& cursor) {
+    return derAtEnd(cursor) ? -1 : cursor.pos[0];
+}
+
+/**
+ * Next element whatever its tag. Returns 0, or -1 at the end or on malformed data.
+ * Definite lengths only. The short form is the length itself, the long form 0x80 | n is followed
+ * by n big-endian length bytes, at most 4 of them here
+ */
+inline int derNext(DerCursor& cursor, DerElement& element) {
+    const unsigned char* ptr = cursor.pos;
+    if (cursor.end - ptr < 2)
+        return -1;
+
+    uint8_t tag = *ptr++;
+
+    // Multi-byte tags never show up in certificates or signatures
+    if ((tag & 0x1f) == 0x1f)
+        return -1;
+
+    size_t size = *ptr++;
+    if (size & 0x80) {
+        size_t num = size & 0x7f;
+        if (num == 0 || num > 4 || (size_t) (cursor.end - ptr) < num) {
+            LOGE("Unsupported ASN.1 element length => %zu bytes", num);
+            return -1;
+        }
+
+        size = 0;
+        while (num--)
+            size = (size << 8) | *ptr++;
+    }
+
+    if ((size_t) (cursor.end - ptr) < size)
+        return -1;
+
+    element.tag = tag;
+    element.header = cursor.pos;
+    element.data = ptr;
+    element.size = size;
+    cursor.pos = ptr + size;
+    return 0;
+}
+
+// Same when the element may be absent: 1 when it was read, 0 when the next element has another tag, -1 on malformed data
+inline int derOptional(DerCursor& cursor, uint8_t tag, DerElement& element) {
+    if (derPeekTag(cursor) != tag)
+        return 0;
+
+    return derNext(cursor, element) < 0 ? -1 : 1;
+}
+
+// Next element, which must have the given tag. Nothing is consumed on failure
+inline int derExpect(DerCursor& cursor, uint8_t tag, DerElement& element) {
+    return derOptional(cursor, tag, element) == 1 ? 0 : -1;
+}
+
+// Cursor over the content of a constructed element
+inline void derEnter(const DerElement& element, DerCursor& inner) {
+    derInit(inner, element.data, element.size);
+}
+
+// Typed accessors, each reads one element of its type
+int derSequence(DerCursor& cursor, DerCursor& inner);
+
+int derSet(DerCursor& cursor, DerCursor& inner);
+
+int derContext(DerCursor& cursor, uint8_t number, DerCursor& inner);
+
+// Big-endian magnitude of a non-negative INTEGER, without its leading zero
+int derInteger(DerCursor& cursor, const unsigned char*& data, size_t& size);
+
+int derOid(DerCursor& cursor, DerElement& element);
+
+// Bit string content with no unused bits, without the leading unused bits count
+int derBitString(DerCursor& cursor, const unsigned char*& data, size_t& size);
+
+int derOctetString(DerCursor& cursor, const unsigned char*& data, size_t& size);
+
+// Whole encoding of the element, tag and length included
+size_t derEncodedSize(const DerElement& element);
+
+bool derOidEquals(const DerElement& element, const unsigned char* oid, size_t oidSize);
+
+/* Schemas
+ *
+ * A structure is declared once as a type built from the templates below, for instance
+ *
+ *   DerConstructed<TAG_SEQUENCE, DER_NO_CAPTURE,
+ *       DerField<TAG_INTEGER>,
+ *       DerOptional<DerField<TAG_CONTEXT(0), MY_FIELD>>>
+ *
+ * Every building block has a static match that reads its part of the data and stores the elements
+ * it captures at their index. It all inlines into one straight parser for that structure, with
+ * the expected tags as constants and a single pass over the data.
+ */
+
+template <int Capture>
+inline void derCapture(DerElement* captures, const DerElement& element) {
+    if (Capture != DER_NO_CAPTURE)
+        captures[Capture] = element;
+}
+
+// One element with the given tag
+template <uint8_t Tag, int Capture = DER_NO_CAPTURE>
+struct DerField {
+    static inline bool accepts(int tag) {
+        return tag == Tag;
+    }
+
+    static inline int match(DerCursor& cursor, DerElement* captures) {
+        DerElement element;
+        if (derExpect(cursor, Tag, element) < 0)
+            return -1;
+
+        derCapture<Capture>(captures, element);
+        return 0;
+    }
+};
+
+// One element with either tag, like Time : UTCTime or GeneralizedTime
+template <uint8_t TagA, uint8_t TagB, int Capture = DER_NO_CAPTURE>
+struct DerChoice {
+    static inline bool accepts(int tag) {
+        return tag == TagA || tag == TagB;
+    }
+
+    static inline int match(DerCursor& cursor, DerElement* captures) {
+        DerElement element;
+        if (!accepts(derPeekTag(cursor)) || derNext(cursor, element) < 0)
+            return -1;
+
+        derCapture<Capture>(captures, element);
+        return 0;
+    }
+};
+
+// Field that may be absent, its capture is left untouched then
+template <typename Field>
+struct DerOptional {
+    static inline bool accepts(int tag) {
+        return Field::accepts(tag);
+    }
+
+    static inline int match(DerCursor& cursor, DerElement* captures) {
+        if (!Field::accepts(derPeekTag(cursor)))
+            return 0;
+        return Field::match(cursor, captures);
+    }
+};
+
+// Fields one after the other
+template <typename... Fields>
+struct DerFields;
+
+template <>
+struct DerFields<> {
+    static inline int match(DerCursor&, DerElement*) {
+        return 0;
+    }
+};
+
+template <typename First, typename... Rest>
+struct DerFields<First, Rest...> {
+    static inline int match(DerCursor& cursor, DerElement* captures) {
+        if (First::match(cursor, captures) < 0)
+            return -1;
+        return DerFields<Rest...>::match(cursor, captures);
+    }
+};
+
+// Constructed element whose content is exactly the given fields
+template <uint8_t Tag, int Capture, typename... Fields>
+struct DerConstructed {
+    static inline bool accepts(int tag) {
+        return tag == Tag;
+    }
+
+    static inline int match(DerCursor& cursor, DerElement* captures) {
+        DerElement element;
+        if (derExpect(cursor, Tag, element) < 0)
+            return -1;
+
+        derCapture<Capture>(captures, element);
+
+        DerCursor inner;
+        derEnter(element, inner);
+        if (DerFields<Fields...>::match(inner, captures) < 0)
+            return -1;
+        return derAtEnd(inner) ? 0 : -1;
+    }
+};
+
+// Match data against a schema, it must cover all of it. Fields that aren't there end up with a NULL data
+template <typename Schema, size_t Count>
+inline int derMatch(const void* data, size_t size, DerElement (&captures)[Count]) {
+    for (size_t i = 0; i < Count; i++) {
+        captures[i].data = NULL;
+        captures[i].size = 0;
+    }
+
+    DerCursor cursor;
+    derInit(cursor, data, size);
+    if (Schema::match(cursor, captures) < 0)
+        return -1;
+    return derAtEnd(cursor) ? 0 : -1;
+}
+
+#endif // DER_HELPER_H
@@ -0,0 +1,30 @@
+#ifndef ECDSA_HELPER_H
+#define ECDSA_HELPER_H
+
+#include <sys/types.h> // For some types...
+#include <stdint.h>
+
+#include "mylibc.h"
+#include "utils/logging.h"
+#include "utils/common.h"
+
+#include "der_helper.h"
+
+#define P256_LIMBS 4
+#define P256_BYTES_SIZE 32
+#define P256_POINT_SIZE (1 + 2 * P256_BYTES_SIZE) // 0x04 | x | y
+
+// Public key on P-256, coordinates are in Montgomery form with little-endian limbs
+typedef struct {
+    uint64_t x[P256_LIMBS];
+    uint64_t y[P256_LIMBS];
+} EcPublicKey;
+
+// Uncompressed point, the content of the SubjectPublicKeyInfo bit string. It has to be on the curve
+int parseEcPublicKey(const unsigned char* data, size_t size, EcPublicKey& key);
+
+// ECDSA over P-256, the signature is the DER SEQUENCE { r INTEGER, s INTEGER }. Longer digests are truncated to 256 bits
+int verifyEcdsaSignature(const EcPublicKey& key, const unsigned char* digest, size_t digestSize,
+                         const unsigned char* signature, size_t signatureSize);
+
+#endif // ECDSA_HELPER_H
@@ -2,16 +2,70 @@
 #define INFLATE_HELPER_H
 
 #include <sys/types.h> // For some types...
+#include <stdint.h>
 #include <assert.h>
 
 #include "mylibc.h"
 
+#define INFLATE_WINDOW_SIZE 32768  // Furthest a match can reach back, smallest ring a stream can decode into
+#define INFLATE_TABLE_SIZE 2048    // Room for a primary decoding table and its secondary tables
+
 typedef enum {
+    INFLATE_END = 3,       // Stream: end of the compressed stream reached
+    INFLATE_NEED_INPUT = 2, // Stream: input piece used up, hand over the next one
     INFLATE_OK = 1,      // Success
     INFLATE_ERROR = -1,   // Input error
     INFLATE_OVERFLOW = -2 // Not enough room for output
 } InflateResult;
 
+typedef struct {
+    uint32_t table[INFLATE_TABLE_SIZE];
+    uint32_t tableBits;
+    int32_t maxSym;
+} InflateTree;
+
+// Resumable decoder state, see inflateStreamInit
+typedef struct {
+    // Input piece and bit reader
+    const uint8_t *src, *srcEnd;
+    uint64_t tag;
+    uint32_t bitcount, padding; // padding counts the zero bits appended past the end of the input
+    bool lastInput;
+
+    // Output window
+    uint8_t *window;
+    size_t windowSize, pos;
+    bool ring, wrapped;
+
+    // Where decoding resumes
+    int state;
+    uint32_t bfinal;
+    uint32_t hlit, hdist, hclen, num;
+    uint32_t copyLength, copyDist; // Rest of a match or stored block cut short by the end of the window
+    const InflateTree *lt, *dt;
+
+    uint8_t lengths[288 + 32];
+    InflateTree ltree; // Literal/length tree
+    InflateTree dtree; // Distance tree
+} InflateStream;
+
 InflateResult inflate(void*, size_t*, const void*, size_t);
 
-#endif // INFLATE_HELPER_H
\ No newline at end of file
+/* Streaming inflate
+ *
+ * Output goes to the caller's window of windowSize bytes. With ring set the window is reused
+ * from the start each time it fills up and must hold at least INFLATE_WINDOW_SIZE bytes,
+ * without it all output has to fit and INFLATE_OVERFLOW is returned when it does not.
+ *
+ * Input is handed over in pieces of any size with inflateStreamInput, last marks the final one.
+ * inflateStreamNext then decodes until the window is full (INFLATE_OK), the piece is used up
+ * (INFLATE_NEED_INPUT) or the stream ends (INFLATE_END). Whatever the result, the bytes produced
+ * by the call are returned as a span of the window that stays valid until the next call.
+ */
+void inflateStreamInit(InflateStream *s, void *window, size_t windowSize, bool ring);
+
+void inflateStreamInput(InflateStream *s, const void *src, size_t srcLen, bool last);
+
+InflateResult inflateStreamNext(InflateStream *s, const uint8_t **out, size_t *outLen);
+
+#endif // INFLATE_HELPER_H
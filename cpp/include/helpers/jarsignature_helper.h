@@ -0,0 +1,50 @@
+#ifndef JARSIGNATURE_HELPER_H
+#define JARSIGNATURE_HELPER_H
+
+#include <sys/types.h> // For some types...
+
+#include "utils/common.h"
+#include "utils/logging.h"
+#include "mylibc.h"
+
+#include "sha1_helper.h"
+#include "sha256_helper.h"
+#include "unzip_helper.h"
+#include "pkcs7_helper.h"
+
+#define JAR_MANIFEST_NAME "META-INF/MANIFEST.MF"
+#define JAR_META_INF_PREFIX "META-INF/"
+#define JAR_FILE_MAX_SIZE (64 * 1024 * 1024) // Upper bound for an inflated MANIFEST.MF or *.SF
+#define JAR_DIGEST_MAX_SIZE SHA256_BYTES_SIZE
+
+typedef enum {
+    JAR_DIGEST_NONE = 0,
+    JAR_DIGEST_SHA1 = 1,
+    JAR_DIGEST_SHA256 = 2
+} JarDigestType;
+
+// Digest of one entry as listed in MANIFEST.MF, name points into the manifest data
+typedef struct {
+    const char* name;
+    uint32_t nameLength;
+    uint8_t digestType;
+    bool seen;
+    unsigned char digest[JAR_DIGEST_MAX_SIZE];
+} ManifestEntry;
+
+// Manifest entries with an open addressing hash table over their names
+typedef struct {
+    ManifestEntry* entries;
+    size_t count;
+    uint32_t* buckets; // Entry index + 1, 0 for an empty bucket
+    size_t bucketMask;
+} ManifestIndex;
+
+// The index is allocated from arena and points into data
+int parseManifest(MyArena* arena, char* data, size_t size, ManifestIndex& index);
+
+ManifestEntry* findManifestEntry(const ManifestIndex& index, const char* name, size_t nameLength);
+
+int verifyJarEntries(const ApkView& view, const ZipIndex& zipIndex, size_t& certSize, unsigned char* certData);
+
+#endif // JARSIGNATURE_HELPER_H
@@ -0,0 +1,21 @@
+#ifndef PARALLEL_HELPER_H
+#define PARALLEL_HELPER_H
+
+#include <sys/types.h> // For some types...
+
+#include "mylibc.h"
+#include "mythreads.h"
+
+#define PARALLEL_MAX_WORKERS MY_POOL_MAX_THREADS
+
+// Runs task(ctx, index, worker) for index in [0, count), worker < workerCount identifies the thread running it
+typedef MyPoolTask ParallelTask;
+
+// Number of threads runParallel will use for count tasks, callers size their per-worker scratch with it
+size_t getParallelWorkerCount(size_t count);
+
+// Runs every task on the mythreads pool, the calling thread being one of them, and returns once all of them are done.
+// Tasks run on threads libc doesn't know about, see mythreads.h for what they may not do
+int runParallel(ParallelTask task, void* ctx, size_t count);
+
+#endif // PARALLEL_HELPER_H
@@ -26,17 +26,40 @@ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 #ifndef PATH_HELPER_H
 #define PATH_HELPER_H
 
-/*
-A shame that we have to include this but we need it for std::string. We don't use it to import methods though since we redefined them in mylibc to avoid hooking !
-Could maybe do this another way but I lost my sanity trying to do things with char * rather than std::string
-*/
-#include <string>
+#include <stdint.h>
+#include <link.h> // For ElfW
+#include <sys/auxv.h> // For AT_PAGESZ
+#include <dirent.h> // For DT_REG
 
 #include "mylibc.h"
+#include "myarena.h"
+#include "utils/common.h"
+#include "helpers/apkview_helper.h"
 
-#define FD_BUFFER_SIZE 1024
+// Big apps have thousands of mappings, so /proc/self/maps is read in large chunks and parsed in place
+#define MAPS_BUFFER_SIZE (16 * 1024)
 #define PATH_SIZE 256
+#define FD_ENTRIES_SIZE 2048
+#define APK_MAX_FILES 32
+
+// getInstalledApkPaths found an APK it couldn't keep, either past APK_MAX_FILES or with too long a path
+#define APK_LIST_OVERFLOW (-2)
+
+// Every APK the app is installed from, base.apk first then the splits
+typedef struct {
+    char paths[APK_MAX_FILES][PATH_SIZE];
+    size_t count;
+    ApkIdentity directoryIdentity; // Of the directory that was listed, a split added since changes it
+} ApkPathList;
+
+// The path is allocated from arena
+char * getApkPath(MyArena * arena, const char * packageName);
+
+// Same search through lines in the format of /proc/self/maps read from fd, which is left open
+char * getApkPathFromMapsFd(MyArena * arena, int fd, const char * packageName);
 
-char * getApkPath(const char * packageName);
+// Lists the APKs next to apkPath, which is any one of the APKs of the app. Returns -1 when the directory can't be
+// listed, APK_LIST_OVERFLOW when it holds APKs that don't fit in the list
+int getInstalledApkPaths(const char * apkPath, ApkPathList& apks);
 
 #endif //PATH_HELPER_H
\ No newline at end of file
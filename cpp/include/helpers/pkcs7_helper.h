@@ -4,37 +4,77 @@
 #define PKCS7_HELPER_H
 
 #include <sys/types.h> // For some types...
-#include "malloc.h"
-#include "assert.h"
 
 #include "mylibc.h"
 #include "utils/logging.h"
 
-// Tags:
-// https://en.wikipedia.org/wiki/X.690
-#define TAG_INTEGER         0x02
-#define TAG_BITSTRING       0x03
-#define TAG_OCTETSTRING     0x04
-#define TAG_NULL            0x05
-#define TAG_OBJECTID        0x06
-#define TAG_UTCTIME         0x17
-#define TAG_GENERALIZEDTIME 0x18
-#define TAG_SEQUENCE        0x30
-#define TAG_SET             0x31
-
-#define TAG_OPTIONAL    0xA0
-
-#define NAME_LEN    63
-
-typedef struct element {
-    unsigned char tag;
-    char name[NAME_LEN];
-    int begin;
-    size_t len;
-    int level;
-    struct element *next;
-} element;
-
-int extract_cert_from_pkcs7(unsigned char * pkcs7_cert, size_t len_in, size_t *len_out, unsigned char * data);
-
-#endif // PKCS7_HELPER_H
\ No newline at end of file
+#include "der_helper.h"
+#include "rsa_helper.h"
+#include "ecdsa_helper.h"
+
+#define PKCS7_CERT_MAX_SIZE 8192 // Size of the caller's certificate buffer
+
+// Fields captured from a PKCS#7 SignedData, they point into the parsed data. Absent ones have a NULL data
+typedef enum {
+    PKCS7_CONTENT_TYPE = 0,
+    PKCS7_DIGEST_ALGORITHMS,     // SET
+    PKCS7_CONTENT_INFO,          // SEQUENCE
+    PKCS7_CERTIFICATES,          // [0], its content is the certificates one after the other
+    PKCS7_SIGNER_INFOS,          // SET
+    PKCS7_FIELD_COUNT
+} Pkcs7SignedDataField;
+
+typedef struct {
+    DerElement fields[PKCS7_FIELD_COUNT];
+} Pkcs7SignedData;
+
+typedef enum {
+    SIGNER_ISSUER_AND_SERIAL_NUMBER = 0,
+    SIGNER_DIGEST_ALGORITHM,
+    SIGNER_AUTHENTICATED_ATTRIBUTES,   // [0], optional
+    SIGNER_DIGEST_ENCRYPTION_ALGORITHM,
+    SIGNER_ENCRYPTED_DIGEST,
+    SIGNER_FIELD_COUNT
+} Pkcs7SignerInfoField;
+
+typedef struct {
+    DerElement fields[SIGNER_FIELD_COUNT];
+} Pkcs7SignerInfo;
+
+typedef enum {
+    X509_TBS_CERTIFICATE = 0,
+    X509_SERIAL_NUMBER,
+    X509_ISSUER,
+    X509_SUBJECT,
+    X509_SUBJECT_PUBLIC_KEY_INFO,
+    X509_SIGNATURE_ALGORITHM,
+    X509_SIGNATURE_VALUE,
+    X509_FIELD_COUNT
+} X509CertificateField;
+
+typedef struct {
+    DerElement fields[X509_FIELD_COUNT];
+} X509Certificate;
+
+typedef enum {
+    SIGNATURE_RSA_PKCS1_V1_5 = 0,
+    SIGNATURE_RSA_PSS = 1,
+    SIGNATURE_ECDSA = 2
+} SignatureScheme;
+
+int parsePkcs7SignedData(const unsigned char* data, size_t size, Pkcs7SignedData& signedData);
+
+int parsePkcs7SignerInfo(const DerElement& element, Pkcs7SignerInfo& signerInfo);
+
+int parseX509Certificate(const unsigned char* data, size_t size, X509Certificate& certificate);
+
+// Check a signature over a message digest with the key of a SubjectPublicKeyInfo
+int verifyPublicKeySignature(const DerElement& subjectPublicKeyInfo, SignatureScheme scheme, RsaHashType hashType,
+                             const unsigned char* digest, const unsigned char* signature, size_t signatureSize);
+
+// Check that the 1st signerInfo signed content with the key of the 1st certificate
+int verifyPkcs7Signature(const unsigned char* data, size_t size, const unsigned char* content, size_t contentSize);
+
+int extract_cert_from_pkcs7(const unsigned char * pkcs7_cert, size_t len_in, size_t *len_out, unsigned char * data);
+
+#endif // PKCS7_HELPER_H
@@ -0,0 +1,65 @@
+#ifndef RSA_HELPER_H
+#define RSA_HELPER_H
+
+#include <sys/types.h> // For some types...
+#include <stdint.h>
+
+#include "mylibc.h"
+#include "utils/logging.h"
+#include "utils/common.h"
+
+#include "der_helper.h"
+#include "sha1_helper.h"
+#include "sha256_helper.h"
+#include "sha512_helper.h"
+
+#define RSA_MAX_BITS 8192
+#define RSA_MAX_LIMBS (RSA_MAX_BITS / 64)
+#define RSA_MIN_BITS 1024
+
+typedef enum {
+    RSA_HASH_SHA1 = 1,
+    RSA_HASH_SHA256 = 2,
+    RSA_HASH_SHA512 = 3
+} RsaHashType;
+
+// Public key ready for Montgomery arithmetic, limbs are little-endian
+typedef struct {
+    uint64_t n[RSA_MAX_LIMBS];
+    uint64_t rr[RSA_MAX_LIMBS]; // R^2 mod n with R = 2^(64 * limbs)
+    uint64_t n0inv;             // -n^-1 mod 2^64
+    size_t limbs;
+    size_t modulusSize;         // Bytes
+    uint32_t e;
+} RsaPublicKey;
+
+// One of the hashes, for data that comes in several parts
+typedef struct {
+    RsaHashType type;
+    union {
+        struct sha1 sha1;
+        struct sha256 sha256;
+        struct sha512 sha512;
+    };
+} RsaHash;
+
+size_t getRsaHashSize(RsaHashType type);
+
+void rsaHashInit(RsaHash& hash, RsaHashType type);
+
+void rsaHashAppend(RsaHash& hash, const void* data, size_t size);
+
+void rsaHashFinalize(RsaHash& hash, unsigned char* digest);
+
+// RSAPublicKey : SEQUENCE { modulus INTEGER, publicExponent INTEGER }, the content of the SubjectPublicKeyInfo bit string
+int parseRsaPublicKey(const unsigned char* der, size_t size, RsaPublicKey& key);
+
+// RSASSA-PKCS1-v1_5 over the given message digest
+int verifyRsaPkcs1Signature(const RsaPublicKey& key, RsaHashType type, const unsigned char* digest,
+                            const unsigned char* signature, size_t signatureSize);
+
+// RSASSA-PSS with MGF1 on the same hash and a salt as long as the digest, as APK Signature Scheme v2 uses it
+int verifyRsaPssSignature(const RsaPublicKey& key, RsaHashType type, const unsigned char* digest,
+                          const unsigned char* signature, size_t signatureSize);
+
+#endif // RSA_HELPER_H
@@ -0,0 +1,14 @@
+#ifndef SCAN_HELPER_H
+#define SCAN_HELPER_H
+
+#include <sys/types.h> // For some types...
+#include <stdint.h>
+
+#include "utils/common.h"
+#include "mylibc.h"
+
+// Last occurrence of pattern (at least 2 bytes) in data, NULL when there is none.
+// Blocks are filtered on the first and last pattern bytes with NEON or SSE2, a word at a time without them
+const unsigned char* findLastPattern(const unsigned char* data, size_t size, const void* pattern, size_t patternLength);
+
+#endif // SCAN_HELPER_H
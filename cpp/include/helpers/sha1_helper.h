@@ -0,0 +1,29 @@
+// SHA-1 implementation following the same shape as sha256_helper, only needed for legacy v1 manifests
+
+#include <sys/types.h>
+#include <stdint.h>
+
+#ifndef SHA1_H
+#define SHA1_H
+
+typedef struct sha1 {
+    uint32_t state[5];
+    uint8_t buffer[64];
+    uint64_t n_bits;
+    uint8_t buffer_counter;
+} sha1;
+
+#define SHA1_BYTES_SIZE 20
+
+void sha1_init(struct sha1 *sha);
+
+// Whole 64-byte blocks are compressed straight from src, only the head and tail go through the buffer
+void sha1_append(struct sha1 *sha, const void *src, size_t n_bytes);
+
+void sha1_finalize(struct sha1 *sha);
+
+void sha1_finalize_bytes(struct sha1 *sha, void *dst_bytes20);
+
+void sha1_bytes(const void *src, size_t n_bytes, void *dst_bytes20);
+
+#endif
@@ -16,10 +16,29 @@ typedef struct sha256 {
 #define SHA256_HEX_SIZE (64 + 1)
 #define SHA256_BYTES_SIZE 32
 
+extern const uint32_t sha256_k[64];
+
+// Compression kernels, each one compresses n_blocks consecutive 64-byte blocks of data into state
+typedef void (*sha256_block_fn)(uint32_t *state, const uint8_t *data, size_t n_blocks);
+
+void sha256_block_scalar(uint32_t *state, const uint8_t *data, size_t n_blocks);
+
+#if defined(__aarch64__)
+// ARMv8 Crypto Extensions (SHA256H/SHA256H2)
+void sha256_block_armv8(uint32_t *state, const uint8_t *data, size_t n_blocks);
+#elif defined(__x86_64__) || defined(__i386__)
+// Intel SHA extensions (SHA-NI)
+void sha256_block_shani(uint32_t *state, const uint8_t *data, size_t n_blocks);
+#endif
+
+// Kernel selected at runtime for this CPU
+sha256_block_fn sha256_get_block_fn();
+
 void sha256_init(struct sha256 *sha);
 
 void sha256_append_byte(struct sha256 *sha, uint8_t byte);
 
+// Whole 64-byte blocks are compressed straight from src, only the head and tail go through the buffer
 void sha256_append(struct sha256 *sha, const void *src, size_t n_bytes);
 
 void sha256_finalize(struct sha256 *sha);
@@ -0,0 +1,38 @@
+// Multi-buffer SHA-256 : independent messages are hashed side by side, one message per SIMD lane
+
+#ifndef SHA256_MB_H
+#define SHA256_MB_H
+
+#include <sys/types.h>
+#include <stdint.h>
+
+#include "sha256_helper.h"
+
+#define SHA256_MB_MAX_LANES 8
+
+typedef struct sha256_span {
+    const void *data;
+    size_t n_bytes;
+} sha256_span;
+
+// Multi-lane compression kernels, lane i compresses n_blocks consecutive 64-byte blocks of data[i] into states[i]
+typedef void (*sha256_mb_block_fn)(uint32_t *const *states, const uint8_t *const *data, size_t n_blocks);
+
+#if defined(__ARM_NEON)
+// 4 lanes of 32-bit NEON
+void sha256_mb_block_neon(uint32_t *const *states, const uint8_t *const *data, size_t n_blocks);
+#elif defined(__x86_64__) || defined(__i386__)
+// 8 lanes of AVX2
+void sha256_mb_block_avx2(uint32_t *const *states, const uint8_t *const *data, size_t n_blocks);
+#endif
+
+// Number of messages worth handing to sha256_mb_append at once on this CPU, 1 when lanes don't pay off
+size_t sha256_mb_lanes();
+
+// Append spans[i] to shas[i] for every i < count
+void sha256_mb_append(struct sha256 *shas, const sha256_span *spans, size_t count);
+
+// Hash count independent spans, digest i is written to dst_bytes32[i]
+void sha256_mb_bytes(const sha256_span *spans, size_t count, uint8_t (*dst_bytes32)[SHA256_BYTES_SIZE]);
+
+#endif
@@ -0,0 +1,36 @@
+// SHA-512 implementation following the same shape as sha256_helper
+
+#include <sys/types.h>
+#include <stdint.h>
+
+#ifndef SHA512_H
+#define SHA512_H
+
+typedef struct sha512 {
+    uint64_t state[8];
+    uint8_t buffer[128];
+    uint64_t n_bits;
+    uint8_t buffer_counter;
+} sha512;
+
+#define SHA512_HEX_SIZE (128 + 1)
+#define SHA512_BYTES_SIZE 64
+
+void sha512_init(struct sha512 *sha);
+
+void sha512_append_byte(struct sha512 *sha, uint8_t byte);
+
+// Whole 128-byte blocks are compressed straight from src, only the head and tail go through the buffer
+void sha512_append(struct sha512 *sha, const void *src, size_t n_bytes);
+
+void sha512_finalize(struct sha512 *sha);
+
+void sha512_finalize_hex(struct sha512 *sha, char *dst_hex129);
+
+void sha512_finalize_bytes(struct sha512 *sha, void *dst_bytes64);
+
+void sha512_hex(const void *src, size_t n_bytes, char *dst_hex129);
+
+void sha512_bytes(const void *src, size_t n_bytes, void *dst_bytes64);
+
+#endif
@@ -8,7 +8,9 @@
 #include "utils/logging.h"
 #include "mylibc.h"
 
+#include "apkview_helper.h"
 #include "inflate_helper.h"
+#include "scan_helper.h"
 #include "pkcs7_helper.h"
 
 #define EOCD_SIGNATURE 0x06054b50
@@ -17,13 +19,71 @@
 
 #define BUFFER_SIZE 8192
 #define EOCD_MIN_SIZE 22
+#define EOCD_SEARCH_SIZE (EOCD_MIN_SIZE + 0xffff) // EOCD followed by the longest possible comment
+#define CENTRAL_DIRECTORY_HEADER_SIZE 46
+#define LOCAL_FILE_HEADER_SIZE 30
+#define CENTRAL_DIRECTORY_MAX_SIZE (64 * 1024 * 1024)
+#define ZIP_STREAM_INPUT_SIZE (64 * 1024)
+#define CERT_FILE_MAX_SIZE (1024 * 1024) // Upper bound for an inflated META-INF/*.RSA, *.DSA or *.EC
+#define ZIP_META_INF_PREFIX "META-INF/"
 
-off_t findEOCDOffset(int fd);
+// One Central Directory record, name points into the Central Directory span
+typedef struct {
+    const char* name;
+    uint16_t nameLength;
+    uint16_t compressionMethod;
+    uint32_t nameHash;
+    uint32_t crc32;
+    uint32_t compressedSize;
+    uint32_t uncompressedSize;
+    uint32_t localHeaderOffset;
+} ZipEntry;
 
-off_t getCentralDirectoryOffset(int fd, off_t eocdOffset);
+// Signing related files right inside META-INF, found by their extension
+typedef enum {
+    ZIP_CLASS_SIGNATURE_FILE = 0,  // *.SF
+    ZIP_CLASS_SIGNATURE_BLOCK = 1, // *.RSA, *.DSA, *.EC
+    ZIP_CLASS_COUNT = 2
+} ZipEntryClass;
 
-int findCertificateFile(int fd, off_t centralDirOffset, char* certFileName, off_t& fileOffset, size_t& fileSize);
+// Every Central Directory record in one array, with an open addressing hash table over their names
+typedef struct {
+    const unsigned char* centralDir; // Span the entry names point into
+    ZipEntry* entries;
+    size_t count;
+    uint32_t* buckets; // Entry index + 1, 0 for an empty bucket
+    size_t bucketMask;
+    int32_t classes[ZIP_CLASS_COUNT]; // First entry of each class, -1 when there is none
+} ZipIndex;
 
-int extractCertFile(int fd, off_t fileOffset, size_t& fileSize, unsigned char* data);
+off_t findEOCDOffset(const ApkView& view);
+
+off_t getCentralDirectoryOffset(const ApkView& view, off_t eocdOffset);
+
+// Receives the uncompressed data of an entry one piece at a time
+typedef void (*ZipEntrySink)(void* ctx, const uint8_t* data, size_t size);
+
+// Buffers for streaming entries, allocated once and reused for every entry
+typedef struct {
+    InflateStream stream;
+    uint8_t window[INFLATE_WINDOW_SIZE];
+    uint8_t input[ZIP_STREAM_INPUT_SIZE];
+} ZipStreamWorkspace;
+
+int readCentralDirectory(const ApkView& view, off_t eocdOffset, const unsigned char*& data, size_t& size);
+
+int nextCentralDirectoryEntry(const unsigned char* data, size_t size, size_t& pos, ZipEntry& entry);
+
+uint32_t hashZipName(const char* name, size_t length);
+
+int buildZipIndex(const ApkView& view, off_t eocdOffset, ZipIndex& index);
+
+const ZipEntry* findZipEntry(const ZipIndex& index, const char* name, size_t nameLength);
+
+const ZipEntry* findZipEntryByClass(const ZipIndex& index, ZipEntryClass entryClass);
+
+off_t getLocalFileDataOffset(const ApkView& view, const ZipEntry& entry);
+
+int streamZipEntry(const ApkView& view, const ZipEntry& entry, ZipStreamWorkspace* workspace, ZipEntrySink sink, void* ctx);
 
 #endif // UNZIP_HELPER_H
\ No newline at end of file
@@ -0,0 +1,20 @@
+#ifndef VERDICTCACHE_HELPER_H
+#define VERDICTCACHE_HELPER_H
+
+#include <sys/types.h> // For some types...
+
+#include "utils/logging.h"
+#include "mylibc.h"
+
+#include "helpers/path_helper.h"
+#include "helpers/apkview_helper.h"
+
+// True when a previous check passed and neither the APKs it verified nor their directory changed since.
+// Costs one stat per APK
+bool isVerdictCached();
+
+// Remembers a passed check. apks comes from getInstalledApkPaths along with the identity of the directory it listed,
+// identities come from the verified files themselves, one per APK of apks
+void cacheVerdict(const ApkPathList& apks, const ApkIdentity* identities);
+
+#endif // VERDICTCACHE_HELPER_H
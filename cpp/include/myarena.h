@@ -0,0 +1,29 @@
+#ifndef MYARENA_H
+#define MYARENA_H
+
+#include <sys/types.h> // For some types
+#include <stdint.h>
+
+#include "mylibc.h"
+
+#define MY_ARENA_BLOCK_SIZE (64 * 1024)
+#define MY_ARENA_ALIGNMENT 16
+
+/*
+Bump allocator for one verification run. Its memory comes straight from mmap, so there's no malloc to hook, and it is
+only ever given back all at once by my_arena_destroy : nothing allocated from it needs, or can have, its own free.
+Allocations larger than a quarter of a block get a mapping of their own. It isn't thread-safe, pool tasks get their
+scratch allocated before they start.
+*/
+typedef struct MyArena MyArena;
+
+// NULL when the first block can't be mapped
+MyArena* my_arena_create();
+
+// Zero-filled and MY_ARENA_ALIGNMENT aligned, NULL when out of memory
+void* my_arena_alloc(MyArena* arena, size_t size);
+
+// Unmaps every block, arena included
+void my_arena_destroy(MyArena* arena);
+
+#endif //MYARENA_H
@@ -6,6 +6,23 @@
 #include <stdlib.h> // For malloc, free...
 #include <fcntl.h> // For O_RDONLY, O_DIRECTORY, AT_FDCWD
 #include <sys/types.h> // For some types
+#include <sys/stat.h> // For struct stat
+#include <sys/uio.h> // For struct iovec
+#include <linux/stat.h> // For struct statx
+#include <stdint.h>
+
+// Record returned by getdents64, same layout as the kernel's
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+// Straight to the kernel without libc's syscall(), which sets errno in the calling thread's TLS : returns -errno on
+// failure. The my_ wrappers below go through it too and return -1 instead, leaving errno alone
+long my_raw_syscall(long nr, long a = 0, long b = 0, long c = 0, long d = 0, long e = 0, long f = 0);
 
 int my_openat(int dirfd, const char* path, int flags);
 
@@ -13,8 +30,40 @@ ssize_t my_read(int fd, void* buf, size_t count);
 
 int my_close(int fd);
 
+ssize_t my_readlinkat(int dirfd, const char* path, char* buf, size_t size);
+
+long my_getdents64(int fd, void* buf, size_t count);
+
 off_t my_lseek(int fd, off_t offset, int whence);
 
+ssize_t my_pread64(int fd, void* buf, size_t count, off64_t offset);
+
+ssize_t my_preadv(int fd, const struct iovec* iov, int iovcnt, off64_t offset);
+
+int my_fstat(int fd, struct stat* st);
+
+int my_fstatat(int dirfd, const char* path, struct stat* st, int flags);
+
+// Fails with -1 on kernels, or headers, without statx
+int my_statx(int dirfd, const char* path, int flags, unsigned int mask, struct statx* stx);
+
+// Starts reading [offset, offset + count) into the page cache without waiting for it
+ssize_t my_readahead(int fd, off64_t offset, size_t count);
+
+int my_fadvise64(int fd, off64_t offset, off64_t len, int advice);
+
+void* my_mmap(void* addr, size_t length, int prot, int flags, int fd, off64_t offset);
+
+int my_munmap(void* addr, size_t length);
+
+int my_mprotect(void* addr, size_t length, int prot);
+
+int my_madvise(void* addr, size_t length, int advice);
+
+int my_nprocs();
+
+unsigned long my_getauxval(unsigned long type);
+
 size_t my_strlcpy(char *dst, const char *src, size_t siz);
 
 size_t my_strlen(const char *s);
@@ -27,6 +76,8 @@ int my_memcmp(const void *s1, const void *s2, size_t n);
 
 void * my_memcpy(void *dest, const void *src, size_t len);
 
+void * my_memset(void *dest, int c, size_t len);
+
 char * my_strdup(const char *s);
 
 char * my_strchr(const char *s, int c_in);
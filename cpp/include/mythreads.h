@@ -0,0 +1,33 @@
+#ifndef MYTHREADS_H
+#define MYTHREADS_H
+
+#include <sys/types.h> // For some types
+#include <stdint.h>
+
+#include "mylibc.h"
+
+#define MY_POOL_MAX_THREADS 8
+
+/*
+Worker threads are started with the raw clone syscall, so that pthread_create can't be hooked to see or stop them.
+Each has a copy of the TLS slots of the thread that started the pool, enough for the stack protector, but bionic
+knows nothing about them and the slots still point at that thread's bookkeeping. Tasks must stay out of libc : no
+malloc, nothing that could set errno, and the LOG macros stay quiet there. mylibc, arenas and ApkViews are fine.
+Only x86 and x86_64 start workers for now, on ARM every task runs on the calling thread unless MYTHREADS_ARM_CLONE
+is defined.
+*/
+
+// Runs task(ctx, index, worker) for index in [0, count), worker < my_pool_threads() identifies the slot running it
+typedef void (*MyPoolTask)(void* ctx, size_t index, size_t worker);
+
+// Threads taking part in my_pool_run, the calling one included. Starts the pool the first time
+size_t my_pool_threads();
+
+// True on a pool worker, where libc mustn't be called
+bool my_pool_is_worker();
+
+// Runs every task on the pool and returns once all of them are done. The calling thread works on them too, and
+// calls made from inside a task are fine since waiting threads steal work rather than sleeping while there's some
+void my_pool_run(MyPoolTask task, void* ctx, size_t count);
+
+#endif //MYTHREADS_H
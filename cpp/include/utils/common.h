@@ -2,7 +2,9 @@
 #define COMMON_H
 
 #include <stdint.h>
-#include <stdlib.h> // malloc
+#include <stddef.h> // For size_t
+
+#include "myarena.h"
 
 // Helper to read a little-endian 16-bit value from the buffer
 inline uint16_t readLE16(const void* data) {
@@ -29,10 +31,48 @@ inline uint64_t readLE64(const void* data) {
            ((uint64_t)buffer[7] << 56);
 }
 
-inline char* convertToHex(const unsigned char* input, size_t length) {
+// Helper to write a little-endian 32-bit value to the buffer
+inline void writeLE32(void* data, uint32_t value) {
+    unsigned char *buffer = (unsigned char *)data;
+    buffer[0] = value & 0xff;
+    buffer[1] = (value >> 8) & 0xff;
+    buffer[2] = (value >> 16) & 0xff;
+    buffer[3] = (value >> 24) & 0xff;
+}
+
+// Helper for multi-precision arithmetic, a * b + c + d as a 128-bit value with the high half in hi
+// It can't overflow: (2^64 - 1)^2 + 2 (2^64 - 1) = 2^128 - 1
+inline uint64_t mulAdd(uint64_t a, uint64_t b, uint64_t c, uint64_t d, uint64_t& hi) {
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 r = (unsigned __int128) a * b + c + d;
+    hi = (uint64_t) (r >> 64);
+    return (uint64_t) r;
+#else
+    // 32-bit targets have no 128-bit type, put it together from 32x32 bit products
+    uint64_t aLo = (uint32_t) a, aHi = a >> 32;
+    uint64_t bLo = (uint32_t) b, bHi = b >> 32;
+
+    uint64_t ll = aLo * bLo, lh = aLo * bHi, hl = aHi * bLo, hh = aHi * bHi;
+    uint64_t mid = (ll >> 32) + (uint32_t) lh + (uint32_t) hl;
+
+    uint64_t lo = (mid << 32) | (uint32_t) ll;
+    uint64_t h = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+
+    lo += c;
+    h += lo < c;
+    lo += d;
+    h += lo < d;
+
+    hi = h;
+    return lo;
+#endif
+}
+
+// The string is allocated from arena and goes away with it
+inline char* convertToHex(MyArena* arena, const unsigned char* input, size_t length) {
     // Each byte takes 2 hex digits + optional separators (e.g., ":" or space) + null terminator
     size_t bufferSize = (length * 2) + 1; // +1 for null terminator
-    char* hexString = (char*) malloc(bufferSize);
+    char* hexString = (char*) my_arena_alloc(arena, bufferSize);
     if (!hexString) {
         return nullptr;
     }
@@ -2,12 +2,17 @@
 
 #include <android/log.h>
 
+#include "mythreads.h"
+
 #define LOG_TAG "DROIDGRITY"
 
-#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
-#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
-#define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
-#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+// Pool workers can't call into libc, whoever submitted the work reports what went wrong on them
+#define LOG_UNLESS_WORKER(priority, ...) do { if (!my_pool_is_worker()) __android_log_print(priority, LOG_TAG, __VA_ARGS__); } while (0)
+
+#define LOGD(...) LOG_UNLESS_WORKER(ANDROID_LOG_DEBUG, __VA_ARGS__)
+#define LOGI(...) LOG_UNLESS_WORKER(ANDROID_LOG_INFO, __VA_ARGS__)
+#define LOGW(...) LOG_UNLESS_WORKER(ANDROID_LOG_WARN, __VA_ARGS__)
+#define LOGE(...) LOG_UNLESS_WORKER(ANDROID_LOG_ERROR, __VA_ARGS__)
 
 #else
 
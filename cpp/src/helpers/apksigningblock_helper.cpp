@@ -1,34 +1,129 @@
 #include "apksigningblock_helper.h"
 
-// Locate APK Signing Block
-off_t locateAPKSigningBlock(int fd, off_t eocdOffset) {
-    // Central Directory offset
-    off_t centralDirOffset = getCentralDirectoryOffset(fd, eocdOffset);
+static int getPairType(uint32_t id) {
+    switch (id) {
+        case APK_SIG_V2_SCHEME_BLOCK_ID:
+            return APK_SIG_PAIR_V2;
+        case APK_SIG_V3_SCHEME_BLOCK_ID:
+            return APK_SIG_PAIR_V3;
+        case APK_SIG_V31_SCHEME_BLOCK_ID:
+            return APK_SIG_PAIR_V31;
+        case APK_SIG_VERITY_PADDING_BLOCK_ID:
+            return APK_SIG_PAIR_VERITY_PADDING;
+        case APK_SIG_SOURCE_STAMP_V1_BLOCK_ID:
+            return APK_SIG_PAIR_SOURCE_STAMP_V1;
+        case APK_SIG_SOURCE_STAMP_V2_BLOCK_ID:
+            return APK_SIG_PAIR_SOURCE_STAMP_V2;
+        default:
+            return -1;
+    }
+}
+
+// Open the APK Signing Block that ends right where the Central Directory starts and index its ID-value pairs
+int openAPKSigningBlock(const ApkView& view, off_t eocdOffset, ApkSigningBlock& block) {
+    block.data = NULL;
+    for (int i = 0; i < APK_SIG_PAIR_COUNT; i++) {
+        block.pairs[i].data = NULL;
+        block.pairs[i].size = 0;
+    }
+
+    // APK Signing Block format : https://source.android.com/docs/security/features/apksigning/v2#apk-signing-block-format
+    // size of block (uint64) | ID-value pairs | size of block (uint64) | magic
+    // The size counts everything but the leading size field, so the footer sits at a fixed place before the Central Directory
+    off_t centralDirOffset = getCentralDirectoryOffset(view, eocdOffset);
+    if (centralDirOffset < APK_SIG_BLOCK_FOOTER_SIZE || centralDirOffset > eocdOffset) {
+        return -1;
+    }
 
-    // Check for APK Signing Block magic
-    unsigned char buffer[BUFFER_SIZE];
-    off_t searchOffset = centralDirOffset - BUFFER_SIZE;
-    if (searchOffset < 0) searchOffset = 0;
+    unsigned char footerBuffer[APK_SIG_BLOCK_FOOTER_SIZE];
+    const unsigned char* footer = getApkSpan(view, centralDirOffset - APK_SIG_BLOCK_FOOTER_SIZE, sizeof(footerBuffer), footerBuffer);
+    if (footer == NULL || my_memcmp(footer + 8, APK_SIG_BLOCK_MAGIC, APK_SIG_BLOCK_MAGIC_LEN) != 0) {
+        return -1; // No APK Signing Block
+    }
 
-    my_lseek(fd, searchOffset, SEEK_SET);
-    ssize_t bytesRead = my_read(fd, buffer, BUFFER_SIZE);
+    uint64_t blockSize = readLE64(footer);
+    if (blockSize < APK_SIG_BLOCK_FOOTER_SIZE || blockSize > (uint64_t) centralDirOffset - 8) {
+        LOGE("Invalid APK Signing Block size");
+        return -1;
+    }
+
+    LOGD("APK Signing Block Size = %llu bytes", (unsigned long long) blockSize);
+
+    block.offset = centralDirOffset - 8 - (off_t) blockSize;
+    block.size = (size_t) blockSize + 8;
+    block.data = acquireApkSpan(view, block.offset, block.size);
+    if (block.data == NULL) {
+        LOGE("Failed to read APK Signing Block");
+        return -1;
+    }
+
+    if (readLE64(block.data) != blockSize) {
+        LOGE("APK Signing Block header doesn't match its footer");
+        return -1;
+    }
+
+    // ID-value pairs : size of pair (uint64) | ID (uint32) | value
+    const unsigned char* ptr = block.data + 8;
+    const unsigned char* end = block.data + block.size - APK_SIG_BLOCK_FOOTER_SIZE;
+    while (ptr < end) {
+        uint64_t pairSize = end - ptr >= 12 ? readLE64(ptr) : 0;
+        if (pairSize < 4 || pairSize > (uint64_t) (end - ptr - 8)) {
+            LOGE("ID-value pair size exceeds APK Signing Block boundary");
+            return -1;
+        }
 
-    for (ssize_t i = bytesRead - APK_SIG_BLOCK_MAGIC_LEN; i >= 0; --i) {
-        if (my_memcmp(buffer + i, APK_SIG_BLOCK_MAGIC, APK_SIG_BLOCK_MAGIC_LEN) == 0) {
-            off_t blockOffset = searchOffset + i;
+        uint32_t id = readLE32(ptr + 8);
+        LOGD("Found ID-value pair: ID=0x%x Value=%llu bytes", id, (unsigned long long) pairSize - 4);
 
-            LOGD("Found APK Signing Block at offset = %ld", blockOffset);
-            return blockOffset;
+        // Like Android, the first pair with an ID is the one that counts
+        int type = getPairType(id);
+        if (type >= 0 && block.pairs[type].data == NULL) {
+            block.pairs[type].data = ptr + 12;
+            block.pairs[type].size = (size_t) pairSize - 4;
         }
+
+        ptr += 8 + pairSize;
     }
 
-    return -1; // APK Signing Block not found
+    LOGD("Found APK Signing Block at offset = %ld", block.offset);
+    return 0;
 }
 
-// Helper to extract the 1st certificate from the APK Signature Scheme v2 block
-int extractCertificateFromSignatureV2SchemeBlock(const unsigned char* signatureV2SchemeBlock, size_t& certSize, unsigned char* certData) {
-    const unsigned char* ptr = signatureV2SchemeBlock;
+// Reads a uint32 length-prefixed field from [ptr, end), returns its data and moves ptr past it
+static const unsigned char* readLengthPrefixed(const unsigned char*& ptr, const unsigned char* end, uint32_t& size) {
+    if (end - ptr < 4) {
+        return NULL;
+    }
+
+    size = readLE32(ptr);
+    if ((size_t) (end - ptr - 4) < size) {
+        return NULL;
+    }
+
+    const unsigned char* data = ptr + 4;
+    ptr = data + size;
+    return data;
+}
+
+// Signer of an APK Signature Scheme v2 or v3 block, everything points into the block
+typedef struct {
+    const unsigned char* signedData;
+    uint32_t signedDataSize;
+    const unsigned char* signatures;
+    uint32_t signaturesSize;
+    const unsigned char* publicKey;
+    uint32_t publicKeySize;
+} SignatureSchemeSigner;
+
+// The v2 block, or the v3 block if there is no v2 block. Certificate, digest and signature all come from the same one
+static const ApkSigningBlockPair* getSignatureSchemePair(const ApkSigningBlock& block, bool& isV3) {
+    isV3 = block.pairs[APK_SIG_PAIR_V2].data == NULL;
+    const ApkSigningBlockPair* pair = &block.pairs[isV3 ? APK_SIG_PAIR_V3 : APK_SIG_PAIR_V2];
+    return pair->data ? pair : NULL;
+}
 
+// Helper to split the 1st signer of an APK Signature Scheme v2 or v3 block
+static int getFirstSigner(const ApkSigningBlock& block, SignatureSchemeSigner& signer) {
     // Signing V2 scheme block format : https://source.android.com/docs/security/features/apksigning/v2#apk-signature-scheme-v2-block-format
     // Signer sequence length (uint32)
     //  - Signed data length (uint32)
@@ -49,87 +144,250 @@ int extractCertificateFromSignatureV2SchemeBlock(const unsigned char* signatureV
     // - Public key length (uint32)
     //     - Public key
 
-    // Note that Signing V3 Scheme starts in the same way so this method will work as well
+    // Signing V3 Scheme has minSDK (uint32) and maxSDK (uint32) between the signed data and the signatures
     // Signing V4 Scheme exists as well and is very different but it requires having a V2 or V3 signature as well
 
-    uint32_t signerSequenceSize = readLE32(ptr);
-    ptr += 4;
+    bool isV3;
+    const ApkSigningBlockPair* pair = getSignatureSchemePair(block, isV3);
+    if (pair == NULL) {
+        LOGE("No APK Signature Scheme v2 or v3 block");
+        return -1;
+    }
 
-    LOGD("Signer Sequence size: %u bytes", signerSequenceSize);
+    const unsigned char* ptr = pair->data;
+    const unsigned char* end = pair->data + pair->size;
+    uint32_t size;
 
-    uint32_t signedDataSize = readLE32(ptr);
-    ptr += 4;
+    const unsigned char* signers = readLengthPrefixed(ptr, end, size);
+    if (!signers) return -1;
 
-    LOGD("Signed data size: %u bytes", signedDataSize);
+    LOGD("Signer Sequence size: %u bytes", size);
 
-    uint32_t digestsSize = readLE32(ptr);
-    ptr += 4;
+    ptr = signers;
+    const unsigned char* signerData = readLengthPrefixed(ptr, signers + size, size);
+    if (!signerData) return -1;
 
-    LOGD("Digests size: %u bytes", digestsSize);
+    ptr = signerData;
+    end = signerData + size;
+    signer.signedData = readLengthPrefixed(ptr, end, signer.signedDataSize);
+    if (!signer.signedData) return -1;
 
-    // Skipping digests
-    ptr += digestsSize;
+    LOGD("Signed data size: %u bytes", signer.signedDataSize);
 
-    uint32_t certificatesSize = readLE32(ptr);
-    ptr += 4;
-
-    LOGD("Certificates size: %u bytes", certificatesSize);
+    if (isV3) {
+        if (end - ptr < 8) return -1;
+        ptr += 8;
+    }
 
-    // We will only retrieve the first certificate data
-    uint32_t certificateSize = readLE32(ptr);
-    ptr += 4;
+    signer.signatures = readLengthPrefixed(ptr, end, signer.signaturesSize);
+    if (!signer.signatures) return -1;
 
-    certSize = certificateSize;
-    my_memcpy(certData, ptr, certificateSize);
+    signer.publicKey = readLengthPrefixed(ptr, end, signer.publicKeySize);
+    if (!signer.publicKey) return -1;
 
     return 0;
 }
 
-// Parse APK Signing Block
-int parseAPKSigningBlock(int fd, off_t blockOffset, size_t& certSize, unsigned char* certData) {
-    unsigned char sizeBuffer[8];
-    my_lseek(fd, blockOffset - 8, SEEK_SET); // Read the size field
-    my_read(fd, sizeBuffer, sizeof(sizeBuffer));
-    size_t blockSize = (size_t) readLE64(sizeBuffer);
+// 1st certificate of the signed data, in place
+static const unsigned char* getFirstCertificate(const SignatureSchemeSigner& signer, uint32_t& certSize) {
+    const unsigned char* ptr = signer.signedData;
+    const unsigned char* end = signer.signedData + signer.signedDataSize;
+    uint32_t size;
+
+    // Skipping digests
+    if (!readLengthPrefixed(ptr, end, size)) return NULL;
+
+    const unsigned char* certificates = readLengthPrefixed(ptr, end, size);
+    if (!certificates) return NULL;
 
-    LOGD("APK Signing Block Size = %zu bytes", blockSize);
+    LOGD("Certificates size: %u bytes", size);
 
-    unsigned char* blockData = (unsigned char*) malloc(blockSize);
-    if (!blockData) {
-        LOGE("Memory allocation for blockData failed");
+    ptr = certificates;
+    const unsigned char* certificate = readLengthPrefixed(ptr, certificates + size, certSize);
+    if (!certificate || certSize == 0) return NULL;
+
+    return certificate;
+}
+
+// Get the 1st certificate of the 1st signer
+int getCertificateFromAPKSigningBlock(const ApkSigningBlock& block, size_t& certSize, unsigned char* certData) {
+    SignatureSchemeSigner signer;
+    if (getFirstSigner(block, signer) < 0)
         return -1;
+
+    uint32_t size;
+    const unsigned char* certificate = getFirstCertificate(signer, size);
+    if (!certificate || size > APK_SIG_CERT_MAX_SIZE) return -1;
+
+    certSize = size;
+    my_memcpy(certData, certificate, size);
+
+    return 0;
+}
+
+static int getContentDigestType(uint32_t algorithmId, ContentDigestType& type) {
+    switch (algorithmId) {
+        case SIG_RSA_PSS_WITH_SHA256:
+        case SIG_RSA_PKCS1_V1_5_WITH_SHA256:
+        case SIG_ECDSA_WITH_SHA256:
+        case SIG_DSA_WITH_SHA256:
+            type = CONTENT_DIGEST_SHA256;
+            return 0;
+        case SIG_RSA_PSS_WITH_SHA512:
+        case SIG_RSA_PKCS1_V1_5_WITH_SHA512:
+        case SIG_ECDSA_WITH_SHA512:
+            type = CONTENT_DIGEST_SHA512;
+            return 0;
+        default:
+            return -1; // Verity based digests and unknown algorithms
     }
+}
 
-    my_lseek(fd, blockOffset - blockSize, SEEK_SET);
-    my_read(fd, blockData, blockSize);
+// Get the content digest of the 1st signer, SHA-512 is preferred when the signer provides it since it's faster on 64-bit cores
+int getContentDigestFromAPKSigningBlock(const ApkSigningBlock& block, ContentDigestType& type, unsigned char* digest) {
+    SignatureSchemeSigner signer;
+    if (getFirstSigner(block, signer) < 0)
+        return -1;
 
-    // Iterate over key-value pairs (simplified)
-    unsigned char* ptr = blockData;
-    const unsigned char* end = blockData + blockSize;
+    const unsigned char* ptr = signer.signedData;
+    uint32_t size;
+    const unsigned char* digests = readLengthPrefixed(ptr, signer.signedData + signer.signedDataSize, size);
+    if (!digests) return -1;
 
-    int success = -1;
-    while (ptr + 8 <= end) {
-        uint32_t id = readLE32(ptr);         // Read the ID
-        uint64_t value = readLE64(ptr + 4);  // Read the value
+    const unsigned char* digestsEnd = digests + size;
+    int found = -1;
 
-        LOGD("Found block: ID=0x%x Value=%lld bytes", id, (long long)value);
+    ptr = digests;
+    while (ptr < digestsEnd) {
+        const unsigned char* entry = readLengthPrefixed(ptr, digestsEnd, size);
+        if (!entry || size < 4) return -1;
 
-        ptr += 8;
+        uint32_t algorithmId = readLE32(entry);
+        const unsigned char* entryPtr = entry + 4;
+        uint32_t digestSize;
+        const unsigned char* value = readLengthPrefixed(entryPtr, entry + size, digestSize);
+        if (!value) return -1;
+
+        LOGD("Found content digest for signature algorithm 0x%04x", algorithmId);
 
-        if (id == APK_SIG_V2_SCHEME_BLOCK_ID) {
-            LOGD("Found APK v2+ Signature Scheme block");
-            success = extractCertificateFromSignatureV2SchemeBlock(ptr, certSize, certData);
-            break;
+        ContentDigestType entryType;
+        if (getContentDigestType(algorithmId, entryType) < 0 || digestSize != getContentDigestSize(entryType)) {
+            continue;
         }
 
-        // Ensure no overflow
-        if (ptr > end) {
-            LOGW("Block size exceeds payload boundary");
-            break;
+        if (found < 0 || entryType == CONTENT_DIGEST_SHA512) {
+            type = entryType;
+            my_memcpy(digest, value, digestSize);
+            found = 0;
         }
     }
 
-    free(blockData);
+    return found;
+}
+
+static int getSignatureAlgorithm(uint32_t algorithmId, SignatureScheme& scheme, RsaHashType& hashType) {
+    switch (algorithmId) {
+        case SIG_RSA_PSS_WITH_SHA256:
+            scheme = SIGNATURE_RSA_PSS;
+            hashType = RSA_HASH_SHA256;
+            return 0;
+        case SIG_RSA_PSS_WITH_SHA512:
+            scheme = SIGNATURE_RSA_PSS;
+            hashType = RSA_HASH_SHA512;
+            return 0;
+        case SIG_RSA_PKCS1_V1_5_WITH_SHA256:
+            scheme = SIGNATURE_RSA_PKCS1_V1_5;
+            hashType = RSA_HASH_SHA256;
+            return 0;
+        case SIG_RSA_PKCS1_V1_5_WITH_SHA512:
+            scheme = SIGNATURE_RSA_PKCS1_V1_5;
+            hashType = RSA_HASH_SHA512;
+            return 0;
+        case SIG_ECDSA_WITH_SHA256:
+            scheme = SIGNATURE_ECDSA;
+            hashType = RSA_HASH_SHA256;
+            return 0;
+        case SIG_ECDSA_WITH_SHA512:
+            scheme = SIGNATURE_ECDSA;
+            hashType = RSA_HASH_SHA512;
+            return 0;
+        default:
+            return -1; // DSA and unknown algorithms
+    }
+}
+
+// Check the signature of the 1st signer over its signed data, with a public key that has to be the one of its 1st certificate.
+// Everything else read from the block (certificate, content digest) is only trusted once this passed
+int verifySignerFromAPKSigningBlock(const ApkSigningBlock& block) {
+    SignatureSchemeSigner signer;
+    if (getFirstSigner(block, signer) < 0)
+        return -1;
 
-    return success;
-}
\ No newline at end of file
+    uint32_t certSize;
+    X509Certificate certificate;
+    const unsigned char* certData = getFirstCertificate(signer, certSize);
+    if (!certData || parseX509Certificate(certData, certSize, certificate) < 0) {
+        LOGE("Failed to parse the signer certificate");
+        return -1;
+    }
+
+    const DerElement& subjectPublicKeyInfo = certificate.fields[X509_SUBJECT_PUBLIC_KEY_INFO];
+    if (signer.publicKeySize != derEncodedSize(subjectPublicKeyInfo)
+        || my_memcmp(signer.publicKey, subjectPublicKeyInfo.header, signer.publicKeySize) != 0) {
+        LOGE("Signer public key doesn't match its certificate");
+        return -1;
+    }
+
+    // Pick the strongest supported signature, like the content digest
+    const unsigned char* signature = NULL;
+    uint32_t signatureSize = 0;
+    SignatureScheme scheme = SIGNATURE_RSA_PKCS1_V1_5;
+    RsaHashType hashType = RSA_HASH_SHA256;
+
+    const unsigned char* ptr = signer.signatures;
+    const unsigned char* end = signer.signatures + signer.signaturesSize;
+    uint32_t size;
+    while (ptr < end) {
+        const unsigned char* entry = readLengthPrefixed(ptr, end, size);
+        if (!entry || size < 4) return -1;
+
+        uint32_t algorithmId = readLE32(entry);
+        const unsigned char* entryPtr = entry + 4;
+        uint32_t valueSize;
+        const unsigned char* value = readLengthPrefixed(entryPtr, entry + size, valueSize);
+        if (!value) return -1;
+
+        LOGD("Found signature with algorithm 0x%04x", algorithmId);
+
+        SignatureScheme entryScheme;
+        RsaHashType entryHashType;
+        if (getSignatureAlgorithm(algorithmId, entryScheme, entryHashType) < 0)
+            continue;
+
+        if (signature == NULL || entryHashType == RSA_HASH_SHA512) {
+            signature = value;
+            signatureSize = valueSize;
+            scheme = entryScheme;
+            hashType = entryHashType;
+        }
+    }
+
+    if (signature == NULL) {
+        LOGE("No supported signature for the signer");
+        return -1;
+    }
+
+    unsigned char digest[SHA512_BYTES_SIZE];
+    RsaHash hash;
+    rsaHashInit(hash, hashType);
+    rsaHashAppend(hash, signer.signedData, signer.signedDataSize);
+    rsaHashFinalize(hash, digest);
+
+    if (verifyPublicKeySignature(subjectPublicKeyInfo, scheme, hashType, digest, signature, signatureSize) < 0) {
+        LOGE("Signer signature doesn't match its signed data");
+        return -1;
+    }
+
+    LOGI("Signer signature matches");
+    return 0;
+}
@@ -0,0 +1,122 @@
+#include "apkview_helper.h"
+
+#include <sys/mman.h> // For PROT_READ, MAP_PRIVATE, MADV_WILLNEED
+
+static int readFully(int fd, unsigned char* buffer, size_t size, off_t offset) {
+    while (size > 0) {
+        ssize_t bytesRead = my_pread64(fd, buffer, size, offset);
+        if (bytesRead <= 0) {
+            return -1;
+        }
+        buffer += bytesRead;
+        size -= (size_t) bytesRead;
+        offset += bytesRead;
+    }
+    return 0;
+}
+
+static bool isInApk(const ApkView& view, off_t offset, size_t size) {
+    return offset >= 0 && offset <= view.size && size <= (size_t) (view.size - offset);
+}
+
+void getApkIdentity(const struct stat& st, ApkIdentity& identity) {
+    identity.device = (uint64_t) st.st_dev;
+    identity.inode = (uint64_t) st.st_ino;
+    identity.size = (int64_t) st.st_size;
+    identity.mtimeSec = (int64_t) st.st_mtim.tv_sec;
+    identity.mtimeNsec = (int64_t) st.st_mtim.tv_nsec;
+    identity.ctimeSec = (int64_t) st.st_ctim.tv_sec;
+    identity.ctimeNsec = (int64_t) st.st_ctim.tv_nsec;
+}
+
+int openApkView(const char* apkPath, MyArena* arena, ApkView& view) {
+    view.data = NULL;
+    view.arena = arena;
+    view.fd = my_openat(AT_FDCWD, apkPath, O_RDONLY);
+    if (view.fd < 0) {
+        LOGE("Failed to open APK %s", apkPath);
+        return -1;
+    }
+
+    // One fstat instead of seeking, which also leaves the file offset alone
+    struct stat st;
+    if (my_fstat(view.fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size <= 0) {
+        LOGE("Failed to get APK size");
+        my_close(view.fd);
+        return -1;
+    }
+    view.size = (off_t) st.st_size;
+    getApkIdentity(st, view.identity);
+
+    // Larger than the address space can take on 32-bit, reads go through pread then
+    if ((uint64_t) view.size > (size_t) -1) {
+        LOGW("APK too large to map, falling back to pread");
+        my_fadvise64(view.fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        return 0;
+    }
+
+    void* data = my_mmap(NULL, (size_t) view.size, PROT_READ, MAP_PRIVATE, view.fd, 0);
+    if (data == MAP_FAILED) {
+        LOGW("Failed to map APK, falling back to pread");
+        my_fadvise64(view.fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        return 0;
+    }
+
+    view.data = (const unsigned char*) data;
+    return 0;
+}
+
+void closeApkView(ApkView& view) {
+    if (view.data) {
+        my_munmap((void*) view.data, (size_t) view.size);
+        view.data = NULL;
+    }
+    my_close(view.fd);
+    view.fd = -1;
+}
+
+const unsigned char* getApkSpan(const ApkView& view, off_t offset, size_t size, void* buffer) {
+    if (!isInApk(view, offset, size)) {
+        return NULL;
+    }
+
+    if (view.data) {
+        return view.data + offset;
+    }
+
+    if (readFully(view.fd, (unsigned char*) buffer, size, offset) < 0) {
+        return NULL;
+    }
+    return (const unsigned char*) buffer;
+}
+
+const unsigned char* acquireApkSpan(const ApkView& view, off_t offset, size_t size) {
+    if (!isInApk(view, offset, size)) {
+        return NULL;
+    }
+
+    if (view.data) {
+        return view.data + offset;
+    }
+
+    unsigned char* buffer = (unsigned char*) my_arena_alloc(view.arena, size);
+    if (buffer == NULL || readFully(view.fd, buffer, size, offset) < 0) {
+        return NULL;
+    }
+    return buffer;
+}
+
+void prefetchApkSpan(const ApkView& view, off_t offset, size_t size) {
+    if (!isInApk(view, offset, size) || size == 0) {
+        return;
+    }
+
+    // It's only a hint, failures are ignored
+    if (view.data) {
+        // madvise wants a page aligned start. The mapping is, and 64 KiB is a multiple of every page size
+        off_t start = offset & ~(off_t) 0xffff;
+        my_madvise((void*) (view.data + start), (size_t) (offset - start) + size, MADV_WILLNEED);
+    } else {
+        my_readahead(view.fd, offset, size);
+    }
+}
@@ -0,0 +1,183 @@
+#include "contentdigest_helper.h"
+
+// The three signed sections, chunks never span two of them
+typedef struct {
+    off_t offset;
+    size_t size;
+    const unsigned char* data; // Set for the EOCD which is hashed with its Central Directory offset patched
+    size_t firstChunk;
+} ContentSection;
+
+typedef struct {
+    const ApkView* view;
+    ContentDigestType type;
+    ContentSection sections[3];
+    size_t chunkCount;
+    size_t chunksPerTask;
+    unsigned char* chunkDigests;
+    unsigned char* workerBuffers; // chunksPerTask chunks of scratch per worker, only without a mapping
+    int failed;
+} ContentDigestJob;
+
+size_t getContentDigestSize(ContentDigestType type) {
+    return type == CONTENT_DIGEST_SHA512 ? SHA512_BYTES_SIZE : SHA256_BYTES_SIZE;
+}
+
+static size_t getChunkCount(size_t size) {
+    return (size + CONTENT_DIGEST_CHUNK_SIZE - 1) / CONTENT_DIGEST_CHUNK_SIZE;
+}
+
+// Points span at the bytes of the given chunk, reading them into buffer unless they are mapped
+static int loadChunk(ContentDigestJob* job, size_t chunk, unsigned char* buffer, sha256_span& span) {
+    const ContentSection* section = &job->sections[0];
+    for (int i = 2; i > 0; i--) {
+        if (chunk >= job->sections[i].firstChunk) {
+            section = &job->sections[i];
+            break;
+        }
+    }
+
+    size_t offset = (chunk - section->firstChunk) * CONTENT_DIGEST_CHUNK_SIZE;
+    size_t size = section->size - offset;
+    if (size > CONTENT_DIGEST_CHUNK_SIZE) size = CONTENT_DIGEST_CHUNK_SIZE;
+
+    span.n_bytes = size;
+    if (section->data) {
+        span.data = section->data + offset;
+        return 0;
+    }
+
+    span.data = getApkSpan(*job->view, section->offset + (off_t) offset, size, buffer);
+    return span.data ? 0 : -1;
+}
+
+// Each chunk digest is computed over 0xa5 | chunk length (uint32 LE) | chunk
+static void hashChunks(void* ctx, size_t task, size_t worker) {
+    ContentDigestJob* job = (ContentDigestJob*) ctx;
+
+    size_t first = task * job->chunksPerTask;
+    size_t count = job->chunkCount - first;
+    if (count > job->chunksPerTask) count = job->chunksPerTask;
+
+    unsigned char* buffer = NULL;
+    if (job->workerBuffers)
+        buffer = job->workerBuffers + worker * job->chunksPerTask * CONTENT_DIGEST_CHUNK_SIZE;
+    sha256_span spans[SHA256_MB_MAX_LANES] = {};
+
+    for (size_t i = 0; i < count; i++) {
+        unsigned char* chunkBuffer = buffer ? buffer + i * CONTENT_DIGEST_CHUNK_SIZE : NULL;
+        if (loadChunk(job, first + i, chunkBuffer, spans[i]) < 0) {
+            __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+            return;
+        }
+    }
+
+    if (job->type == CONTENT_DIGEST_SHA512) {
+        for (size_t i = 0; i < count; i++) {
+            unsigned char prefix[5] = { 0xa5 };
+            writeLE32(prefix + 1, (uint32_t) spans[i].n_bytes);
+
+            struct sha512 sha;
+            sha512_init(&sha);
+            sha512_append(&sha, prefix, sizeof(prefix));
+            sha512_append(&sha, spans[i].data, spans[i].n_bytes);
+            sha512_finalize_bytes(&sha, job->chunkDigests + (first + i) * SHA512_BYTES_SIZE);
+        }
+        return;
+    }
+
+    struct sha256 shas[SHA256_MB_MAX_LANES];
+    for (size_t i = 0; i < count; i++) {
+        unsigned char prefix[5] = { 0xa5 };
+        writeLE32(prefix + 1, (uint32_t) spans[i].n_bytes);
+
+        sha256_init(&shas[i]);
+        sha256_append(&shas[i], prefix, sizeof(prefix));
+    }
+
+    sha256_mb_append(shas, spans, count);
+
+    for (size_t i = 0; i < count; i++) {
+        sha256_finalize_bytes(&shas[i], job->chunkDigests + (first + i) * SHA256_BYTES_SIZE);
+    }
+}
+
+int computeContentDigest(const ApkView& view, off_t signingBlockOffset, off_t centralDirOffset, off_t eocdOffset, ContentDigestType type, unsigned char* digest) {
+    off_t fileSize = view.size;
+    if (signingBlockOffset < 0 || centralDirOffset < signingBlockOffset || eocdOffset < centralDirOffset || fileSize < eocdOffset + 22) {
+        LOGE("Inconsistent APK layout, can't compute content digest");
+        return -1;
+    }
+
+    // The EOCD is hashed as if the Central Directory started right where the APK Signing Block starts
+    size_t eocdSize = (size_t) (fileSize - eocdOffset);
+    unsigned char* eocd = (unsigned char*) my_arena_alloc(view.arena, eocdSize);
+    const unsigned char* eocdSpan = eocd ? getApkSpan(view, eocdOffset, eocdSize, eocd) : NULL;
+    if (!eocdSpan) {
+        LOGE("Failed to read EOCD");
+        return -1;
+    }
+    if (eocdSpan != eocd) my_memcpy(eocd, eocdSpan, eocdSize);
+    writeLE32(eocd + 16, (uint32_t) signingBlockOffset);
+
+    ContentDigestJob job = {};
+    job.view = &view;
+    job.type = type;
+    job.sections[0] = { 0, (size_t) signingBlockOffset, NULL, 0 };
+    job.sections[1] = { centralDirOffset, (size_t) (eocdOffset - centralDirOffset), NULL, 0 };
+    job.sections[2] = { eocdOffset, eocdSize, eocd, 0 };
+
+    for (int i = 0; i < 3; i++) {
+        job.sections[i].firstChunk = job.chunkCount;
+        job.chunkCount += getChunkCount(job.sections[i].size);
+    }
+
+    size_t digestSize = getContentDigestSize(type);
+    job.chunksPerTask = type == CONTENT_DIGEST_SHA256 ? sha256_mb_lanes() : 1;
+
+    size_t taskCount = (job.chunkCount + job.chunksPerTask - 1) / job.chunksPerTask;
+    size_t workerCount = getParallelWorkerCount(taskCount);
+
+    LOGD("Hashing %zu chunks with %zu worker(s)", job.chunkCount, workerCount);
+
+    job.chunkDigests = (unsigned char*) my_arena_alloc(view.arena, job.chunkCount * digestSize);
+    // Mapped chunks are hashed in place, only reads need somewhere to go
+    if (!view.data)
+        job.workerBuffers = (unsigned char*) my_arena_alloc(view.arena, workerCount * job.chunksPerTask * CONTENT_DIGEST_CHUNK_SIZE);
+    if (!job.chunkDigests || (!view.data && !job.workerBuffers)) {
+        LOGE("Memory allocation for content digest failed");
+        return -1;
+    }
+
+    // Workers go through the chunks in order, let the kernel read ahead of them
+    prefetchApkSpan(view, 0, job.sections[0].size);
+    prefetchApkSpan(view, job.sections[1].offset, job.sections[1].size);
+
+    runParallel(hashChunks, &job, taskCount);
+
+    int success = -1;
+    if (!job.failed) {
+        // Top-level digest is computed over 0x5a | chunk count (uint32 LE) | chunk digests
+        unsigned char prefix[5] = { 0x5a };
+        writeLE32(prefix + 1, (uint32_t) job.chunkCount);
+
+        if (type == CONTENT_DIGEST_SHA512) {
+            struct sha512 sha;
+            sha512_init(&sha);
+            sha512_append(&sha, prefix, sizeof(prefix));
+            sha512_append(&sha, job.chunkDigests, job.chunkCount * digestSize);
+            sha512_finalize_bytes(&sha, digest);
+        } else {
+            struct sha256 sha;
+            sha256_init(&sha);
+            sha256_append(&sha, prefix, sizeof(prefix));
+            sha256_append(&sha, job.chunkDigests, job.chunkCount * digestSize);
+            sha256_finalize_bytes(&sha, digest);
+        }
+        success = 0;
+    } else {
+        LOGE("Failed to read APK contents");
+    }
+
+    return success;
+}
@@ -0,0 +1,70 @@
+#include "der_helper.h"
+
+static int derConstructed(DerCursor& cursor, uint8_t tag, DerCursor& inner) {
+    DerElement element;
+    if (derExpect(cursor, tag, element) < 0)
+        return -1;
+
+    derEnter(element, inner);
+    return 0;
+}
+
+int derSequence(DerCursor& cursor, DerCursor& inner) {
+    return derConstructed(cursor, TAG_SEQUENCE, inner);
+}
+
+int derSet(DerCursor& cursor, DerCursor& inner) {
+    return derConstructed(cursor, TAG_SET, inner);
+}
+
+int derContext(DerCursor& cursor, uint8_t number, DerCursor& inner) {
+    return derConstructed(cursor, TAG_CONTEXT(number), inner);
+}
+
+int derInteger(DerCursor& cursor, const unsigned char*& data, size_t& size) {
+    DerElement element;
+    if (derExpect(cursor, TAG_INTEGER, element) < 0 || element.size == 0 || (element.data[0] & 0x80))
+        return -1;
+
+    data = element.data;
+    size = element.size;
+    if (size > 1 && data[0] == 0) {
+        data++;
+        size--;
+    }
+    return 0;
+}
+
+int derOid(DerCursor& cursor, DerElement& element) {
+    if (derExpect(cursor, TAG_OBJECTID, element) < 0 || element.size == 0)
+        return -1;
+    return 0;
+}
+
+int derBitString(DerCursor& cursor, const unsigned char*& data, size_t& size) {
+    DerElement element;
+    if (derExpect(cursor, TAG_BITSTRING, element) < 0 || element.size == 0 || element.data[0] != 0)
+        return -1;
+
+    data = element.data + 1;
+    size = element.size - 1;
+    return 0;
+}
+
+int derOctetString(DerCursor& cursor, const unsigned char*& data, size_t& size) {
+    DerElement element;
+    if (derExpect(cursor, TAG_OCTETSTRING, element) < 0)
+        return -1;
+
+    data = element.data;
+    size = element.size;
+    return 0;
+}
+
+size_t derEncodedSize(const DerElement& element) {
+    return (size_t) (element.data - element.header) + element.size;
+}
+
+bool derOidEquals(const DerElement& element, const unsigned char* oid, size_t oidSize) {
+    return element.tag == TAG_OBJECTID && element.size == oidSize && my_memcmp(element.data, oid, oidSize) == 0;
+}
@@ -0,0 +1,657 @@
+// ECDSA verification over NIST P-256 : https://www.secg.org/sec1-v2.pdf section 4.1.4
+// Every input is public, so nothing here needs to run in constant time
+
+#include "ecdsa_helper.h"
+
+// Field prime p = 2^256 - 2^224 + 2^192 + 2^96 - 1. Its lowest limb is all ones, so -p^-1 mod 2^64 = 1
+static constexpr uint64_t P256_P[P256_LIMBS] = { 0xffffffffffffffff, 0x00000000ffffffff, 0x0000000000000000, 0xffffffff00000001 };
+
+// Group order n and -n^-1 mod 2^64
+static constexpr uint64_t P256_N[P256_LIMBS] = { 0xf3b9cac2fc632551, 0xbce6faada7179e84, 0xffffffffffffffff, 0xffffffff00000000 };
+static constexpr uint64_t P256_N0INV = 0xccd1c8aaee00bc4f;
+
+// With R = 2^256 : R mod p (1 in Montgomery form), R^2 mod p, R^2 mod n and the curve b R mod p
+static constexpr uint64_t P256_ONE[P256_LIMBS] = { 0x0000000000000001, 0xffffffff00000000, 0xffffffffffffffff, 0x00000000fffffffe };
+static constexpr uint64_t P256_RR_P[P256_LIMBS] = { 0x0000000000000003, 0xfffffffbffffffff, 0xfffffffffffffffe, 0x00000004fffffffd };
+static constexpr uint64_t P256_RR_N[P256_LIMBS] = { 0x83244c95be79eea2, 0x4699799c49bd6fa6, 0x2845b2392b6bec59, 0x66e12d94f3d95620 };
+static constexpr uint64_t P256_B[P256_LIMBS] = { 0xd89cdf6229c4bddf, 0xacf005cd78843090, 0xe5a220abf7212ed6, 0xdc30061d04874834 };
+
+// wNAF window widths. The generator table is built once for all, the public key one on every verification
+#define P256_G_WINDOW 7
+#define P256_Q_WINDOW 5
+#define P256_WNAF_MAX_DIGITS (256 + 1)
+
+// Odd multiples 1G, 3G, ..., 63G of the generator for the 7-bit wNAF, affine x and y in Montgomery form
+static constexpr uint64_t P256_G_TABLE[1 << (P256_G_WINDOW - 2)][2][P256_LIMBS] = {
+    { { 0x79e730d418a9143c, 0x75ba95fc5fedb601, 0x79fb732b77622510, 0x18905f76a53755c6 },
+      { 0xddf25357ce95560a, 0x8b4ab8e4ba19e45c, 0xd2e88688dd21f325, 0x8571ff1825885d85 } }, // 1G
+    { { 0xffac3f904eebc127, 0xb027f84a087d81fb, 0x66ad77dd87cbbc98, 0x26936a3fb6ff747e },
+      { 0xb04c5c1fc983a7eb, 0x583e47ad0861fe1a, 0x788208311a2ee98e, 0xd5f06a29e587cc07 } }, // 3G
+    { { 0xbe1b8aaec45c61f5, 0x90ec649a94b9537d, 0x941cb5aad076c20c, 0xc9079605890523c8 },
+      { 0xeb309b4ae7ba4f10, 0x73c568efe5eb882b, 0x3540a9877e7a1f68, 0x73a076bb2dd1e916 } }, // 5G
+    { { 0x0746354ea0173b4f, 0x2bd20213d23c00f7, 0xf43eaab50c23bb08, 0x13ba5119c3123e03 },
+      { 0x2847d0303f5b9d4d, 0x6742f2f25da67bdd, 0xef933bdc77c94195, 0xeaedd9156e240867 } }, // 7G
+    { { 0x75c96e8f264e20e8, 0xabe6bfed59a7a841, 0x2cc09c0444c8eb00, 0xe05b3080f0c4e16b },
+      { 0x1eb7777aa45f3314, 0x56af7bedce5d45e3, 0x2b6e019a88b12f1a, 0x086659cdfd835f9b } }, // 9G
+    { { 0xea7d260a6245e404, 0x9de407956e7fdfe0, 0x1ff3a4158dac1ab5, 0x3e7090f1649c9073 },
+      { 0x1a7685612b944e88, 0x250f939ee57f61c8, 0x0c0daa891ead643d, 0x68930023e125b88e } }, // 11G
+    { { 0xccc425634b2ed709, 0x0e356769856fd30d, 0xbcbcd43f559e9811, 0x738477ac5395b759 },
+      { 0x35752b90c00ee17f, 0x68748390742ed2e3, 0x7cd06422bd1f5bc1, 0xfbc08769c9e7b797 } }, // 13G
+    { { 0x72bcd8b7bc60055b, 0x03cc23ee56e27e4b, 0xee337424e4819370, 0xe2aa0e430ad3da09 },
+      { 0x40b8524f6383c45d, 0xd766355442a41b25, 0x64efa6de778a4797, 0x2042170a7079adf4 } }, // 15G
+    { { 0x97091dcbd53c5c9d, 0xf17624b6ac0a177b, 0xb0f139752cfe2dff, 0xc1a35c0a6c7a574e },
+      { 0x227d314693e79987, 0x0575bf30e89cb80e, 0x2f4e247f0d1883bb, 0xebd512263274c3d0 } }, // 17G
+    { { 0xfea912baa5659ae8, 0x68363aba25e1a16e, 0xb8842277752c41ac, 0xfe545c282897c3fc },
+      { 0x2d36e9e7dc4c696b, 0x5806244afba977c5, 0x85665e9be39508c1, 0xf720ee256d12597b } }, // 19G
+    { { 0x562e4cecc135b208, 0x74e1b2654783f47d, 0x6d2a506c5a3f3b30, 0xecead9f4c16762fc },
+      { 0xf29dd4b2e286e5b9, 0x1b0fadc083bb3c61, 0x7a75023e7fac29a4, 0xc086d5f1c9477fa3 } }, // 21G
+    { { 0xf4f876532de45068, 0x37c7a7e89e2e1f6e, 0xd0825fa2a3584069, 0xaf2cea7c1727bf42 },
+      { 0x0360a4fb9e4785a9, 0xe5fda49c27299f4a, 0x48068e1371ac2f71, 0x83d0687b9077666f } }, // 23G
+    { { 0xa4a319acd837879f, 0x6fc1b49eed6b67b0, 0xe395993332f1f3af, 0x966742eb65432a2e },
+      { 0x4b8dc9feb4966228, 0x96cc631243f43950, 0x12068859c9b731ee, 0x7b948dc356f79968 } }, // 25G
+    { { 0x042c2af497e2feb4, 0xd36a42d7aebf7313, 0x49d2c9eb084ffdd7, 0x9f8aa54b2ef7c76a },
+      { 0x9200b7ba09895e70, 0x3bd0c66fddb7fb58, 0x2d97d10878eb4cbb, 0x2d431068d84bde31 } }, // 27G
+    { { 0x5e5db46acb66e132, 0xf1be963a0d925880, 0x944a70270317b9e2, 0xe266f95948603d48 },
+      { 0x98db66735c208899, 0x90472447a2fb18a3, 0x8a966939777c619f, 0x3798142a2a3be21b } }, // 29G
+    { { 0xe2f73c696755ff89, 0xdd3cf7e7473017e6, 0x8ef5689d3cf7600d, 0x948dc4f8b1fc87b4 },
+      { 0xd9e9fe814ea53299, 0x2d921ca298eb6028, 0xfaecedfd0c9803fc, 0xf38ae8914d7b4745 } }, // 31G
+    { { 0x871514560f664534, 0x85ceae7c4b68f103, 0xac09c4ae65578ab9, 0x33ec6868f044b10c },
+      { 0x6ac4832b3a8ec1f1, 0x5509d1285847d5ef, 0xf909604f763f1574, 0xb16c4303c32f63c4 } }, // 33G
+    { { 0xfd16847fdec67ef5, 0x742ee464233e76b7, 0x0b8e4134efc2b4c8, 0xca640b8642a3e521 },
+      { 0x653a01908ceb6aa9, 0x313c300c547852d5, 0x24e4ab126b237af7, 0x2ba901628bb47af8 } }, // 35G
+    { { 0x00467bc58cce08b5, 0xb636458c7f178d55, 0xc5748baea677d806, 0x2763a387dfa394eb },
+      { 0xa12b448a7d3cebb6, 0xe7adda3e6f20d850, 0xf63ebce51558462c, 0x58b36143620088a8 } }, // 37G
+    { { 0xa9d89488a059c142, 0x6f5ae714ff0b9346, 0x068f237d16fb3664, 0x5853e4c4363186ac },
+      { 0xe2d87d2363c52f98, 0x2ec4a76681828876, 0x47b864fae14e7b1c, 0x0c0bc0e569192408 } }, // 39G
+    { { 0x624d60492ed22e91, 0x6fdfe0b56f072822, 0xeeca111539ce2271, 0x98100a4fdb01614f },
+      { 0xb6b0daa2a35c628f, 0xb6f94d2ec87e9a47, 0xc67732591d57d9ce, 0xf70bfeec03884a7b } }, // 41G
+    { { 0x4ff23ffd248a7d06, 0x80c5bfb4878873fa, 0xb7d9ad9005745981, 0x179c85db3db01994 },
+      { 0xba41b06261a6966c, 0x4d82d052eadce5a8, 0x9e91cd3ba5e6a318, 0x47795f4f95b2dda0 } }, // 43G
+    { { 0x1ee426ccd5cd79bf, 0x0032940b946c6e18, 0x1b1e8ae057477f58, 0xe94f7d346d823278 },
+      { 0xc747cb96782ba21a, 0xc5254469f72b33a5, 0x772ef6dec7f80c81, 0xd73acbfe2cd9e6b5 } }, // 45G
+    { { 0x283c7513caa76097, 0x0a624fa936c83906, 0x6b20afec715af2c7, 0x4b969974eba78bfd },
+      { 0x220755ccd921d60e, 0x9b944e107baeca13, 0x04819d515ded93d4, 0x9bbff86e6dddfd27 } }, // 47G
+    { { 0x21950b421ff6acd3, 0xffe7048453dc6909, 0xff4cd0b228766127, 0xabdbe6084fb7db2b },
+      { 0x837c92285e1109e8, 0x26147d27f4645b5a, 0x4d78f592f7818ed8, 0xd394077ef247fa36 } }, // 49G
+    { { 0x508cec1c3b3f64c9, 0xe20bc0ba1e5edf3f, 0xda1deb852f4318d4, 0xd20ebe0d5c3fa443 },
+      { 0x370b4ea773241ea3, 0x61f1511c5e1a5f65, 0x99a5e23d82681c62, 0xd731e383a2f54c2d } }, // 51G
+    { { 0x97359638546c4d8d, 0x5f9c3fc492f24679, 0x912e8beda8c8acd9, 0xec3a318d306634b0 },
+      { 0x80167f41c31cb264, 0x3db82f6f522113f2, 0xb155bcd2dcafe197, 0xfba1da5943465283 } }, // 53G
+    { { 0x258bbbf9e7305683, 0x31eea5bf07ef5be6, 0x0deb0e4a46c814c1, 0x5cee8449a7b730dd },
+      { 0xeab495c5a0182bde, 0xee759f879e27a6b4, 0xc2cf6a6880e518ca, 0x25e8013ff14cf3f4 } }, // 55G
+    { { 0x3ec832e77acaca28, 0x1bfeea57c7385b29, 0x068212e3fd1eaf38, 0xc13298306acf8ccc },
+      { 0xb909f2db2aac9e59, 0x5748060db661782a, 0xc5ab2632c79b7a01, 0xda44c6c600017626 } }, // 57G
+    { { 0x69d44ed65c46aa8e, 0x2100d5d3a8d063d1, 0xcb9727eaa2d17c36, 0x4c2bab1b8add53b7 },
+      { 0xa084e90c15426704, 0x778afcd3a837ebea, 0x6651f7017ce477f8, 0xa062499846fb7a8b } }, // 59G
+    { { 0x3667eb1a7f4c04cc, 0x59556621a9404f84, 0x71cdf6537eceb50a, 0x994a44a69b8335fa },
+      { 0xd7faf819dbeb9b69, 0x473c5680eed4350d, 0xb6658466da44bba2, 0x0d1bc780872bdbf3 } }, // 61G
+    { { 0xb8d3d9319ff91fe5, 0x039c4800f0518eed, 0x95c376329182cb26, 0x0763a43482fc568d },
+      { 0x707c04d5383e76ba, 0xac98b930824e8197, 0x92bf7c8f91230de0, 0x90876a0140959b70 } }, // 63G
+};
+
+// Jacobian coordinates, (X / Z^2, Y / Z^3). Z = 0 is the point at infinity
+typedef struct {
+    uint64_t x[P256_LIMBS];
+    uint64_t y[P256_LIMBS];
+    uint64_t z[P256_LIMBS];
+} JacobianPoint;
+
+static int compare256(const uint64_t* a, const uint64_t* b) {
+    for (int i = P256_LIMBS - 1; i >= 0; i--) {
+        if (a[i] != b[i])
+            return a[i] < b[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+static bool isZero256(const uint64_t* a) {
+    return (a[0] | a[1] | a[2] | a[3]) == 0;
+}
+
+static void copy256(uint64_t* r, const uint64_t* a) {
+    for (int i = 0; i < P256_LIMBS; i++)
+        r[i] = a[i];
+}
+
+// r = a + b, returns the carry
+static uint64_t add256(uint64_t* r, const uint64_t* a, const uint64_t* b) {
+    uint64_t carry = 0;
+    for (int i = 0; i < P256_LIMBS; i++) {
+        uint64_t sum = a[i] + carry;
+        carry = sum < carry;
+        uint64_t limb = b[i];
+        sum += limb;
+        carry += sum < limb;
+        r[i] = sum;
+    }
+    return carry;
+}
+
+// r = a - b, returns the borrow
+static uint64_t sub256(uint64_t* r, const uint64_t* a, const uint64_t* b) {
+    uint64_t borrow = 0;
+    for (int i = 0; i < P256_LIMBS; i++) {
+        uint64_t d = a[i] - b[i];
+        uint64_t nextBorrow = (a[i] < b[i]) | (d < borrow);
+        r[i] = d - borrow;
+        borrow = nextBorrow;
+    }
+    return borrow;
+}
+
+// r = a * b / R mod m, the same CIOS loop as RSA with the limb count fixed at 4 so that it unrolls
+static inline void montMul256(uint64_t* r, const uint64_t* a, const uint64_t* b, const uint64_t* m, uint64_t m0inv) {
+    uint64_t t[P256_LIMBS + 1] = { 0 };
+
+    for (int i = 0; i < P256_LIMBS; i++) {
+        uint64_t productCarry, reduceCarry;
+        uint64_t low = mulAdd(a[0], b[i], t[0], 0, productCarry);
+        uint64_t q = low * m0inv;
+        mulAdd(q, m[0], low, 0, reduceCarry);
+
+        for (int j = 1; j < P256_LIMBS; j++) {
+            uint64_t sum = mulAdd(a[j], b[i], t[j], productCarry, productCarry);
+            t[j - 1] = mulAdd(q, m[j], sum, reduceCarry, reduceCarry);
+        }
+
+        uint64_t sum = t[P256_LIMBS] + productCarry;
+        uint64_t top = sum < productCarry;
+        t[P256_LIMBS - 1] = sum + reduceCarry;
+        t[P256_LIMBS] = top + (t[P256_LIMBS - 1] < reduceCarry);
+    }
+
+    if (t[P256_LIMBS] || compare256(t, m) >= 0)
+        sub256(r, t, m);
+    else
+        copy256(r, t);
+}
+
+// Field arithmetic mod p, everything stays fully reduced. Whether a result needs one more subtraction of p is
+// a coin toss, so it is picked with masks rather than branches that would keep mispredicting
+
+// r = carry 2^256 + t mod p, for any value below 2p
+static void fieldSelectReduced(uint64_t* r, const uint64_t* t, uint64_t carry) {
+    uint64_t reduced[P256_LIMBS];
+    uint64_t borrow = sub256(reduced, t, P256_P);
+    uint64_t keep = 0 - (borrow & (carry ^ 1));
+    for (int i = 0; i < P256_LIMBS; i++)
+        r[i] = (t[i] & keep) | (reduced[i] & ~keep);
+}
+
+// One Montgomery reduction step on t[0..4], which zeroes t[0]. It takes advantage of the shape of p, whose limbs
+// are 2^64 - 1, 2^32 - 1, 0 and 2^64 - 2^32 + 1 : with q = t[0], q (2^64 - 1) + t[0] is q 2^64 so the lowest
+// limb turns into a carry of q, and only two limbs are left to multiply. The overflow bit of the previous step
+// lands in t[4], and the one of this step is returned for t[5]
+static inline uint64_t fieldReduceStep(uint64_t* t, uint64_t overflow) {
+    uint64_t q = t[0], carry;
+    t[1] = mulAdd(q, P256_P[1], t[1], q, carry);
+    t[2] += carry;
+    carry = t[2] < carry;
+    t[3] = mulAdd(q, P256_P[3], t[3], carry, carry);
+
+    t[4] += carry;
+    uint64_t next = t[4] < carry;
+    t[4] += overflow;
+    return next + (t[4] < overflow);
+}
+
+// r = t / R mod p for a 512-bit t
+static inline void fieldReduce(uint64_t* r, uint64_t* t) {
+    uint64_t overflow = fieldReduceStep(t, 0);
+    overflow = fieldReduceStep(t + 1, overflow);
+    overflow = fieldReduceStep(t + 2, overflow);
+    overflow = fieldReduceStep(t + 3, overflow);
+    fieldSelectReduced(r, t + P256_LIMBS, overflow);
+}
+
+// t[0..4] += a * b, t[4] is only written
+static inline void mulAddRow(uint64_t* t, const uint64_t* a, uint64_t b) {
+    uint64_t carry;
+    t[0] = mulAdd(a[0], b, t[0], 0, carry);
+    t[1] = mulAdd(a[1], b, t[1], carry, carry);
+    t[2] = mulAdd(a[2], b, t[2], carry, carry);
+    t[3] = mulAdd(a[3], b, t[3], carry, carry);
+    t[4] = carry;
+}
+
+// r = a * b / R mod p. Everything is spelled out with constant indices so that t lives in registers
+static void fieldMul(uint64_t* r, const uint64_t* a, const uint64_t* b) {
+    uint64_t t[2 * P256_LIMBS] = { 0 };
+    mulAddRow(t, a, b[0]);
+    mulAddRow(t + 1, a, b[1]);
+    mulAddRow(t + 2, a, b[2]);
+    mulAddRow(t + 3, a, b[3]);
+    fieldReduce(r, t);
+}
+
+// r = a^2 / R mod p, the cross products are only computed once and doubled
+static void fieldSqr(uint64_t* r, const uint64_t* a) {
+    uint64_t t[2 * P256_LIMBS];
+    uint64_t carry, high;
+
+    t[1] = mulAdd(a[1], a[0], 0, 0, carry);
+    t[2] = mulAdd(a[2], a[0], 0, carry, carry);
+    t[3] = mulAdd(a[3], a[0], 0, carry, carry);
+    t[4] = carry;
+    t[3] = mulAdd(a[2], a[1], t[3], 0, carry);
+    t[4] = mulAdd(a[3], a[1], t[4], carry, carry);
+    t[5] = carry;
+    t[5] = mulAdd(a[3], a[2], t[5], 0, carry);
+    t[6] = carry;
+
+    t[7] = t[6] >> 63;
+    t[6] = (t[6] << 1) | (t[5] >> 63);
+    t[5] = (t[5] << 1) | (t[4] >> 63);
+    t[4] = (t[4] << 1) | (t[3] >> 63);
+    t[3] = (t[3] << 1) | (t[2] >> 63);
+    t[2] = (t[2] << 1) | (t[1] >> 63);
+    t[1] = t[1] << 1;
+
+    t[0] = mulAdd(a[0], a[0], 0, 0, high);
+    t[1] += high;
+    carry = t[1] < high;
+    t[2] = mulAdd(a[1], a[1], t[2], carry, high);
+    t[3] += high;
+    carry = t[3] < high;
+    t[4] = mulAdd(a[2], a[2], t[4], carry, high);
+    t[5] += high;
+    carry = t[5] < high;
+    t[6] = mulAdd(a[3], a[3], t[6], carry, high);
+    t[7] += high;
+
+    fieldReduce(r, t);
+}
+
+static void fieldAdd(uint64_t* r, const uint64_t* a, const uint64_t* b) {
+    uint64_t sum[P256_LIMBS];
+    uint64_t carry = add256(sum, a, b);
+    fieldSelectReduced(r, sum, carry);
+}
+
+static void fieldSub(uint64_t* r, const uint64_t* a, const uint64_t* b) {
+    uint64_t mask = 0 - sub256(r, a, b);
+    uint64_t p[P256_LIMBS];
+    for (int i = 0; i < P256_LIMBS; i++)
+        p[i] = P256_P[i] & mask;
+    add256(r, r, p);
+}
+
+static void fieldNeg(uint64_t* r, const uint64_t* a) {
+    static const uint64_t zero[P256_LIMBS] = { 0 };
+    fieldSub(r, zero, a);
+}
+
+// Scalar arithmetic mod n
+static void scalarMul(uint64_t* r, const uint64_t* a, const uint64_t* b) {
+    montMul256(r, a, b, P256_N, P256_N0INV);
+}
+
+// s^-1 R mod n as s^(n - 2), n is prime
+static void scalarInverse(uint64_t* r, const uint64_t* s) {
+    uint64_t base[P256_LIMBS], x[P256_LIMBS];
+    scalarMul(base, s, P256_RR_N);
+    copy256(x, base);
+
+    // n - 2 only differs from n in its lowest limb, and its top bit is set
+    for (int bit = 254; bit >= 0; bit--) {
+        uint64_t limb = bit < 64 ? P256_N[0] - 2 : P256_N[bit / 64];
+        scalarMul(x, x, x);
+        if ((limb >> (bit % 64)) & 1)
+            scalarMul(x, x, base);
+    }
+
+    copy256(r, x);
+}
+
+static void bytesTo256(uint64_t* r, const unsigned char* bytes, size_t size) {
+    for (int i = 0; i < P256_LIMBS; i++)
+        r[i] = 0;
+    for (size_t i = 0; i < size; i++)
+        r[i / 8] |= (uint64_t) bytes[size - 1 - i] << (8 * (i % 8));
+}
+
+// dbl-2001-b, a = -3 : https://hyperelliptic.org/EFD/g1p/auto-shortw-jacobian-3.html#doubling-dbl-2001-b
+static void pointDouble(JacobianPoint& r, const JacobianPoint& p) {
+    uint64_t delta[P256_LIMBS], gamma[P256_LIMBS], beta[P256_LIMBS], alpha[P256_LIMBS], t[P256_LIMBS], u[P256_LIMBS];
+
+    fieldSqr(delta, p.z);
+    fieldSqr(gamma, p.y);
+    fieldMul(beta, p.x, gamma);
+
+    // alpha = 3 (X - delta) (X + delta)
+    fieldSub(t, p.x, delta);
+    fieldAdd(u, p.x, delta);
+    fieldMul(t, t, u);
+    fieldAdd(alpha, t, t);
+    fieldAdd(alpha, alpha, t);
+
+    // Z3 = (Y + Z)^2 - gamma - delta, before Y and Z get overwritten
+    fieldAdd(t, p.y, p.z);
+    fieldSqr(t, t);
+    fieldSub(t, t, gamma);
+    fieldSub(r.z, t, delta);
+
+    // X3 = alpha^2 - 8 beta
+    fieldAdd(beta, beta, beta);
+    fieldAdd(beta, beta, beta);
+    fieldSqr(t, alpha);
+    fieldSub(t, t, beta);
+    fieldSub(r.x, t, beta);
+
+    // Y3 = alpha (4 beta - X3) - 8 gamma^2
+    fieldSub(t, beta, r.x);
+    fieldMul(t, alpha, t);
+    fieldSqr(u, gamma);
+    fieldAdd(u, u, u);
+    fieldAdd(u, u, u);
+    fieldAdd(u, u, u);
+    fieldSub(r.y, t, u);
+}
+
+// r = p + (x, y) with an affine point, madd-2007-bl : https://hyperelliptic.org/EFD/g1p/auto-shortw-jacobian-3.html#addition-madd-2007-bl
+static void pointAddAffine(JacobianPoint& r, const JacobianPoint& p, const uint64_t* x, const uint64_t* y) {
+    if (isZero256(p.z)) {
+        copy256(r.x, x);
+        copy256(r.y, y);
+        copy256(r.z, P256_ONE);
+        return;
+    }
+
+    uint64_t z1z1[P256_LIMBS], u2[P256_LIMBS], s2[P256_LIMBS], h[P256_LIMBS], hh[P256_LIMBS];
+    uint64_t i[P256_LIMBS], j[P256_LIMBS], rr[P256_LIMBS], v[P256_LIMBS], t[P256_LIMBS];
+
+    fieldSqr(z1z1, p.z);
+    fieldMul(u2, x, z1z1);
+    fieldMul(s2, y, p.z);
+    fieldMul(s2, s2, z1z1);
+
+    fieldSub(h, u2, p.x);
+    fieldSub(rr, s2, p.y);
+    if (isZero256(h)) {
+        if (isZero256(rr)) {
+            pointDouble(r, p);
+        } else {
+            for (int l = 0; l < P256_LIMBS; l++)
+                r.z[l] = 0;
+        }
+        return;
+    }
+
+    fieldSqr(hh, h);
+    fieldAdd(i, hh, hh);
+    fieldAdd(i, i, i);
+    fieldMul(j, h, i);
+    fieldAdd(rr, rr, rr);
+    fieldMul(v, p.x, i);
+
+    // X3 = r^2 - J - 2 V
+    uint64_t x3[P256_LIMBS], y3[P256_LIMBS];
+    fieldSqr(t, rr);
+    fieldSub(t, t, j);
+    fieldSub(t, t, v);
+    fieldSub(x3, t, v);
+
+    // Y3 = r (V - X3) - 2 Y1 J
+    fieldSub(t, v, x3);
+    fieldMul(t, rr, t);
+    fieldMul(j, j, p.y);
+    fieldAdd(j, j, j);
+    fieldSub(y3, t, j);
+
+    // Z3 = (Z1 + H)^2 - Z1Z1 - HH
+    fieldAdd(t, p.z, h);
+    fieldSqr(t, t);
+    fieldSub(t, t, z1z1);
+    fieldSub(r.z, t, hh);
+
+    copy256(r.x, x3);
+    copy256(r.y, y3);
+}
+
+// r = p + q, add-2007-bl : https://hyperelliptic.org/EFD/g1p/auto-shortw-jacobian-3.html#addition-add-2007-bl
+static void pointAdd(JacobianPoint& r, const JacobianPoint& p, const JacobianPoint& q) {
+    if (isZero256(p.z)) {
+        r = q;
+        return;
+    }
+    if (isZero256(q.z)) {
+        r = p;
+        return;
+    }
+
+    uint64_t z1z1[P256_LIMBS], z2z2[P256_LIMBS], u1[P256_LIMBS], u2[P256_LIMBS], s1[P256_LIMBS], s2[P256_LIMBS];
+    uint64_t h[P256_LIMBS], i[P256_LIMBS], j[P256_LIMBS], rr[P256_LIMBS], v[P256_LIMBS], t[P256_LIMBS];
+
+    fieldSqr(z1z1, p.z);
+    fieldSqr(z2z2, q.z);
+    fieldMul(u1, p.x, z2z2);
+    fieldMul(u2, q.x, z1z1);
+    fieldMul(s1, p.y, q.z);
+    fieldMul(s1, s1, z2z2);
+    fieldMul(s2, q.y, p.z);
+    fieldMul(s2, s2, z1z1);
+
+    fieldSub(h, u2, u1);
+    fieldSub(rr, s2, s1);
+    if (isZero256(h)) {
+        if (isZero256(rr)) {
+            pointDouble(r, p);
+        } else {
+            for (int l = 0; l < P256_LIMBS; l++)
+                r.z[l] = 0;
+        }
+        return;
+    }
+
+    fieldAdd(i, h, h);
+    fieldSqr(i, i);
+    fieldMul(j, h, i);
+    fieldAdd(rr, rr, rr);
+    fieldMul(v, u1, i);
+
+    // X3 = r^2 - J - 2 V
+    fieldSqr(t, rr);
+    fieldSub(t, t, j);
+    fieldSub(t, t, v);
+    fieldSub(r.x, t, v);
+
+    // Y3 = r (V - X3) - 2 S1 J
+    fieldSub(t, v, r.x);
+    fieldMul(t, rr, t);
+    fieldMul(s1, s1, j);
+    fieldAdd(s1, s1, s1);
+    fieldSub(r.y, t, s1);
+
+    // Z3 = ((Z1 + Z2)^2 - Z1Z1 - Z2Z2) H
+    fieldAdd(t, p.z, q.z);
+    fieldSqr(t, t);
+    fieldSub(t, t, z1z1);
+    fieldSub(t, t, z2z2);
+    fieldMul(r.z, t, h);
+}
+
+/**
+ * Width-w NAF of a scalar below 2^256, least significant digit first. Digits are zero or odd with an
+ * absolute value below 2^(w-1), and there is at most one non-zero digit in any w consecutive ones.
+ * Returns the number of digits
+ */
+static int computeWnaf(int8_t* digits, const uint64_t* scalar, int window) {
+    uint64_t k[P256_LIMBS + 1];
+    copy256(k, scalar);
+    k[P256_LIMBS] = 0;
+
+    const int modulus = 1 << window;
+    int count = 0;
+    while (k[0] | k[1] | k[2] | k[3] | k[4]) {
+        int digit = 0;
+        if (k[0] & 1) {
+            digit = (int) (k[0] & (uint64_t) (modulus - 1));
+            if (digit >= modulus / 2)
+                digit -= modulus;
+
+            // k -= digit, which clears the low w bits
+            uint64_t delta = (uint64_t) (digit < 0 ? -digit : digit);
+            if (digit > 0) {
+                uint64_t borrow = k[0] < delta;
+                k[0] -= delta;
+                for (int i = 1; i <= P256_LIMBS && borrow; i++)
+                    borrow = k[i]-- == 0;
+            } else {
+                k[0] += delta;
+                uint64_t carry = k[0] < delta;
+                for (int i = 1; i <= P256_LIMBS && carry; i++)
+                    carry = ++k[i] == 0;
+            }
+        }
+
+        digits[count++] = (int8_t) digit;
+
+        for (int i = 0; i < P256_LIMBS; i++)
+            k[i] = (k[i] >> 1) | (k[i + 1] << 63);
+        k[P256_LIMBS] >>= 1;
+    }
+
+    return count;
+}
+
+int parseEcPublicKey(const unsigned char* data, size_t size, EcPublicKey& key) {
+    if (size != P256_POINT_SIZE || data[0] != 0x04) {
+        LOGE("Unsupported EC public key encoding");
+        return -1;
+    }
+
+    bytesTo256(key.x, data + 1, P256_BYTES_SIZE);
+    bytesTo256(key.y, data + 1 + P256_BYTES_SIZE, P256_BYTES_SIZE);
+    if (compare256(key.x, P256_P) >= 0 || compare256(key.y, P256_P) >= 0) {
+        LOGE("EC public key coordinates out of range");
+        return -1;
+    }
+
+    fieldMul(key.x, key.x, P256_RR_P);
+    fieldMul(key.y, key.y, P256_RR_P);
+
+    // y^2 = x^3 - 3 x + b
+    uint64_t lhs[P256_LIMBS], rhs[P256_LIMBS], t[P256_LIMBS];
+    fieldSqr(lhs, key.y);
+    fieldSqr(rhs, key.x);
+    fieldMul(rhs, rhs, key.x);
+    fieldAdd(t, key.x, key.x);
+    fieldAdd(t, t, key.x);
+    fieldSub(rhs, rhs, t);
+    fieldAdd(rhs, rhs, P256_B);
+    if (compare256(lhs, rhs) != 0) {
+        LOGE("EC public key is not on P-256");
+        return -1;
+    }
+
+    return 0;
+}
+
+typedef DerConstructed<TAG_SEQUENCE, DER_NO_CAPTURE,
+    DerField<TAG_INTEGER, 0>,   // r
+    DerField<TAG_INTEGER, 1>>   // s
+    EcdsaSignatureSchema;
+
+// Integer in [1, n - 1]
+static int readScalar(const DerElement& element, uint64_t* scalar) {
+    DerCursor cursor;
+    const unsigned char* data;
+    size_t size;
+    derInit(cursor, element.header, derEncodedSize(element));
+    if (derInteger(cursor, data, size) < 0 || size > P256_BYTES_SIZE)
+        return -1;
+
+    bytesTo256(scalar, data, size);
+    return isZero256(scalar) || compare256(scalar, P256_N) >= 0 ? -1 : 0;
+}
+
+int verifyEcdsaSignature(const EcPublicKey& key, const unsigned char* digest, size_t digestSize,
+                         const unsigned char* signature, size_t signatureSize) {
+    DerElement fields[2];
+    uint64_t r[P256_LIMBS], s[P256_LIMBS];
+    if (derMatch<EcdsaSignatureSchema>(signature, signatureSize, fields) < 0
+        || readScalar(fields[0], r) < 0 || readScalar(fields[1], s) < 0) {
+        LOGE("Invalid ECDSA signature");
+        return -1;
+    }
+
+    // e is the leftmost 256 bits of the digest, reduced once since it's below 2n
+    uint64_t e[P256_LIMBS];
+    bytesTo256(e, digest, digestSize < P256_BYTES_SIZE ? digestSize : P256_BYTES_SIZE);
+    if (compare256(e, P256_N) >= 0)
+        sub256(e, e, P256_N);
+
+    // u1 = e / s and u2 = r / s. The inverse is in Montgomery form, so the products come out plain
+    uint64_t w[P256_LIMBS], u1[P256_LIMBS], u2[P256_LIMBS];
+    scalarInverse(w, s);
+    scalarMul(u1, e, w);
+    scalarMul(u2, r, w);
+
+    // Odd multiples Q, 3Q, ..., 15Q of the public key
+    JacobianPoint table[1 << (P256_Q_WINDOW - 2)], twice;
+    copy256(table[0].x, key.x);
+    copy256(table[0].y, key.y);
+    copy256(table[0].z, P256_ONE);
+    pointDouble(twice, table[0]);
+    for (int i = 1; i < (1 << (P256_Q_WINDOW - 2)); i++)
+        pointAdd(table[i], table[i - 1], twice);
+
+    // u1 G + u2 Q, both wNAFs walked together so that they share the doublings (Shamir's trick)
+    int8_t digitsG[P256_WNAF_MAX_DIGITS], digitsQ[P256_WNAF_MAX_DIGITS];
+    int countG = computeWnaf(digitsG, u1, P256_G_WINDOW);
+    int countQ = computeWnaf(digitsQ, u2, P256_Q_WINDOW);
+
+    JacobianPoint point;
+    for (int l = 0; l < P256_LIMBS; l++)
+        point.z[l] = 0;
+
+    uint64_t negated[P256_LIMBS];
+    for (int i = (countG > countQ ? countG : countQ) - 1; i >= 0; i--) {
+        if (!isZero256(point.z))
+            pointDouble(point, point);
+
+        int digit = i < countG ? digitsG[i] : 0;
+        if (digit) {
+            const uint64_t (*entry)[P256_LIMBS] = P256_G_TABLE[(digit < 0 ? -digit : digit) / 2];
+            if (digit < 0) {
+                fieldNeg(negated, entry[1]);
+                pointAddAffine(point, point, entry[0], negated);
+            } else {
+                pointAddAffine(point, point, entry[0], entry[1]);
+            }
+        }
+
+        digit = i < countQ ? digitsQ[i] : 0;
+        if (digit) {
+            const JacobianPoint& entry = table[(digit < 0 ? -digit : digit) / 2];
+            if (digit < 0) {
+                JacobianPoint negative = entry;
+                fieldNeg(negative.y, entry.y);
+                pointAdd(point, point, negative);
+            } else {
+                pointAdd(point, point, entry);
+            }
+        }
+    }
+
+    if (isZero256(point.z)) {
+        LOGE("ECDSA verification reached the point at infinity");
+        return -1;
+    }
+
+    // x mod n == r, checked projectively as X == x Z^2 for x = r and, when it's still below p, x = r + n
+    uint64_t zz[P256_LIMBS], x[P256_LIMBS], t[P256_LIMBS];
+    fieldSqr(zz, point.z);
+    copy256(x, r);
+    for (int candidate = 0; candidate < 2; candidate++) {
+        fieldMul(t, x, P256_RR_P);
+        fieldMul(t, t, zz);
+        if (compare256(t, point.x) == 0)
+            return 0;
+
+        if (add256(x, x, P256_N) || compare256(x, P256_P) >= 0)
+            break;
+    }
+
+    return -1;
+}
@@ -26,196 +26,381 @@
 
 #include "inflate_helper.h"
 
-typedef struct {
-    uint16_t counts[16];   // Number of codes with a given length
-    uint16_t symbols[288]; // Symbols sorted by code
-    int32_t maxSym;
-} InflateTree;
+#define INFLATE_LIT_TABLE_BITS 10  // Primary table index width for literal/length codes
+#define INFLATE_DIST_TABLE_BITS 8  // Primary table index width for distance codes
+#define INFLATE_CLEN_TABLE_BITS 7  // Code length codes are never longer than 7 bits
 
-typedef struct {
-    const uint8_t *src, *srcEnd;
-    uint32_t tag, bitcount, overflow;
-    uint8_t *dstStart, *dst, *dstEnd;
-    InflateTree ltree; // Literal/length tree
-    InflateTree dtree; // Distance tree
-} InflateData;
-
-static uint16_t inflateReadLE16(const uint8_t *p) {
-    return (uint16_t)(((uint32_t) p[0]) | ((uint32_t) p[1] << 8));
+/* Decoding table entries
+ *
+ * Direct entry:     symbol << 16 | code length
+ * Secondary table:  offset << 16 | INFLATE_ENTRY_SUBTABLE | index width of the secondary table
+ *
+ * Codes longer than the primary index width share a primary entry with every code that has
+ * the same first bits, that entry links to a secondary table indexed by the remaining bits.
+ */
+#define INFLATE_ENTRY_SUBTABLE 0x8000
+#define INFLATE_ENTRY_INVALID 0xFFFF0001 // Symbol too large for any tree, makes callers bail out
+
+// Unaligned little-endian load of 8 bytes
+static uint64_t inflateReadLE64(const uint8_t *p) {
+    uint64_t v;
+    __builtin_memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
 }
 
-// Build fixed Huffman trees
-static void inflateBuildFixedTrees(InflateTree *lt, InflateTree *dt) {
-    // Build fixed literal/length tree
-    for (uint32_t i = 0; i < 16; ++i)
-        lt->counts[i] = 0;
-
-    lt->counts[7] = 24;
-    lt->counts[8] = 152;
-    lt->counts[9] = 112;
-
-    for (uint16_t i = 0; i < 24; ++i)
-        lt->symbols[i] = (uint16_t)(256 + i);
-    for (uint16_t i = 0; i < 144; ++i)
-        lt->symbols[24 + i] = i;
-    for (uint16_t i = 0; i < 8; ++i)
-        lt->symbols[24 + 144 + i] = (uint16_t)(280 + i);
-    for (uint16_t i = 0; i < 112; ++i)
-        lt->symbols[24 + 144 + 8 + i] = (uint16_t)(144 + i);
-
-    lt->maxSym = 285;
-
-    // Build fixed distance tree
-    for (uint32_t i = 0; i < 16; ++i)
-        dt->counts[i] = 0;
-
-    dt->counts[5] = 32;
-
-    for (uint16_t i = 0; i < 32; ++i)
-        dt->symbols[i] = i;
-
-    dt->maxSym = 29;
+static constexpr uint32_t inflateReverseBits(uint32_t code, uint32_t len) {
+    uint32_t reversed = 0;
+    for (uint32_t i = 0; i < len; ++i) {
+        reversed = (reversed << 1) | (code & 1);
+        code >>= 1;
+    }
+    return reversed;
 }
 
-// Given an array of code lengths, build a tree
-static InflateResult inflateBuildTree(InflateTree *t, const uint8_t *lengths, const uint32_t num) {
-    uint16_t offs[16];
+// Scratch space of inflateBuildTree. It's handed in rather than declared inside so that runtime callers don't pay
+// for clearing it, which a constexpr function would have to do
+typedef struct {
+    uint16_t codes[288];
+    uint8_t subBits[1 << INFLATE_LIT_TABLE_BITS];
+} InflateBuildScratch;
+
+// Given an array of code lengths, build the decoding tables of a tree
+static constexpr InflateResult inflateBuildTree(InflateTree *t, const uint8_t *lengths, const uint32_t num, const uint32_t tableBits,
+                                                InflateBuildScratch &scratch) {
+    uint16_t counts[16] = {}, nextCode[16] = {};
 
     assert(num <= 288);
 
     for (uint32_t i = 0; i < 16; ++i)
-        t->counts[i] = 0;
+        counts[i] = 0;
 
     t->maxSym = -1;
+    t->tableBits = tableBits;
 
     // Count number of codes for each non-zero length
     for (uint32_t i = 0; i < num; ++i) {
         assert(lengths[i] <= 15);
         if (lengths[i]) {
             t->maxSym = (int32_t)i;
-            t->counts[lengths[i]]++;
+            counts[lengths[i]]++;
         }
     }
 
-    // Compute offset table for distribution sort
-    uint32_t numCodes = 0, available = 1;
+    // Compute first canonical code of each length
+    uint32_t numCodes = 0, available = 1, code = 0;
     for (uint32_t i = 0; i < 16; ++i) {
-        const uint16_t used = t->counts[i];
+        const uint16_t used = counts[i];
         // Check length contains no more codes than available
         if (used > available)
             return INFLATE_ERROR;
         available = 2 * (available - used);
-        offs[i] = (uint16_t)numCodes;
         numCodes += used;
+
+        code = (code + (i ? counts[i - 1] : 0)) << 1;
+        nextCode[i] = (uint16_t)(i ? code : 0);
     }
 
     // Check all codes were used, or for the special case of only one
     // code that it has length 1
-    if ((numCodes > 1 && available > 0) || (numCodes == 1 && t->counts[1] != 1))
+    if ((numCodes > 1 && available > 0) || (numCodes == 1 && counts[1] != 1))
         return INFLATE_ERROR;
 
-    // Fill in symbols sorted by code
-    for (uint16_t i = 0; i < num; ++i) {
-        if (lengths[i])
-            t->symbols[offs[lengths[i]]++] = i;
+    // Unused entries decode to a symbol that is too large, which only happens
+    // for the special case of only one code when reading a code 1
+    const uint32_t primarySize = 1U << tableBits;
+    for (uint32_t i = 0; i < primarySize; ++i)
+        t->table[i] = INFLATE_ENTRY_INVALID;
+
+    uint16_t *codes = scratch.codes;
+    uint8_t *subBits = scratch.subBits;
+    for (uint32_t i = 0; i < primarySize; ++i)
+        subBits[i] = 0;
+
+    // Fill in direct entries, and find out how wide each secondary table has to be.
+    // Codes are read LSB first from the stream so tables are indexed by reversed codes.
+    for (uint32_t i = 0; i < num; ++i) {
+        const uint32_t len = lengths[i];
+        if (!len)
+            continue;
+
+        const uint32_t reversed = inflateReverseBits(nextCode[len]++, len);
+        codes[i] = (uint16_t)reversed;
+
+        if (len <= tableBits) {
+            for (uint32_t j = reversed; j < primarySize; j += 1U << len)
+                t->table[j] = (i << 16) | len;
+        } else {
+            uint8_t *bits = &subBits[reversed & (primarySize - 1)];
+            if (len - tableBits > *bits)
+                *bits = (uint8_t)(len - tableBits);
+        }
     }
 
-    // For the special case of only one code (which will be 0) add a
-    // code 1 which results in a symbol that is too large
-    if (numCodes == 1) {
-        t->counts[1] = 2;
-        t->symbols[1] = (uint16_t)(t->maxSym + 1);
+    // Lay out secondary tables after the primary one
+    uint32_t used = primarySize;
+    for (uint32_t i = 0; i < primarySize; ++i) {
+        if (!subBits[i])
+            continue;
+
+        const uint32_t size = 1U << subBits[i];
+        if (used + size > INFLATE_TABLE_SIZE)
+            return INFLATE_ERROR;
+
+        for (uint32_t j = 0; j < size; ++j)
+            t->table[used + j] = INFLATE_ENTRY_INVALID;
+
+        t->table[i] = (used << 16) | INFLATE_ENTRY_SUBTABLE | subBits[i];
+        used += size;
+    }
+
+    // Fill in secondary entries, they hold the code length left after the primary index
+    for (uint32_t i = 0; i < num; ++i) {
+        const uint32_t len = lengths[i];
+        if (len <= tableBits)
+            continue;
+
+        const uint32_t link = t->table[codes[i] & (primarySize - 1)];
+        const uint32_t size = 1U << (link & 0xFF);
+        uint32_t *sub = &t->table[link >> 16];
+        for (uint32_t j = codes[i] >> tableBits; j < size; j += 1U << (len - tableBits))
+            sub[j] = (i << 16) | (len - tableBits);
     }
 
     return INFLATE_OK;
 }
 
-static void inflateRefill(InflateData *d, const uint32_t num) {
-    assert(num <= 32);
+typedef struct {
+    InflateTree lt;
+    InflateTree dt;
+} InflateFixedTrees;
+
+// Build fixed Huffman trees
+static constexpr InflateFixedTrees inflateBuildFixedTrees() {
+    InflateFixedTrees trees = {};
+    InflateBuildScratch scratch = {};
+    uint8_t lengths[288] = {};
+
+    // Build fixed literal/length tree
+    for (uint32_t i = 0; i < 144; ++i)
+        lengths[i] = 8;
+    for (uint32_t i = 144; i < 256; ++i)
+        lengths[i] = 9;
+    for (uint32_t i = 256; i < 280; ++i)
+        lengths[i] = 7;
+    for (uint32_t i = 280; i < 288; ++i)
+        lengths[i] = 8;
+
+    inflateBuildTree(&trees.lt, lengths, 288, INFLATE_LIT_TABLE_BITS, scratch);
+    trees.lt.maxSym = 285;
+
+    // Build fixed distance tree
+    for (uint32_t i = 0; i < 32; ++i)
+        lengths[i] = 5;
+
+    inflateBuildTree(&trees.dt, lengths, 32, INFLATE_DIST_TABLE_BITS, scratch);
+    trees.dt.maxSym = 29;
+
+    return trees;
+}
+
+// Fixed trees never change, so their tables are built by the compiler. Building them on first use would need a
+// guard, which takes a lock in libc on whichever pool worker gets there first
+static constexpr InflateFixedTrees inflateFixedTrees = inflateBuildFixedTrees();
+
+// Decoder states, a stream suspends and resumes at the start of one of these
+enum {
+    INFLATE_STATE_HEADER,        // Block header
+    INFLATE_STATE_STORED_HEADER, // LEN and NLEN of a stored block
+    INFLATE_STATE_STORED_COPY,   // Data of a stored block
+    INFLATE_STATE_TREES_HEADER,  // HLIT, HDIST and HCLEN of a dynamic block
+    INFLATE_STATE_TREES_CLEN,    // Code lengths for the code length alphabet
+    INFLATE_STATE_TREES_LENGTHS, // Code lengths for the dynamic trees
+    INFLATE_STATE_BLOCK,         // Compressed data of a block
+    INFLATE_STATE_END,           // End of the compressed stream
+    INFLATE_STATE_ERROR
+};
+
+// Make sure at least num bits are available, tag is topped up to 56 bits or more when it runs low.
+// Returns 0 when the input piece runs out first. Past the end of the last piece zero bits are
+// appended so that codes can always be peeked at.
+static int inflateRefill(InflateStream *s, const uint32_t num) {
+    assert(num <= 56);
+
+    if (s->bitcount >= num)
+        return 1;
+
+    if (s->srcEnd - s->src >= 8) {
+        // Load a whole word and keep as many whole bytes of it as fit
+        s->tag |= inflateReadLE64(s->src) << s->bitcount;
+        s->src += (63 - s->bitcount) >> 3;
+        s->bitcount |= 56;
+        return 1;
+    }
 
-    // Read bytes until at least num bits available
-    while (d->bitcount < num) {
-        if (d->src != d->srcEnd)
-            d->tag |= (uint32_t) *d->src++ << d->bitcount;
-        else
-            d->overflow = 1;
-        d->bitcount += 8;
+    // Near the end of the piece read byte by byte
+    while (s->bitcount <= 56 && s->src != s->srcEnd) {
+        s->tag |= (uint64_t) *s->src++ << s->bitcount;
+        s->bitcount += 8;
     }
 
-    assert(d->bitcount <= 32);
+    if (s->bitcount >= num)
+        return 1;
+
+    if (!s->lastInput)
+        return 0;
+
+    while (s->bitcount < num) {
+        s->padding += 8;
+        s->bitcount += 8;
+    }
+
+    return 1;
+}
+
+// Check whether bits were consumed past the end of the input
+static int inflateOverflowed(const InflateStream *s) {
+    return s->bitcount < s->padding;
 }
 
-static uint32_t inflateGetBitsNoRefill(InflateData *d, const uint32_t num) {
-    assert(num <= d->bitcount);
+// Get num bits from tag, the caller refills
+static uint32_t inflateGetBits(InflateStream *s, const uint32_t num) {
+    assert(num <= s->bitcount);
 
     // Get bits from tag
-    const uint32_t bits = d->tag & ((1U << num) - 1);
+    const uint32_t bits = (uint32_t)(s->tag & ((1ULL << num) - 1));
 
     // Remove bits from tag
-    d->tag >>= num;
-    d->bitcount -= num;
+    s->tag >>= num;
+    s->bitcount -= num;
 
     return bits;
 }
 
-// Get num bits from src stream
-static uint32_t inflateGetBits(InflateData *d, const uint32_t num) {
-    inflateRefill(d, num);
-    return inflateGetBitsNoRefill(d, num);
+// Given a tree, look up the symbol at the front of tag with one table lookup, two for long codes.
+// Returns symbol << 16 | code length, a symbol takes up to 15 bits and the caller refills.
+static uint32_t inflatePeekSymbol(const InflateStream *s, const InflateTree *t) {
+    uint32_t entry = t->table[s->tag & ((1U << t->tableBits) - 1)];
+
+    if (entry & INFLATE_ENTRY_SUBTABLE) {
+        const uint32_t index = (uint32_t)(s->tag >> t->tableBits) & ((1U << (entry & 0xFF)) - 1);
+        entry = t->table[(entry >> 16) + index] + t->tableBits;
+    }
+
+    return entry;
 }
 
-// Read a num bit value from stream and add base
-static uint32_t inflateGetBitsBase(InflateData *d, const uint32_t num, uint32_t base) {
-    return base + (num ? inflateGetBits(d, num) : 0);
+// Read the header of the next block
+static InflateResult inflateBlockHeader(InflateStream *s) {
+    if (!inflateRefill(s, 3))
+        return INFLATE_NEED_INPUT;
+
+    // Read final block flag
+    s->bfinal = inflateGetBits(s, 1);
+
+    // Read block type (2 bits)
+    const uint32_t btype = inflateGetBits(s, 2);
+
+    if (inflateOverflowed(s))
+        return INFLATE_ERROR;
+
+    switch (btype) {
+    case 0:
+        s->state = INFLATE_STATE_STORED_HEADER;
+        break;
+    case 1:
+        s->lt = &inflateFixedTrees.lt;
+        s->dt = &inflateFixedTrees.dt;
+        s->state = INFLATE_STATE_BLOCK;
+        break;
+    case 2:
+        s->state = INFLATE_STATE_TREES_HEADER;
+        break;
+    default:
+        return INFLATE_ERROR;
+    }
+
+    return INFLATE_OK;
 }
 
-// Given a data stream and a tree, decode a symbol
-static uint16_t inflateDecodeSymbol(InflateData *d, const InflateTree *t) {
-    /* Get more bits while code index is above number of codes
-     *
-     * Rather than the actual code, we are computing the position of the
-     * code in the sorted order of codes, which is the index of the
-     * corresponding symbol.
-     *
-     * Conceptually, for each code length (level in the tree), there are
-     * counts[len] leaves on the left and internal nodes on the right.
-     * The index we have decoded so far is base + offs, and if that
-     * falls within the leaves we are done. Otherwise we adjust the range
-     * of offs and add one more bit to it.
-     */
-    uint32_t base = 0, offs = 0;
-    for (uint32_t len = 1; ; ++len) {
-        offs = 2 * offs + inflateGetBits(d, 1);
+// Read the length of an uncompressed block
+static InflateResult inflateStoredHeader(InflateStream *s) {
+    // Stored data starts on a byte boundary
+    inflateGetBits(s, s->bitcount & 7);
 
-        assert(len <= 15);
+    if (!inflateRefill(s, 32))
+        return INFLATE_NEED_INPUT;
 
-        if (offs < t->counts[len])
-            break;
+    // Get length
+    const uint32_t length = inflateGetBits(s, 16);
+
+    // Get one's complement of length
+    const uint32_t invlength = inflateGetBits(s, 16);
+
+    if (inflateOverflowed(s))
+        return INFLATE_ERROR;
+
+    // Check length
+    if (length != (~invlength & 0x0000FFFF))
+        return INFLATE_ERROR;
+
+    s->copyLength = length;
+    s->state = INFLATE_STATE_STORED_COPY;
+
+    return INFLATE_OK;
+}
+
+// Copy the data of an uncompressed block, as much of it as fits in the window
+static InflateResult inflateStoredCopy(InflateStream *s) {
+    while (s->copyLength) {
+        if (s->pos == s->windowSize)
+            return INFLATE_OVERFLOW;
+
+        // Whole bytes still held in tag come first
+        if (s->bitcount > s->padding) {
+            s->window[s->pos++] = (uint8_t) inflateGetBits(s, 8);
+            s->copyLength--;
+            continue;
+        }
 
-        base += t->counts[len];
-        offs -= t->counts[len];
+        if (s->src == s->srcEnd)
+            return s->lastInput ? INFLATE_ERROR : INFLATE_NEED_INPUT;
+
+        // Then copy straight from the input
+        s->tag = 0;
+        s->bitcount = 0;
+
+        size_t n = s->copyLength;
+        if (n > (size_t)(s->srcEnd - s->src))
+            n = (size_t)(s->srcEnd - s->src);
+        if (n > s->windowSize - s->pos)
+            n = s->windowSize - s->pos;
+
+        my_memcpy(s->window + s->pos, s->src, n);
+        s->pos += n;
+        s->src += n;
+        s->copyLength -= (uint32_t) n;
     }
 
-    assert(base + offs < 288);
-    return t->symbols[base + offs];
+    s->state = s->bfinal ? INFLATE_STATE_END : INFLATE_STATE_HEADER;
+    return INFLATE_OK;
 }
 
-// Given a data stream, decode dynamic trees from it
-static InflateResult inflateDecodeTrees(InflateData *d, InflateTree *lt, InflateTree *dt) {
-    // Special ordering of code length codes
-    static const uint8_t clcidx[19] = {
-        16, 17, 18, 0,  8, 7,  9, 6, 10, 5,
-        11,  4, 12, 3, 13, 2, 14, 1, 15
-    };
+// Read the sizes of the dynamic trees
+static InflateResult inflateTreesHeader(InflateStream *s) {
+    if (!inflateRefill(s, 14))
+        return INFLATE_NEED_INPUT;
 
     // Get 5 bits HLIT (257-286)
-    const uint32_t hlit = inflateGetBitsBase(d, 5, 257);
+    s->hlit = 257 + inflateGetBits(s, 5);
 
     // Get 5 bits HDIST (1-32)
-    const uint32_t hdist = inflateGetBitsBase(d, 5, 1);
+    s->hdist = 1 + inflateGetBits(s, 5);
 
     // Get 4 bits HCLEN (4-19)
-    const uint32_t hclen = inflateGetBitsBase(d, 4, 4);
+    s->hclen = 4 + inflateGetBits(s, 4);
 
     /* The RFC limits the range of HLIT to 286, but lists HDIST as range
      * 1-32, even though distance codes 30 and 31 have no meaning. While
@@ -225,53 +410,85 @@ static InflateResult inflateDecodeTrees(InflateData *d, InflateTree *lt, Inflate
      *
      * See also: https://github.com/madler/zlib/issues/82
      */
-    if (hlit > 286 || hdist > 30)
+    if (s->hlit > 286 || s->hdist > 30)
         return INFLATE_ERROR;
 
-    uint8_t lengths[288 + 32];
     for (uint32_t i = 0; i < 19; ++i)
-        lengths[i] = 0;
+        s->lengths[i] = 0;
+
+    s->num = 0;
+    s->state = INFLATE_STATE_TREES_CLEN;
+
+    return INFLATE_OK;
+}
+
+// Read code lengths for code length alphabet
+static InflateResult inflateTreesCodeLengths(InflateStream *s) {
+    // Special ordering of code length codes
+    static const uint8_t clcidx[19] = {
+        16, 17, 18, 0,  8, 7,  9, 6, 10, 5,
+        11,  4, 12, 3, 13, 2, 14, 1, 15
+    };
+
+    for (; s->num < s->hclen; ++s->num) {
+        if (!inflateRefill(s, 3))
+            return INFLATE_NEED_INPUT;
 
-    // Read code lengths for code length alphabet
-    for (uint32_t i = 0; i < hclen; ++i) {
         // Get 3 bits code length (0-7)
-        lengths[clcidx[i]] = (uint8_t)inflateGetBits(d, 3);
+        s->lengths[clcidx[s->num]] = (uint8_t) inflateGetBits(s, 3);
     }
 
     // Build code length tree (in literal/length tree to save space)
-    InflateResult res = inflateBuildTree(lt, lengths, 19);
+    InflateBuildScratch scratch;
+    const InflateResult res = inflateBuildTree(&s->ltree, s->lengths, 19, INFLATE_CLEN_TABLE_BITS, scratch);
     if (res != INFLATE_OK)
         return res;
 
     // Check code length tree is not empty
-    if (lt->maxSym == -1)
+    if (s->ltree.maxSym == -1)
         return INFLATE_ERROR;
 
-    // Decode code lengths for the dynamic trees
-    for (uint32_t num = 0; num < hlit + hdist; ) {
-        uint16_t sym = inflateDecodeSymbol(d, lt);
+    s->num = 0;
+    s->state = INFLATE_STATE_TREES_LENGTHS;
+
+    return INFLATE_OK;
+}
+
+// Decode code lengths for the dynamic trees and build them
+static InflateResult inflateTreesLengths(InflateStream *s) {
+    const uint32_t total = s->hlit + s->hdist;
+    uint8_t *lengths = s->lengths;
 
-        if (sym > lt->maxSym)
+    while (s->num < total) {
+        // Enough for a code length code and its repeat count
+        if (!inflateRefill(s, 14))
+            return INFLATE_NEED_INPUT;
+
+        const uint32_t entry = inflatePeekSymbol(s, &s->ltree);
+        inflateGetBits(s, entry & 0xFF);
+        uint32_t sym = entry >> 16;
+
+        if ((int32_t) sym > s->ltree.maxSym)
             return INFLATE_ERROR;
 
         uint32_t length;
         switch (sym) {
         case 16:
             // Copy previous code length 3-6 times (read 2 bits)
-            if (num == 0)
+            if (s->num == 0)
                 return INFLATE_ERROR;
-            sym = lengths[num - 1];
-            length = inflateGetBitsBase(d, 2, 3);
+            sym = lengths[s->num - 1];
+            length = 3 + inflateGetBits(s, 2);
             break;
         case 17:
             // Repeat code length 0 for 3-10 times (read 3 bits)
             sym = 0;
-            length = inflateGetBitsBase(d, 3, 3);
+            length = 3 + inflateGetBits(s, 3);
             break;
         case 18:
             // Repeat code length 0 for 11-138 times (read 7 bits)
             sym = 0;
-            length = inflateGetBitsBase(d, 7, 11);
+            length = 11 + inflateGetBits(s, 7);
             break;
         default:
             // Values 0-15 represent the actual code lengths
@@ -279,11 +496,11 @@ static InflateResult inflateDecodeTrees(InflateData *d, InflateTree *lt, Inflate
             break;
         }
 
-        if (length > hlit + hdist - num)
+        if (length > total - s->num)
             return INFLATE_ERROR;
 
         while (length--)
-            lengths[num++] = (uint8_t)sym;
+            lengths[s->num++] = (uint8_t) sym;
     }
 
     // Check EOB symbol is present
@@ -291,19 +508,53 @@ static InflateResult inflateDecodeTrees(InflateData *d, InflateTree *lt, Inflate
         return INFLATE_ERROR;
 
     // Build dynamic trees
-    res = inflateBuildTree(lt, lengths, hlit);
+    InflateBuildScratch scratch;
+    InflateResult res = inflateBuildTree(&s->ltree, lengths, s->hlit, INFLATE_LIT_TABLE_BITS, scratch);
     if (res != INFLATE_OK)
         return res;
 
-    res = inflateBuildTree(dt, lengths + hlit, hdist);
+    res = inflateBuildTree(&s->dtree, lengths + s->hlit, s->hdist, INFLATE_DIST_TABLE_BITS, scratch);
     if (res != INFLATE_OK)
         return res;
 
+    s->lt = &s->ltree;
+    s->dt = &s->dtree;
+    s->state = INFLATE_STATE_BLOCK;
+
     return INFLATE_OK;
 }
 
-// Given a stream and two trees, inflate a block of data
-static InflateResult inflateBlockData(InflateData *d, InflateTree *lt, InflateTree *dt) {
+// Copy a match of length bytes from offs back, as much of it as fits in the window.
+// Returns 0 when the window fills up first, the rest is kept for the next call.
+static int inflateCopyMatch(InflateStream *s, const uint32_t length, const uint32_t offs) {
+    uint8_t *window = s->window;
+    const size_t pos = s->pos;
+    const size_t room = s->windowSize - pos;
+    const uint32_t n = length < room ? length : (uint32_t) room;
+
+    if (offs <= pos) {
+        const uint8_t *from = window + pos - offs;
+        for (uint32_t i = 0; i < n; ++i)
+            window[pos + i] = from[i];
+    } else {
+        // Match starts before the ring wrapped around
+        size_t from = pos + s->windowSize - offs;
+        for (uint32_t i = 0; i < n; ++i) {
+            window[pos + i] = window[from];
+            if (++from == s->windowSize)
+                from = 0;
+        }
+    }
+
+    s->pos = pos + n;
+    s->copyLength = length - n;
+    s->copyDist = offs;
+
+    return s->copyLength == 0;
+}
+
+// Inflate the compressed data of a block
+static InflateResult inflateBlockData(InflateStream *s) {
     // Extra bits and base tables for length codes
     static const uint8_t lengthBits[30] = {
         0, 0, 0, 0, 0, 0, 0, 0, 1, 1,
@@ -330,134 +581,161 @@ static InflateResult inflateBlockData(InflateData *d, InflateTree *lt, InflateTr
         1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
     };
 
+    const InflateTree *lt = s->lt;
+    const InflateTree *dt = s->dt;
+
+    // Finish a match cut short by the end of the window
+    if (s->copyLength && !inflateCopyMatch(s, s->copyLength, s->copyDist))
+        return INFLATE_OVERFLOW;
+
     for (;;) {
-        uint16_t sym = inflateDecodeSymbol(d, lt);
+        // Enough for a length code, a distance code and their extra bits (15 + 5 + 15 + 13)
+        if (!inflateRefill(s, 48))
+            return INFLATE_NEED_INPUT;
+
+        uint32_t entry = inflatePeekSymbol(s, lt);
+        uint32_t sym = entry >> 16;
+
+        // Leave the literal for the next call when there is no room for it
+        if (sym < 256 && s->pos == s->windowSize)
+            return INFLATE_OVERFLOW;
+
+        inflateGetBits(s, entry & 0xFF);
 
         // Check for overflow in bit reader
-        if (d->overflow)
+        if (inflateOverflowed(s))
             return INFLATE_ERROR;
 
         if (sym < 256) {
-            if (d->dst == d->dstEnd)
-                return INFLATE_OVERFLOW;
-            *d->dst++ = (uint8_t)sym;
-        } else {
-            // Check for end of block
-            if (sym == 256)
-                return INFLATE_OK;
-
-            // Check sym is within range and distance tree is not empty
-            if (sym > lt->maxSym || sym - 257 > 28 || dt->maxSym == -1)
-                return INFLATE_ERROR;
+            s->window[s->pos++] = (uint8_t) sym;
+            continue;
+        }
 
-            sym = (uint16_t)(sym - 257);
+        // Check for end of block
+        if (sym == 256) {
+            s->state = s->bfinal ? INFLATE_STATE_END : INFLATE_STATE_HEADER;
+            return INFLATE_OK;
+        }
 
-            // Possibly get more bits from length code
-            const uint32_t length = inflateGetBitsBase(d, lengthBits[sym], lengthBase[sym]);
+        // Check sym is within range and distance tree is not empty
+        if ((int32_t) sym > lt->maxSym || sym - 257 > 28 || dt->maxSym == -1)
+            return INFLATE_ERROR;
 
-            const uint16_t dist = inflateDecodeSymbol(d, dt);
+        sym -= 257;
 
-            // Check dist is within range
-            if (dist > dt->maxSym || dist > 29)
-                return INFLATE_ERROR;
+        // Possibly get more bits from length code
+        const uint32_t length = lengthBase[sym] + inflateGetBits(s, lengthBits[sym]);
 
-            // Possibly get more bits from distance code
-            const uint32_t offs = inflateGetBitsBase(d, distBits[dist], distBase[dist]);
+        entry = inflatePeekSymbol(s, dt);
+        inflateGetBits(s, entry & 0xFF);
+        const uint32_t dist = entry >> 16;
 
-            if (offs > d->dst - d->dstStart)
-                return INFLATE_ERROR;
+        // Check dist is within range
+        if ((int32_t) dist > dt->maxSym || dist > 29)
+            return INFLATE_ERROR;
 
-            if (d->dstEnd - d->dst < length)
-                return INFLATE_OVERFLOW;
+        // Possibly get more bits from distance code
+        const uint32_t offs = distBase[dist] + inflateGetBits(s, distBits[dist]);
 
-            // Copy match
-            for (uint32_t i = 0; i < length; ++i)
-                d->dst[i] = (d->dst - offs)[i];
+        // Check the match does not reach back before the start of the output
+        if (offs > (s->wrapped ? s->windowSize : s->pos))
+            return INFLATE_ERROR;
 
-            d->dst += length;
-        }
+        // Copy match
+        if (!inflateCopyMatch(s, length, offs))
+            return INFLATE_OVERFLOW;
     }
 }
 
-// Inflate an uncompressed block of data
-static InflateResult inflateStoredBlock(InflateData *d) {
-    if (d->srcEnd - d->src < 4)
-        return INFLATE_ERROR;
-
-    // Get length
-    const uint32_t length = inflateReadLE16(d->src);
+// Run the decoder until it has to stop, INFLATE_OVERFLOW means the window is full
+static InflateResult inflateRun(InflateStream *s) {
+    for (;;) {
+        InflateResult res;
+        switch (s->state) {
+        case INFLATE_STATE_HEADER:        res = inflateBlockHeader(s); break;
+        case INFLATE_STATE_STORED_HEADER: res = inflateStoredHeader(s); break;
+        case INFLATE_STATE_STORED_COPY:   res = inflateStoredCopy(s); break;
+        case INFLATE_STATE_TREES_HEADER:  res = inflateTreesHeader(s); break;
+        case INFLATE_STATE_TREES_CLEN:    res = inflateTreesCodeLengths(s); break;
+        case INFLATE_STATE_TREES_LENGTHS: res = inflateTreesLengths(s); break;
+        case INFLATE_STATE_BLOCK:         res = inflateBlockData(s); break;
+        case INFLATE_STATE_END:           return inflateOverflowed(s) ? INFLATE_ERROR : INFLATE_END;
+        default:                          return INFLATE_ERROR;
+        }
 
-    // Get one's complement of length
-    const uint32_t invlength = inflateReadLE16(d->src + 2);
+        if (res == INFLATE_ERROR)
+            s->state = INFLATE_STATE_ERROR;
 
-    // Check length
-    if (length != (~invlength & 0x0000FFFF))
-        return INFLATE_ERROR;
+        if (res != INFLATE_OK)
+            return res;
+    }
+}
 
-    d->src += 4;
+void inflateStreamInit(InflateStream *s, void *window, size_t windowSize, bool ring) {
+    assert(!ring || windowSize >= INFLATE_WINDOW_SIZE);
+
+    s->src = s->srcEnd = NULL;
+    s->tag = 0;
+    s->bitcount = 0;
+    s->padding = 0;
+    s->lastInput = false;
+
+    s->window = (uint8_t *) window;
+    s->windowSize = windowSize;
+    s->pos = 0;
+    s->ring = ring;
+    s->wrapped = false;
+
+    s->state = INFLATE_STATE_HEADER;
+    s->bfinal = 0;
+    s->copyLength = 0;
+    s->copyDist = 0;
+    s->lt = s->dt = NULL;
+}
 
-    if (d->srcEnd - d->src < length)
-        return INFLATE_ERROR;
+// Hand over the next piece of input, the previous one must have been used up
+void inflateStreamInput(InflateStream *s, const void *src, size_t srcLen, bool last) {
+    assert(s->src == s->srcEnd);
 
-    if (d->dstEnd - d->dst < length)
-        return INFLATE_OVERFLOW;
+    s->src = (const uint8_t *) src;
+    s->srcEnd = s->src + srcLen;
+    s->lastInput = last;
+}
 
-    my_memcpy(d->dst, d->src, length);
-    d->dst += length;
-    d->src += length;
+InflateResult inflateStreamNext(InflateStream *s, const uint8_t **out, size_t *outLen) {
+    // The previous span has been handed out, start over at the beginning of the ring
+    if (s->ring && s->pos == s->windowSize) {
+        s->pos = 0;
+        s->wrapped = true;
+    }
 
-    // Make sure we start next block on a byte boundary
-    d->tag = 0;
-    d->bitcount = 0;
+    const size_t start = s->pos;
+    InflateResult res = inflateRun(s);
 
-    return INFLATE_OK;
-}
+    // In a ring a full window only means the caller has to take the output first
+    if (res == INFLATE_OVERFLOW && s->ring)
+        res = INFLATE_OK;
 
-// Inflate a block of data compressed with fixed Huffman trees
-static InflateResult inflateFixedBlock(InflateData *d) {
-    inflateBuildFixedTrees(&d->ltree, &d->dtree);
-    return inflateBlockData(d, &d->ltree, &d->dtree);
-}
+    *out = s->window + start;
+    *outLen = s->pos - start;
 
-// Inflate a block of data compressed with dynamic Huffman trees
-static InflateResult inflateDynamicBlock(InflateData *d) {
-    const InflateResult res = inflateDecodeTrees(d, &d->ltree, &d->dtree);
-    return res == INFLATE_OK ? inflateBlockData(d, &d->ltree, &d->dtree) : res;
+    return res;
 }
 
 // Inflate stream from src to dst
 InflateResult inflate(void *dst, size_t *dstLen, const void *src, size_t srcLen) {
-    InflateData d = {
-        .src = (const uint8_t *) src,
-        .srcEnd = d.src + srcLen,
-        .dst = (uint8_t*)dst,
-        .dstStart = (uint8_t*)dst,
-        .dstEnd = d.dst + *dstLen,
-    };
+    InflateStream s;
+    inflateStreamInit(&s, dst, *dstLen, false);
+    inflateStreamInput(&s, src, srcLen, true);
 
-    uint32_t bfinal;
-    do {
-        // Read final block flag
-        bfinal = inflateGetBits(&d, 1);
+    const uint8_t *out;
+    size_t outLen;
+    const InflateResult res = inflateStreamNext(&s, &out, &outLen);
 
-        // Read block type (2 bits)
-        const uint32_t btype = inflateGetBits(&d, 2);
-
-        InflateResult res;
-        switch (btype) {
-        case 0:  res = inflateStoredBlock(&d); break;
-        case 1:  res = inflateFixedBlock(&d); break;
-        case 2:  res = inflateDynamicBlock(&d); break;
-        default: res = INFLATE_ERROR; break;
-        }
-
-        if (res != INFLATE_OK)
-            return res;
-    } while (!bfinal);
-
-    if (d.overflow)
-        return INFLATE_ERROR;
+    // All input is there, so the stream either ends or fails
+    if (res != INFLATE_END)
+        return res;
 
-    *dstLen = (size_t)(d.dst - d.dstStart);
+    *dstLen = outLen;
     return INFLATE_OK;
-}
\ No newline at end of file
+}
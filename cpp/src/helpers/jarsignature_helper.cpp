@@ -0,0 +1,428 @@
+#include "jarsignature_helper.h"
+
+// Walks the header lines of a manifest, continuation lines are joined in place
+typedef struct {
+    char* pos;
+    char* end;
+} ManifestReader;
+
+// Running digest of an entry, fed by streamZipEntry
+typedef struct {
+    uint8_t type;
+    struct sha1 sha1;
+    struct sha256 sha256;
+} JarDigest;
+
+static size_t getJarDigestSize(uint8_t type) {
+    return type == JAR_DIGEST_SHA256 ? SHA256_BYTES_SIZE : SHA1_BYTES_SIZE;
+}
+
+static void initJarDigest(JarDigest& digest, uint8_t type) {
+    digest.type = type;
+    if (type == JAR_DIGEST_SHA256)
+        sha256_init(&digest.sha256);
+    else
+        sha1_init(&digest.sha1);
+}
+
+static void appendJarDigest(void* ctx, const uint8_t* data, size_t size) {
+    JarDigest* digest = (JarDigest*) ctx;
+    if (digest->type == JAR_DIGEST_SHA256)
+        sha256_append(&digest->sha256, data, size);
+    else
+        sha1_append(&digest->sha1, data, size);
+}
+
+static void finalizeJarDigest(JarDigest& digest, unsigned char* out) {
+    if (digest.type == JAR_DIGEST_SHA256)
+        sha256_finalize_bytes(&digest.sha256, out);
+    else
+        sha1_finalize_bytes(&digest.sha1, out);
+}
+
+// Decode standard base64 with padding. Returns the decoded length or -1
+static int decodeBase64(const char* in, size_t inLength, unsigned char* out, size_t outSize) {
+    uint32_t bits = 0;
+    int bitCount = 0;
+    size_t outLength = 0;
+    size_t padding = 0;
+
+    for (size_t i = 0; i < inLength; ++i) {
+        char c = in[i];
+        uint32_t value;
+
+        if (c >= 'A' && c <= 'Z') value = c - 'A';
+        else if (c >= 'a' && c <= 'z') value = c - 'a' + 26;
+        else if (c >= '0' && c <= '9') value = c - '0' + 52;
+        else if (c == '+') value = 62;
+        else if (c == '/') value = 63;
+        else if (c == '=') { padding++; continue; }
+        else return -1;
+
+        // Nothing may follow the padding
+        if (padding)
+            return -1;
+
+        bits = (bits << 6) | value;
+        bitCount += 6;
+
+        if (bitCount >= 8) {
+            bitCount -= 8;
+            if (outLength == outSize)
+                return -1;
+            out[outLength++] = (unsigned char) (bits >> bitCount);
+        }
+    }
+
+    if (padding > 2 || (inLength % 4) != 0)
+        return -1;
+
+    return (int) outLength;
+}
+
+// Header names are case insensitive
+static bool isHeader(const char* line, size_t nameLength, const char* expected) {
+    if (my_strlen(expected) != nameLength)
+        return false;
+
+    for (size_t i = 0; i < nameLength; ++i) {
+        if (my_tolower(line[i]) != my_tolower(expected[i]))
+            return false;
+    }
+
+    return true;
+}
+
+// Read the next header line. Returns 1 for a line, 0 for the blank line ending a section, -1 at the end of data
+static int nextManifestLine(ManifestReader& reader, char*& line, size_t& length) {
+    if (reader.pos >= reader.end)
+        return -1;
+
+    char* start = reader.pos;
+    char* out = reader.pos;
+
+    for (;;) {
+        while (reader.pos < reader.end && *reader.pos != '\r' && *reader.pos != '\n')
+            *out++ = *reader.pos++;
+
+        // Lines end with CRLF, LF or CR
+        if (reader.pos < reader.end && *reader.pos == '\r')
+            reader.pos++;
+        if (reader.pos < reader.end && *reader.pos == '\n')
+            reader.pos++;
+
+        // A line starting with a space continues the previous one
+        if (out == start || reader.pos >= reader.end || *reader.pos != ' ')
+            break;
+        reader.pos++;
+    }
+
+    line = start;
+    length = (size_t) (out - start);
+    return length ? 1 : 0;
+}
+
+// Split a header line into name and value
+static bool splitHeader(char* line, size_t length, size_t& nameLength, char*& value, size_t& valueLength) {
+    for (size_t i = 0; i + 1 < length; ++i) {
+        if (line[i] == ':' && line[i + 1] == ' ') {
+            nameLength = i;
+            value = line + i + 2;
+            valueLength = length - i - 2;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Parse MANIFEST.MF into a name indexed table of entry digests. data is modified in place and must outlive index
+int parseManifest(MyArena* arena, char* data, size_t size, ManifestIndex& index) {
+    index.entries = NULL;
+    index.count = 0;
+    index.buckets = NULL;
+
+    // Every entry has a Name line, count them to size the table in one go
+    size_t maxEntries = 0;
+    for (size_t i = 0; i + 5 <= size; ++i) {
+        if ((i == 0 || data[i - 1] == '\n' || data[i - 1] == '\r') && isHeader(data + i, 5, "Name:"))
+            maxEntries++;
+    }
+
+    size_t bucketCount = 16;
+    while (bucketCount < maxEntries * 2)
+        bucketCount <<= 1;
+
+    void* memory = my_arena_alloc(arena, maxEntries * sizeof(ManifestEntry) + bucketCount * sizeof(uint32_t));
+    if (memory == NULL) {
+        LOGE("Failed to allocate manifest index for %zu entries", maxEntries);
+        return -1;
+    }
+
+    index.buckets = (uint32_t*) memory;
+    index.bucketMask = bucketCount - 1;
+    index.entries = (ManifestEntry*) (index.buckets + bucketCount);
+
+    ManifestReader reader = { data, data + size };
+    char* line;
+    size_t length;
+    int ret;
+
+    // Skip the main section
+    while ((ret = nextManifestLine(reader, line, length)) == 1);
+
+    while (ret != -1) {
+        ManifestEntry entry = {};
+
+        while ((ret = nextManifestLine(reader, line, length)) == 1) {
+            size_t nameLength, valueLength;
+            char* value;
+            if (!splitHeader(line, length, nameLength, value, valueLength))
+                continue;
+
+            if (isHeader(line, nameLength, "Name")) {
+                entry.name = value;
+                entry.nameLength = (uint32_t) valueLength;
+            } else if (isHeader(line, nameLength, "SHA-256-Digest")) {
+                if (decodeBase64(value, valueLength, entry.digest, SHA256_BYTES_SIZE) != SHA256_BYTES_SIZE) {
+                    LOGE("Invalid SHA-256 digest in manifest");
+                    return -1;
+                }
+                entry.digestType = JAR_DIGEST_SHA256;
+            } else if ((isHeader(line, nameLength, "SHA1-Digest") || isHeader(line, nameLength, "SHA-1-Digest"))
+                       && entry.digestType != JAR_DIGEST_SHA256) {
+                if (decodeBase64(value, valueLength, entry.digest, SHA1_BYTES_SIZE) != SHA1_BYTES_SIZE) {
+                    LOGE("Invalid SHA-1 digest in manifest");
+                    return -1;
+                }
+                entry.digestType = JAR_DIGEST_SHA1;
+            }
+        }
+
+        if (entry.name == NULL)
+            continue;
+
+        if (findManifestEntry(index, entry.name, entry.nameLength) != NULL || index.count == maxEntries) {
+            LOGE("Duplicate manifest entry");
+            return -1;
+        }
+
+        size_t bucket = hashZipName(entry.name, entry.nameLength) & index.bucketMask;
+        while (index.buckets[bucket])
+            bucket = (bucket + 1) & index.bucketMask;
+
+        index.entries[index.count] = entry;
+        index.buckets[bucket] = (uint32_t) ++index.count;
+    }
+
+    LOGD("Manifest lists %zu entries", index.count);
+    return 0;
+}
+
+ManifestEntry* findManifestEntry(const ManifestIndex& index, const char* name, size_t nameLength) {
+    size_t bucket = hashZipName(name, nameLength) & index.bucketMask;
+
+    while (index.buckets[bucket]) {
+        ManifestEntry* entry = &index.entries[index.buckets[bucket] - 1];
+        if (entry->nameLength == nameLength && my_memcmp(entry->name, name, nameLength) == 0)
+            return entry;
+        bucket = (bucket + 1) & index.bucketMask;
+    }
+
+    return NULL;
+}
+
+// Collects a whole small entry (MANIFEST.MF, *.SF) in memory
+typedef struct {
+    char* data;
+    size_t size;
+} JarFileBuffer;
+
+static void appendJarFileBuffer(void* ctx, const uint8_t* data, size_t size) {
+    JarFileBuffer* buffer = (JarFileBuffer*) ctx;
+    my_memcpy(buffer->data + buffer->size, data, size);
+    buffer->size += size;
+}
+
+static int readJarFile(const ApkView& view, const ZipEntry& entry, ZipStreamWorkspace* workspace, JarFileBuffer& buffer) {
+    if (entry.uncompressedSize > JAR_FILE_MAX_SIZE) {
+        LOGE("%.*s is too large: %u", (int) entry.nameLength, entry.name, entry.uncompressedSize);
+        return -1;
+    }
+
+    buffer.data = (char*) my_arena_alloc(view.arena, entry.uncompressedSize);
+    buffer.size = 0;
+    if (buffer.data == NULL)
+        return -1;
+
+    // streamZipEntry never hands out more than the declared size
+    if (streamZipEntry(view, entry, workspace, appendJarFileBuffer, &buffer) < 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static bool hasPrefix(const char* name, size_t nameLength, const char* prefix) {
+    size_t prefixLength = my_strlen(prefix);
+    return nameLength >= prefixLength && my_memcmp(name, prefix, prefixLength) == 0;
+}
+
+// Check the whole manifest digest from the main section of the signature file
+static int verifyManifestDigest(char* signatureFile, size_t signatureFileSize, const char* manifest, size_t manifestSize) {
+    ManifestReader reader = { signatureFile, signatureFile + signatureFileSize };
+    char* line;
+    size_t length;
+
+    while (nextManifestLine(reader, line, length) == 1) {
+        size_t nameLength, valueLength;
+        char* value;
+        if (!splitHeader(line, length, nameLength, value, valueLength))
+            continue;
+
+        uint8_t type;
+        if (isHeader(line, nameLength, "SHA-256-Digest-Manifest"))
+            type = JAR_DIGEST_SHA256;
+        else if (isHeader(line, nameLength, "SHA1-Digest-Manifest") || isHeader(line, nameLength, "SHA-1-Digest-Manifest"))
+            type = JAR_DIGEST_SHA1;
+        else
+            continue;
+
+        unsigned char expected[JAR_DIGEST_MAX_SIZE];
+        if (decodeBase64(value, valueLength, expected, sizeof(expected)) != (int) getJarDigestSize(type)) {
+            LOGE("Invalid manifest digest in signature file");
+            return -1;
+        }
+
+        JarDigest digest;
+        unsigned char actual[JAR_DIGEST_MAX_SIZE];
+        initJarDigest(digest, type);
+        appendJarDigest(&digest, (const uint8_t*) manifest, manifestSize);
+        finalizeJarDigest(digest, actual);
+
+        if (my_memcmp(actual, expected, getJarDigestSize(type)) != 0) {
+            LOGE("Manifest digest does not match the signature file");
+            return -1;
+        }
+
+        LOGD("Manifest digest matches the signature file");
+        return 0;
+    }
+
+    LOGE("No supported manifest digest in signature file");
+    return -1;
+}
+
+// Inflate every entry straight into its digest, one window at a time, and check it against MANIFEST.MF
+static int verifyEntryDigests(const ApkView& view, const ZipIndex& zipIndex, ManifestIndex& index, ZipStreamWorkspace* workspace) {
+    size_t verified = 0;
+
+    for (size_t i = 0; i < zipIndex.count; ++i) {
+        const ZipEntry& entry = zipIndex.entries[i];
+
+        // Like Android, only entries outside META-INF need a digest, directories have none
+        if (hasPrefix(entry.name, entry.nameLength, JAR_META_INF_PREFIX)
+            || (entry.nameLength && entry.name[entry.nameLength - 1] == '/'))
+            continue;
+
+        ManifestEntry* manifestEntry = findManifestEntry(index, entry.name, entry.nameLength);
+        if (manifestEntry == NULL || manifestEntry->digestType == JAR_DIGEST_NONE) {
+            LOGE("%.*s has no digest in manifest", (int) entry.nameLength, entry.name);
+            return -1;
+        }
+
+        // A second entry with the same name could shadow the verified one
+        if (manifestEntry->seen) {
+            LOGE("Duplicate entry %.*s", (int) entry.nameLength, entry.name);
+            return -1;
+        }
+        manifestEntry->seen = true;
+
+        JarDigest digest;
+        initJarDigest(digest, manifestEntry->digestType);
+
+        if (streamZipEntry(view, entry, workspace, appendJarDigest, &digest) < 0) {
+            LOGE("Failed to read %.*s", (int) entry.nameLength, entry.name);
+            return -1;
+        }
+
+        unsigned char actual[JAR_DIGEST_MAX_SIZE];
+        finalizeJarDigest(digest, actual);
+
+        if (my_memcmp(actual, manifestEntry->digest, getJarDigestSize(digest.type)) != 0) {
+            LOGE("%.*s does not match its manifest digest", (int) entry.nameLength, entry.name);
+            return -1;
+        }
+
+        verified++;
+    }
+
+    LOGD("Verified %zu entries against the manifest", verified);
+    return 0;
+}
+
+// The signature file that goes with the first signature block, META-INF/<name>.SF for META-INF/<name>.RSA
+static const ZipEntry* findSignatureFile(const ZipIndex& zipIndex) {
+    const ZipEntry* signatureBlock = findZipEntryByClass(zipIndex, ZIP_CLASS_SIGNATURE_BLOCK);
+    if (signatureBlock == NULL)
+        return findZipEntryByClass(zipIndex, ZIP_CLASS_SIGNATURE_FILE);
+
+    char name[256];
+    size_t baseLength = signatureBlock->nameLength;
+    while (baseLength > 0 && signatureBlock->name[baseLength - 1] != '.')
+        baseLength--;
+    if (baseLength == 0 || baseLength + 2 > sizeof(name))
+        return NULL;
+
+    my_memcpy(name, signatureBlock->name, baseLength);
+    name[baseLength] = 'S';
+    name[baseLength + 1] = 'F';
+    return findZipEntry(zipIndex, name, baseLength + 2);
+}
+
+// Verify v1 signed contents: signature block -> signature file -> MANIFEST.MF -> every entry
+// The certificate handed back is the 1st one of the signature block that was checked, not a second read of it
+int verifyJarEntries(const ApkView& view, const ZipIndex& zipIndex, size_t& certSize, unsigned char* certData) {
+    // Find MANIFEST.MF, the signature file and its signature block
+    const ZipEntry* manifestEntry = findZipEntry(zipIndex, JAR_MANIFEST_NAME, my_strlen(JAR_MANIFEST_NAME));
+    const ZipEntry* signatureEntry = findSignatureFile(zipIndex);
+    const ZipEntry* signatureBlockEntry = findZipEntryByClass(zipIndex, ZIP_CLASS_SIGNATURE_BLOCK);
+
+    if (manifestEntry == NULL || signatureEntry == NULL || signatureBlockEntry == NULL) {
+        LOGE("Failed to find MANIFEST.MF, signature file and signature block");
+        return -1;
+    }
+
+    if (signatureBlockEntry->uncompressedSize > CERT_FILE_MAX_SIZE) {
+        LOGE("Invalid signature block size: %u", signatureBlockEntry->uncompressedSize);
+        return -1;
+    }
+
+    // One set of streaming buffers serves every entry
+    ZipStreamWorkspace* workspace = (ZipStreamWorkspace*) my_arena_alloc(view.arena, sizeof(ZipStreamWorkspace));
+    JarFileBuffer manifest = {}, signatureFile = {}, signatureBlock = {};
+    ManifestIndex index = {};
+    int success = -1;
+
+    // The signature file is checked against its signature before parsing, which rewrites it in place
+    if (workspace == NULL
+        || readJarFile(view, *manifestEntry, workspace, manifest) < 0
+        || readJarFile(view, *signatureEntry, workspace, signatureFile) < 0
+        || readJarFile(view, *signatureBlockEntry, workspace, signatureBlock) < 0) {
+        LOGE("Failed to read MANIFEST.MF, signature file and signature block");
+    } else if (verifyPkcs7Signature((const unsigned char*) signatureBlock.data, signatureBlock.size,
+                                    (const unsigned char*) signatureFile.data, signatureFile.size) < 0) {
+        LOGE("Signature block doesn't sign the signature file");
+    } else if (verifyManifestDigest(signatureFile.data, signatureFile.size, manifest.data, manifest.size) < 0) {
+        LOGE("Signature file doesn't cover this manifest");
+    } else if (parseManifest(view.arena, manifest.data, manifest.size, index) < 0) {
+        LOGE("Failed to parse MANIFEST.MF");
+    } else if (verifyEntryDigests(view, zipIndex, index, workspace) < 0) {
+        LOGE("APK entries don't match the signed manifest");
+    } else if (extract_cert_from_pkcs7((const unsigned char*) signatureBlock.data, signatureBlock.size, &certSize, certData) < 0) {
+        LOGE("Could not find cert data in the signature block");
+    } else {
+        success = 0;
+    }
+
+    return success;
+}
@@ -0,0 +1,12 @@
+#include "parallel_helper.h"
+
+size_t getParallelWorkerCount(size_t count) {
+    size_t workers = my_pool_threads();
+    if (workers > count) workers = count;
+    return workers > 0 ? workers : 1;
+}
+
+int runParallel(ParallelTask task, void* ctx, size_t count) {
+    my_pool_run(task, ctx, count);
+    return 0;
+}
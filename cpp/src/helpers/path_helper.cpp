@@ -23,44 +23,273 @@ FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 
 #include "path_helper.h"
 
-static const char * getFilenameExt(const char *filename) {
-    const char *dot = my_strrchr(filename, '.');
-    if (!dot || dot == filename) return "";
-    return dot + 1;
+// Start of our own ELF header, defined by the static linker
+extern "C" const ElfW(Ehdr) __ehdr_start __attribute__((weak, visibility("hidden")));
+
+// First newline in [p, end), or end. Lines are about a hundred bytes long so they're looked for a word at a time
+static const char * findLineEnd(const char * p, const char * end) {
+    while (end - p >= 8) {
+        // Same zero byte trick as the ZIP scanner, the lowest flagged byte is always a real newline
+        uint64_t x = readLE64(p) ^ 0x0a0a0a0a0a0a0a0aULL;
+        uint64_t zeros = (x - 0x0101010101010101ULL) & ~x & 0x8080808080808080ULL;
+        if (zeros) {
+            return p + __builtin_ctzll(zeros) / 8;
+        }
+        p += 8;
+    }
+
+    while (p < end && *p != '\n') p++;
+    return p;
+}
+
+// Skips a field and the spaces that follow it
+static const char * skipField(const char * p, const char * end) {
+    while (p < end && *p != ' ') p++;
+    while (p < end && *p == ' ') p++;
+    return p;
+}
+
+// The basename has to be something followed by a .apk extension, whatever its case
+static bool hasApkExtension(const char * path, size_t length) {
+    static const char extension[] = ".apk";
+    const size_t extensionLength = sizeof(extension) - 1;
+
+    if (length <= extensionLength || path[length - extensionLength - 1] == '/') {
+        return false;
+    }
+
+    const char * ext = path + length - extensionLength;
+    for (size_t i = 0; i < extensionLength; i++) {
+        if (my_tolower(ext[i]) != extension[i]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Install directories are named "<package>-<suffix>", so the package has to be a whole path component up to the
+// dash. Matching it anywhere would let com.foo pick up the APKs of com.foobar
+static bool hasPackageDirectory(const char * path, size_t length, const char * packageName, size_t packageNameLength) {
+    if (packageNameLength + 2 > length) return false;
+
+    const char * last = path + length - packageNameLength - 2;
+    for (const char * p = path; p <= last; p++) {
+        if (*p == '/' && p[packageNameLength + 1] == '-' && my_memcmp(p + 1, packageName, packageNameLength) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Copy of the path when it is an APK of our package, NULL otherwise
+static char * matchApkPath(MyArena * arena, const char * path, size_t length, const char * packageName, size_t packageNameLength) {
+    if (length == 0 || length >= PATH_SIZE) {
+        return nullptr;
+    }
+
+    // Only a few paths are APKs, so the suffix is cheaper to check first
+    if (!hasApkExtension(path, length) || !hasPackageDirectory(path, length, packageName, packageNameLength)) {
+        return nullptr;
+    }
+
+    char * result = (char *) my_arena_alloc(arena, length + 1);
+    if (result == nullptr) {
+        return nullptr;
+    }
+    my_memcpy(result, path, length);
+    result[length] = '\0';
+
+    return result;
+}
+
+// A line is "address perms offset dev inode [path]", the path being padded with spaces when there is one
+static char * getPathFromLine(MyArena * arena, const char * line, const char * end, const char * packageName, size_t packageNameLength) {
+    // Nearly every line ends with something other than an APK, or a " (deleted)" one, so they're rejected before parsing
+    if (line == end || (my_tolower(end[-1]) != 'k' && end[-1] != ')')) {
+        return nullptr;
+    }
+
+    const char * path = line;
+    for (int field = 0; field < 5; field++) {
+        path = skipField(path, end);
+    }
+
+    const char * pathEnd = path;
+    while (pathEnd < end && *pathEnd != ' ') pathEnd++;
+
+    return matchApkPath(arena, path, pathEnd - path, packageName, packageNameLength);
+}
+
+// Target of a /proc symlink when it is an APK of our package
+static char * readApkLink(MyArena * arena, int dirfd, const char * name, const char * packageName, size_t packageNameLength) {
+    char target[PATH_SIZE];
+    ssize_t length = my_readlinkat(dirfd, name, target, sizeof(target));
+    if (length <= 0) {
+        return nullptr;
+    }
+
+    // A target that fills the buffer may have been truncated, matchApkPath turns those down
+    return matchApkPath(arena, target, (size_t) length, packageName, packageNameLength);
+}
+
+static void formatHex(char * out, uintptr_t value) {
+    char digits[2 * sizeof(uintptr_t)];
+    int count = 0;
+    do {
+        digits[count++] = "0123456789abcdef"[value & 0xf];
+        value >>= 4;
+    } while (value);
+
+    while (count > 0) {
+        *out++ = digits[--count];
+    }
+    *out = '\0';
+}
+
+// With extractNativeLibs=false our library is mapped straight out of the APK. The segment holding this very
+// function gives the bounds of its mapping, and /proc/self/map_files has a link named after them
+static char * getApkPathFromOwnMapping(MyArena * arena, const char * packageName, size_t packageNameLength) {
+    const ElfW(Ehdr) * ehdr = &__ehdr_start;
+    if (ehdr == nullptr || my_memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0) {
+        return nullptr;
+    }
+
+    const ElfW(Phdr) * phdrs = (const ElfW(Phdr) *) ((const char *) ehdr + ehdr->e_phoff);
+
+    // The ELF header is loaded along with the segment at file offset 0, which gives the load bias
+    uintptr_t bias = 0;
+    bool foundHeader = false;
+    for (int i = 0; i < ehdr->e_phnum; i++) {
+        if (phdrs[i].p_type == PT_LOAD && phdrs[i].p_offset == 0) {
+            bias = (uintptr_t) ehdr - phdrs[i].p_vaddr;
+            foundHeader = true;
+            break;
+        }
+    }
+    if (!foundHeader) {
+        return nullptr;
+    }
+
+    uintptr_t address = (uintptr_t) &getApkPath;
+    uintptr_t pageSize = my_getauxval(AT_PAGESZ);
+    if (pageSize == 0) {
+        pageSize = 4096;
+    }
+
+    for (int i = 0; i < ehdr->e_phnum; i++) {
+        const ElfW(Phdr)& phdr = phdrs[i];
+        uintptr_t segmentStart = bias + phdr.p_vaddr;
+        if (phdr.p_type != PT_LOAD || address < segmentStart || address >= segmentStart + phdr.p_filesz) {
+            continue;
+        }
+
+        // The linker maps every segment from the start of its page to the end of its file contents
+        uintptr_t mapStart = segmentStart & ~(pageSize - 1);
+        uintptr_t mapEnd = (segmentStart + phdr.p_filesz + pageSize - 1) & ~(pageSize - 1);
+
+        char name[2 * (2 * sizeof(uintptr_t)) + 2];
+        formatHex(name, mapStart);
+        size_t length = my_strlen(name);
+        name[length] = '-';
+        formatHex(name + length + 1, mapEnd);
+
+        int dir_fd = my_openat(AT_FDCWD, "/proc/self/map_files", O_RDONLY | O_DIRECTORY);
+        if (dir_fd < 0) {
+            return nullptr;
+        }
+
+        char * path = readApkLink(arena, dir_fd, name, packageName, packageNameLength);
+        my_close(dir_fd);
+        return path;
+    }
+
+    return nullptr;
 }
 
-static char * getPathFromEntry(const char * line, const char * packageName) {
-    char path[PATH_SIZE];
-
-    char * copied_line = my_strdup(line);
-    const char * delim = " ";
-
-    int field = 0;
-    char * token = my_strtok(copied_line, delim);
-    while (token != nullptr) {
-        if (field == 5) { // The 6th field is the path
-            my_strlcpy(path, token, PATH_SIZE - 1);
-            path[PATH_SIZE - 1] = '\0';
-
-            if (my_strstr(path, packageName)) {
-                char * last_slash = my_strrchr(path, '/');
-                char * bname = last_slash ? last_slash + 1 : path;
-                
-                if (my_strcasecmp(getFilenameExt(bname), "apk") == 0) {
-                    return my_strdup(path);
+// ART keeps the APKs of the app open, so one of our file descriptors usually points to it
+static char * getApkPathFromFds(MyArena * arena, const char * packageName, size_t packageNameLength) {
+    int dir_fd = my_openat(AT_FDCWD, "/proc/self/fd", O_RDONLY | O_DIRECTORY);
+    if (dir_fd < 0) {
+        return nullptr;
+    }
+
+    alignas(8) char entries[FD_ENTRIES_SIZE];
+    char * path = nullptr;
+    long bytes;
+
+    while (path == nullptr && (bytes = my_getdents64(dir_fd, entries, sizeof(entries))) > 0) {
+        for (long offset = 0; offset < bytes && path == nullptr;) {
+            const struct linux_dirent64 * entry = (const struct linux_dirent64 *) (entries + offset);
+            offset += entry->d_reclen;
+
+            // Skip . and ..
+            if (entry->d_name[0] == '.') {
+                continue;
+            }
+
+            path = readApkLink(arena, dir_fd, entry->d_name, packageName, packageNameLength);
+        }
+    }
+
+    my_close(dir_fd);
+    return path;
+}
+
+static char * scanMaps(MyArena * arena, int fd, const char * packageName, size_t packageNameLength) {
+    char buffer[MAPS_BUFFER_SIZE];
+    size_t pending = 0; // Bytes of an unfinished line kept at the start of the buffer
+    bool skipping = false; // The current line didn't fit in the buffer, so it can't hold a usable path
+    char * path = nullptr;
+
+    while (path == nullptr) {
+        ssize_t bytes_read = my_read(fd, buffer + pending, MAPS_BUFFER_SIZE - pending);
+        if (bytes_read <= 0) {
+            // The last line might not be terminated by a newline
+            if (pending > 0 && !skipping) {
+                path = getPathFromLine(arena, buffer, buffer + pending, packageName, packageNameLength);
+            }
+            break;
+        }
+
+        const char * end = buffer + pending + bytes_read;
+        const char * line = buffer;
+        for (const char * p = findLineEnd(buffer + pending, end); p < end; p = findLineEnd(p + 1, end)) {
+            if (!skipping) {
+                path = getPathFromLine(arena, line, p, packageName, packageNameLength);
+                if (path) {
+                    break;
                 }
             }
+            skipping = false;
+            line = p + 1;
+        }
+
+        if (path) {
             break;
         }
 
-        token = my_strtok(nullptr, delim); // We have to pass NULL due to our custom strtok implementation !
-        field++;
+        // Move the unfinished line to the front, unless it already takes the whole buffer
+        pending = end - line;
+        if (pending == MAPS_BUFFER_SIZE) {
+            skipping = true;
+            pending = 0;
+        } else {
+            for (size_t i = 0; i < pending; i++) {
+                buffer[i] = line[i];
+            }
+        }
     }
 
-    return nullptr;
+    return path;
+}
+
+char * getApkPathFromMapsFd(MyArena * arena, int fd, const char * packageName) {
+    return scanMaps(arena, fd, packageName, my_strlen(packageName));
 }
 
-char * getApkPath(const char * packageName) {
+static char * getApkPathFromMaps(MyArena * arena, const char * packageName, size_t packageNameLength) {
     // Open the /proc/self directory
     int dir_fd = my_openat(AT_FDCWD, "/proc/self", O_RDONLY | O_DIRECTORY);
     if (dir_fd == -1) {
@@ -74,44 +303,106 @@ char * getApkPath(const char * packageName) {
         return nullptr;
     }
 
-    char buffer[FD_BUFFER_SIZE];
-    int bytes_read;
-    std::string current_line = "";
-    char * path;
+    char * path = scanMaps(arena, fd, packageName, packageNameLength);
+    my_close(fd); // Close file descriptor
 
-    // Read from the file descriptor directly
-    while ((bytes_read = my_read(fd, buffer, FD_BUFFER_SIZE - 1)) > 0) {
-        buffer[bytes_read] = '\0'; // Null-terminate the buffer
+    return path;
+}
 
-        // Process the content of the buffer line by line
-        for (int i = 0; i < bytes_read; ++i) {
-            if (buffer[i] == '\n' || buffer[i] == '\r') {
-                path = getPathFromEntry(current_line.c_str(), packageName);
-                current_line.clear();  // Reset the line for the next one
+// Cheapest strategies first, reading the whole of /proc/self/maps is the last resort
+char * getApkPath(MyArena * arena, const char * packageName) {
+    size_t packageNameLength = my_strlen(packageName);
 
-                if (path) {
-                    break;
-                }
-            } else {
-                current_line.push_back(buffer[i]);  // Append non-line-break characters to the current line
+    char * path = getApkPathFromOwnMapping(arena, packageName, packageNameLength);
+    if (path == nullptr) {
+        path = getApkPathFromFds(arena, packageName, packageNameLength);
+    }
+    if (path == nullptr) {
+        path = getApkPathFromMaps(arena, packageName, packageNameLength);
+    }
+
+    return path;
+}
+
+int getInstalledApkPaths(const char * apkPath, ApkPathList& apks) {
+    apks.count = 0;
+
+    const char * lastSlash = my_strrchr(apkPath, '/');
+    if (lastSlash == nullptr) {
+        return -1;
+    }
+
+    char directory[PATH_SIZE];
+    size_t directoryLength = lastSlash - apkPath + 1;
+    if (directoryLength >= PATH_SIZE) {
+        return -1;
+    }
+    my_memcpy(directory, apkPath, directoryLength);
+    directory[directoryLength] = '\0';
+
+    int dir_fd = my_openat(AT_FDCWD, directory, O_RDONLY | O_DIRECTORY);
+    if (dir_fd < 0) {
+        return -1;
+    }
+
+    alignas(8) char entries[FD_ENTRIES_SIZE];
+    long bytes = 0;
+    int success = 0;
+    bool foundBase = false;
+
+    while (success == 0 && (bytes = my_getdents64(dir_fd, entries, sizeof(entries))) > 0) {
+        for (long offset = 0; offset < bytes;) {
+            const struct linux_dirent64 * entry = (const struct linux_dirent64 *) (entries + offset);
+            offset += entry->d_reclen;
+
+            // Leaves out the lib and oat directories
+            if (entry->d_type != DT_REG && entry->d_type != DT_UNKNOWN) {
+                continue;
+            }
+
+            size_t nameLength = my_strlen(entry->d_name);
+            if (!hasApkExtension(entry->d_name, nameLength)) {
+                continue;
+            }
+
+            // Every APK has to be checked, so one we can't keep track of fails the whole list
+            if (apks.count == APK_MAX_FILES || directoryLength + nameLength >= PATH_SIZE) {
+                success = APK_LIST_OVERFLOW;
+                break;
             }
-        }
 
-        // If there's any data left in `line`, it means the last part wasn't terminated by a newline
-        if (!current_line.empty()) {
-            path = getPathFromEntry(current_line.c_str(), packageName);
+            char * path = apks.paths[apks.count++];
+            my_memcpy(path, directory, directoryLength);
+            my_memcpy(path + directoryLength, entry->d_name, nameLength + 1);
+
+            // base.apk goes first, it's the largest so it should be started on first
+            if (!foundBase && my_strncmp(entry->d_name, "base.apk", sizeof("base.apk")) == 0) {
+                foundBase = true;
+                if (apks.count > 1) {
+                    char swap[PATH_SIZE];
+                    my_memcpy(swap, apks.paths[0], PATH_SIZE);
+                    my_memcpy(apks.paths[0], path, PATH_SIZE);
+                    my_memcpy(path, swap, PATH_SIZE);
+                }
+            }
         }
+    }
 
-        if (path) {
-            break;
+    // Taken from the fd that was read rather than the path, which may point somewhere else by now
+    struct stat st;
+    if (success == 0) {
+        if (my_fstat(dir_fd, &st) < 0) {
+            success = -1;
+        } else {
+            getApkIdentity(st, apks.directoryIdentity);
         }
     }
 
-    my_close(fd); // Close file descriptor
+    my_close(dir_fd);
 
-    if (path) {
-        return my_strdup(path);
+    if (success == 0 && (bytes < 0 || apks.count == 0)) {
+        success = -1;
     }
 
-    return nullptr;
+    return success;
 }
\ No newline at end of file
@@ -35,413 +35,348 @@
 *Each item is saved in the form of{tag，length，content}
 */
 
-static uint32_t m_pos = 0;
-static size_t m_length = 0;
-static struct element *head = NULL;
-static struct element *tail = NULL;
-
-/**
- * Calculate the number of bytes occupied by length according to lenbyte.
- * 1) The most significant bit of the byte is 1, then the length of the low 7-bit number of bytes;
- * 2) The highest bit is 0, then lenbyte represents the length
- */
-static uint32_t getLengthNum(unsigned char lenbyte) {
-    uint32_t num = 1;
-    if (lenbyte & 0x80) {
-        num += lenbyte & 0x7f;
-    }
-    return num;
-}
-
-/**
- * Calculate length information based on lenbyte，
- * The algorithm is lenbyte the highest bit is 1，
- * Then lenbyte & 0x7F represent the length of the byte length,
- * Subsequent bytes are stored in big-endian mode. The highest bit is 0， Lenbyte directly represents the length
- *
- * 1) If 0x82 0x34 0x45 0x22 .... 0x82 is lenbyte,
- * The high level is 1, 0x82 & 0x7F == 2,
- * Then the following two bytes are the length information stored at the high end. The length information is 0x3445
-   2)If lenbyte == 0x34, the highest bit is 0, then the length information is 0x34
-*/
-static uint32_t getLength(unsigned char *certrsa, unsigned char lenbyte, int offset) {
-    int32_t len = 0, num;
-    unsigned char tmp;
-    if (lenbyte & 0x80) {
-        num = lenbyte & 0x7f;
-        if (num < 0 || num > 4) {
-            LOGE("ASN.1 element length is too long ! => %d", num);
-            return 0;
-        }
-        while (num) {
-            len <<= 8;
-            tmp = certrsa[offset++];
-            len += (tmp & 0xff);
-            num--;
-        }
-    } else {
-        len = lenbyte & 0xff;
-    }
-    assert(len >= 0);
-    return (uint32_t) len;
+// 1.2.840.113549.1.7.2
+static const unsigned char OID_SIGNED_DATA[] = { 0x2a, 0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01, 0x07, 0x02 };
+
+// 1.2.840.113549.1.1.1, 1.2.840.113549.1.1.5, 1.2.840.113549.1.1.11, 1.2.840.113549.1.1.13
+static const unsigned char OID_RSA_ENCRYPTION[] = { 0x2a, 0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01, 0x01, 0x01 };
+static const unsigned char OID_SHA1_WITH_RSA[] = { 0x2a, 0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01, 0x01, 0x05 };
+static const unsigned char OID_SHA256_WITH_RSA[] = { 0x2a, 0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01, 0x01, 0x0b };
+static const unsigned char OID_SHA512_WITH_RSA[] = { 0x2a, 0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01, 0x01, 0x0d };
+
+// 1.2.840.10045.2.1, 1.2.840.10045.3.1.7 (P-256)
+static const unsigned char OID_EC_PUBLIC_KEY[] = { 0x2a, 0x86, 0x48, 0xce, 0x3d, 0x02, 0x01 };
+static const unsigned char OID_PRIME256V1[] = { 0x2a, 0x86, 0x48, 0xce, 0x3d, 0x03, 0x01, 0x07 };
+
+// 1.2.840.10045.4.1, 1.2.840.10045.4.3.2, 1.2.840.10045.4.3.4
+static const unsigned char OID_ECDSA_WITH_SHA1[] = { 0x2a, 0x86, 0x48, 0xce, 0x3d, 0x04, 0x01 };
+static const unsigned char OID_ECDSA_WITH_SHA256[] = { 0x2a, 0x86, 0x48, 0xce, 0x3d, 0x04, 0x03, 0x02 };
+static const unsigned char OID_ECDSA_WITH_SHA512[] = { 0x2a, 0x86, 0x48, 0xce, 0x3d, 0x04, 0x03, 0x04 };
+
+// 1.2.840.113549.1.9.4
+static const unsigned char OID_MESSAGE_DIGEST[] = { 0x2a, 0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01, 0x09, 0x04 };
+
+// 1.3.14.3.2.26, 2.16.840.1.101.3.4.2.1, 2.16.840.1.101.3.4.2.3
+static const unsigned char OID_SHA1[] = { 0x2b, 0x0e, 0x03, 0x02, 0x1a };
+static const unsigned char OID_SHA256[] = { 0x60, 0x86, 0x48, 0x01, 0x65, 0x03, 0x04, 0x02, 0x01 };
+static const unsigned char OID_SHA512[] = { 0x60, 0x86, 0x48, 0x01, 0x65, 0x03, 0x04, 0x02, 0x03 };
+
+// ContentInfo wrapping a SignedData
+typedef DerConstructed<TAG_SEQUENCE, DER_NO_CAPTURE,
+    DerField<TAG_OBJECTID, PKCS7_CONTENT_TYPE>,
+    DerConstructed<TAG_CONTEXT(0), DER_NO_CAPTURE,
+        DerConstructed<TAG_SEQUENCE, DER_NO_CAPTURE,
+            DerField<TAG_INTEGER>,                                       // version
+            DerField<TAG_SET, PKCS7_DIGEST_ALGORITHMS>,
+            DerField<TAG_SEQUENCE, PKCS7_CONTENT_INFO>,
+            DerOptional<DerField<TAG_CONTEXT(0), PKCS7_CERTIFICATES>>,
+            DerOptional<DerField<TAG_CONTEXT(1)>>,                       // crls
+            DerField<TAG_SET, PKCS7_SIGNER_INFOS>>>> SignedDataSchema;
+
+typedef DerConstructed<TAG_SEQUENCE, DER_NO_CAPTURE,
+    DerField<TAG_INTEGER>,                                               // version
+    DerField<TAG_SEQUENCE, SIGNER_ISSUER_AND_SERIAL_NUMBER>,
+    DerField<TAG_SEQUENCE, SIGNER_DIGEST_ALGORITHM>,
+    DerOptional<DerField<TAG_CONTEXT(0), SIGNER_AUTHENTICATED_ATTRIBUTES>>,
+    DerField<TAG_SEQUENCE, SIGNER_DIGEST_ENCRYPTION_ALGORITHM>,
+    DerField<TAG_OCTETSTRING, SIGNER_ENCRYPTED_DIGEST>,
+    DerOptional<DerField<TAG_CONTEXT(1)>>> SignerInfoSchema;             // unauthenticatedAttributes
+
+typedef DerConstructed<TAG_SEQUENCE, DER_NO_CAPTURE,
+    DerConstructed<TAG_SEQUENCE, X509_TBS_CERTIFICATE,
+        DerOptional<DerField<TAG_CONTEXT(0)>>,                           // version
+        DerField<TAG_INTEGER, X509_SERIAL_NUMBER>,
+        DerField<TAG_SEQUENCE>,                                          // signature
+        DerField<TAG_SEQUENCE, X509_ISSUER>,
+        DerConstructed<TAG_SEQUENCE, DER_NO_CAPTURE,                     // validity
+            DerChoice<TAG_UTCTIME, TAG_GENERALIZEDTIME>,
+            DerChoice<TAG_UTCTIME, TAG_GENERALIZEDTIME>>,
+        DerField<TAG_SEQUENCE, X509_SUBJECT>,
+        DerField<TAG_SEQUENCE, X509_SUBJECT_PUBLIC_KEY_INFO>,
+        DerOptional<DerField<TAG_CONTEXT_PRIMITIVE(1)>>,                 // issuerUniqueID
+        DerOptional<DerField<TAG_CONTEXT_PRIMITIVE(2)>>,                 // subjectUniqueID
+        DerOptional<DerField<TAG_CONTEXT(3)>>>,                          // extensions
+    DerField<TAG_SEQUENCE, X509_SIGNATURE_ALGORITHM>,
+    DerField<TAG_BITSTRING, X509_SIGNATURE_VALUE>> CertificateSchema;
+
+typedef enum {
+    SPKI_ALGORITHM = 0,
+    SPKI_PARAMETERS,
+    SPKI_PUBLIC_KEY,
+    SPKI_FIELD_COUNT
+} SubjectPublicKeyInfoField;
+
+typedef DerConstructed<TAG_SEQUENCE, DER_NO_CAPTURE,
+    DerConstructed<TAG_SEQUENCE, DER_NO_CAPTURE,
+        DerField<TAG_OBJECTID, SPKI_ALGORITHM>,
+        DerOptional<DerChoice<TAG_NULL, TAG_OBJECTID, SPKI_PARAMETERS>>>,
+    DerField<TAG_BITSTRING, SPKI_PUBLIC_KEY>> SubjectPublicKeyInfoSchema;
+
+// AlgorithmIdentifier of a digest or a signature, the parameters are NULL or absent
+typedef DerConstructed<TAG_SEQUENCE, DER_NO_CAPTURE,
+    DerField<TAG_OBJECTID, 0>,
+    DerOptional<DerField<TAG_NULL>>> AlgorithmIdentifierSchema;
+
+typedef DerConstructed<TAG_SEQUENCE, DER_NO_CAPTURE,
+    DerField<TAG_SEQUENCE, 0>,                                           // issuer
+    DerField<TAG_INTEGER, 1>> IssuerAndSerialNumberSchema;               // serialNumber
+
+// Attribute : SEQUENCE { type OBJECT IDENTIFIER, values SET }
+typedef DerConstructed<TAG_SEQUENCE, DER_NO_CAPTURE,
+    DerField<TAG_OBJECTID, 0>,
+    DerField<TAG_SET, 1>> AttributeSchema;
+
+int parsePkcs7SignerInfo(const DerElement& element, Pkcs7SignerInfo& signerInfo) {
+    return derMatch<SignerInfoSchema>(element.header, derEncodedSize(element), signerInfo.fields);
 }
 
-/**
- * Each element has a corresponding element.
- */
-int32_t createElement(unsigned char *certrsa, unsigned char tag, char *name, int level) {
-    LOGD("Creating element \"%s\"", name);
-
-    unsigned char get_tag = certrsa[m_pos++];
-    if (get_tag != tag) {
-        m_pos--;
-        LOGE("Failed to create element \"%s\"", name);
+int parsePkcs7SignedData(const unsigned char* data, size_t size, Pkcs7SignedData& signedData) {
+    if (derMatch<SignedDataSchema>(data, size, signedData.fields) < 0) {
+        LOGE("PKCS7 data doesn't match the SignedData layout");
         return -1;
     }
 
-    unsigned char lenbyte = certrsa[m_pos];
-    int len = getLength(certrsa, lenbyte, m_pos + 1);
-    m_pos += getLengthNum(lenbyte);
-
-    element *node = (element *) calloc(1, sizeof(element));
-    node->tag = get_tag;
-    my_strlcpy(node->name, name, my_strlen(name) + 1);
-    node->begin = m_pos;
-    node->len = len;
-    node->level = level;
-    node->next = NULL;
-
-    if (head == NULL) {
-        head = tail = node;
-    } else {
-        tail->next = node;
-        tail = node;
-    }
-    return len;
-}
-
-/**
- * Parse certificate information
- */
-int parseCertificate(unsigned char *certrsa, int level) {
-    char *names[] = {
-            "tbsCertificate",
-            "version",
-            "serialNumber",
-            "signature",
-            "issuer",
-            "validity",
-            "subject",
-            "subjectPublicKeyInfo",
-            "issuerUniqueID-[optional]",
-            "subjectUniqueID-[optional]",
-            "extensions-[optional]",
-            "signatureAlgorithm",
-            "signatureValue"};
-    int len = 0;
-    unsigned char tag;
-
-    len = createElement(certrsa, TAG_SEQUENCE, names[0], level);
-    if (len == -1 || m_pos + len > m_length) {
+    //contentType
+    if (!derOidEquals(signedData.fields[PKCS7_CONTENT_TYPE], OID_SIGNED_DATA, sizeof(OID_SIGNED_DATA))) {
+        LOGE("Failed to find contentType");
         return -1;
     }
 
-    //version
-    tag = certrsa[m_pos];
-    if (((tag & 0xc0) == 0x80) && ((tag & 0x1f) == 0)) {
-        m_pos += 1;
-        m_pos += getLengthNum(certrsa[m_pos]);
-        len = createElement(certrsa, TAG_INTEGER, names[1], level + 1);
-        if (len == -1 || m_pos + len > m_length) {
+    // Every signerInfo has to match its layout as well
+    DerCursor signerInfos;
+    DerElement element;
+    Pkcs7SignerInfo signerInfo;
+    derEnter(signedData.fields[PKCS7_SIGNER_INFOS], signerInfos);
+    while (!derAtEnd(signerInfos)) {
+        if (derNext(signerInfos, element) < 0 || parsePkcs7SignerInfo(element, signerInfo) < 0) {
+            LOGE("Failed to parse signerInfo");
             return -1;
         }
-        m_pos += len;
     }
 
-    for (int i = 2; i < 11; i++) {
-        switch (i) {
-            case 2:
-                tag = TAG_INTEGER;
-                break;
-            case 8:
-                tag = 0xA1;
-                break;
-            case 9:
-                tag = 0xA2;
-                break;
-            case 10:
-                tag = 0xA3;
-                break;
-            default:
-                tag = TAG_SEQUENCE;
-        }
-        len = createElement(certrsa, tag, names[i], level + 1);
-        if (i < 8 && len == -1) {
-            return -1;
-        }
-        if (len != -1)
-            m_pos += len;
-    }
-    //signatureAlgorithm
-    len = createElement(certrsa, TAG_SEQUENCE, names[11], level);
-    if (len == -1 || m_pos + len > m_length) {
-        return -1;
-    }
-    m_pos += len;
-    //signatureValue
-    len = createElement(certrsa, TAG_BITSTRING, names[12], level);
-    if (len == -1 || m_pos + len > m_length) {
-        return -1;
-    }
-    m_pos += len;
     return 0;
 }
 
-/**
- * Resolve signer information
- */
-int parseSignerInfo(unsigned char *certrsa, int level) {
-    char *names[] = {
-            "version",
-            "issuerAndSerialNumber",
-            "digestAlgorithmId",
-            "authenticatedAttributes-[optional]",
-            "digestEncryptionAlgorithmId",
-            "encryptedDigest",
-            "unauthenticatedAttributes-[optional]"};
-    int len;
-    unsigned char tag;
-    for (int i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
-        switch (i) {
-            case 0:
-                tag = TAG_INTEGER;
-                break;
-            case 3:
-                tag = 0xA0;
-                break;
-            case 5:
-                tag = TAG_OCTETSTRING;
-                break;
-            case 6:
-                tag = 0xA1;
-                break;
-            default:
-                tag = TAG_SEQUENCE;
+int parseX509Certificate(const unsigned char* data, size_t size, X509Certificate& certificate) {
+    return derMatch<CertificateSchema>(data, size, certificate.fields);
+}
 
-        }
-        len = createElement(certrsa, tag, names[i], level);
-        if (len == -1 || m_pos + len > m_length) {
-            if (i == 3 || i == 6)
-                continue;
-            return -1;
-        }
-        m_pos += len;
-    }
-    return m_pos == m_length ? 0 : -1;
+static bool derEquals(const DerElement& a, const DerElement& b) {
+    size_t size = derEncodedSize(a);
+    return size == derEncodedSize(b) && my_memcmp(a.header, b.header, size) == 0;
 }
 
-int parseContent(unsigned char *certrsa, int level) {
-    char *names[] = {"version",
-                     "DigestAlgorithms",
-                     "contentInfo",
-                     "certificates-[optional]",
-                     "crls-[optional]",
-                     "signerInfos",
-                     "signerInfo"};
-
-    unsigned char tag;
-    int len = 0;
-
-    //version
-    len = createElement(certrsa, TAG_INTEGER, names[0], level);
-    if (len == -1 || m_pos + len > m_length) {
+int verifyPublicKeySignature(const DerElement& subjectPublicKeyInfo, SignatureScheme scheme, RsaHashType hashType,
+                             const unsigned char* digest, const unsigned char* signature, size_t signatureSize) {
+    DerElement fields[SPKI_FIELD_COUNT];
+    if (derMatch<SubjectPublicKeyInfoSchema>(subjectPublicKeyInfo.header, derEncodedSize(subjectPublicKeyInfo), fields) < 0) {
+        LOGE("Invalid SubjectPublicKeyInfo");
         return -1;
     }
-    m_pos += len;
 
-    //DigestAlgorithms
-    len = createElement(certrsa, TAG_SET, names[1], level);
-    if (len == -1 || m_pos + len > m_length) {
+    DerCursor cursor;
+    const unsigned char* publicKey;
+    size_t publicKeySize;
+    derInit(cursor, fields[SPKI_PUBLIC_KEY].header, derEncodedSize(fields[SPKI_PUBLIC_KEY]));
+    if (derBitString(cursor, publicKey, publicKeySize) < 0)
         return -1;
-    }
-    m_pos += len;
 
-    //contentInfo
-    len = createElement(certrsa, TAG_SEQUENCE, names[2], level);
-    if (len == -1 || m_pos + len > m_length) {
-        return -1;
-    }
-    m_pos += len;
-
-    //certificates-[optional]
-    tag = certrsa[m_pos];
-    if (tag == TAG_OPTIONAL) {
-        m_pos++;
-        m_pos += getLengthNum(certrsa[m_pos]);
-        len = createElement(certrsa, TAG_SEQUENCE, names[3], level);
-        if (len == -1 || m_pos + len > m_length) {
+    const DerElement& algorithm = fields[SPKI_ALGORITHM];
+    if (scheme == SIGNATURE_ECDSA
+        && derOidEquals(algorithm, OID_EC_PUBLIC_KEY, sizeof(OID_EC_PUBLIC_KEY))
+        && derOidEquals(fields[SPKI_PARAMETERS], OID_PRIME256V1, sizeof(OID_PRIME256V1))) {
+        EcPublicKey key;
+        if (parseEcPublicKey(publicKey, publicKeySize, key) < 0)
             return -1;
-        }
-        int ret = parseCertificate(certrsa, level + 1);
-        if (ret == -1) {
-            return ret;
-        }
+
+        return verifyEcdsaSignature(key, digest, getRsaHashSize(hashType), signature, signatureSize);
     }
 
-    //crls-[optional]
-    tag = certrsa[m_pos];
-    if (tag == 0xA1) {
-        m_pos++;
-        m_pos += getLengthNum(certrsa[m_pos]);
-        len = createElement(certrsa, TAG_SEQUENCE, names[4], level);
-        if (len == -1 || m_pos + len > m_length) {
+    if (scheme != SIGNATURE_ECDSA && derOidEquals(algorithm, OID_RSA_ENCRYPTION, sizeof(OID_RSA_ENCRYPTION))) {
+        RsaPublicKey key;
+        if (parseRsaPublicKey(publicKey, publicKeySize, key) < 0)
             return -1;
-        }
-        m_pos += len;
+
+        if (scheme == SIGNATURE_RSA_PSS)
+            return verifyRsaPssSignature(key, hashType, digest, signature, signatureSize);
+        return verifyRsaPkcs1Signature(key, hashType, digest, signature, signatureSize);
     }
 
-    //signerInfos
-    tag = certrsa[m_pos];
-    if (tag != TAG_SET) {
+    LOGE("Unsupported public key algorithm");
+    return -1;
+}
+
+static int getDigestAlgorithm(const DerElement& algorithm, RsaHashType& hashType) {
+    DerElement oid[1];
+    if (derMatch<AlgorithmIdentifierSchema>(algorithm.header, derEncodedSize(algorithm), oid) < 0)
         return -1;
-    }
-    len = createElement(certrsa, TAG_SET, names[5], level);
-    if (len == -1 || m_pos + len > m_length) {
+
+    if (derOidEquals(oid[0], OID_SHA256, sizeof(OID_SHA256)))
+        hashType = RSA_HASH_SHA256;
+    else if (derOidEquals(oid[0], OID_SHA512, sizeof(OID_SHA512)))
+        hashType = RSA_HASH_SHA512;
+    else if (derOidEquals(oid[0], OID_SHA1, sizeof(OID_SHA1)))
+        hashType = RSA_HASH_SHA1;
+    else
         return -1;
-    }
 
-    //signerInfo
-    len = createElement(certrsa, TAG_SEQUENCE, names[6], level + 1);
-    if (len == -1 || m_pos + len > m_length) {
+    return 0;
+}
+
+// jarsigner and apksigner write the key algorithm (rsaEncryption, ecPublicKey), some other tools the one with the digest
+static int getSignatureScheme(const DerElement& algorithm, SignatureScheme& scheme) {
+    DerElement oid[1];
+    if (derMatch<AlgorithmIdentifierSchema>(algorithm.header, derEncodedSize(algorithm), oid) < 0)
         return -1;
+
+    if (derOidEquals(oid[0], OID_RSA_ENCRYPTION, sizeof(OID_RSA_ENCRYPTION))
+        || derOidEquals(oid[0], OID_SHA1_WITH_RSA, sizeof(OID_SHA1_WITH_RSA))
+        || derOidEquals(oid[0], OID_SHA256_WITH_RSA, sizeof(OID_SHA256_WITH_RSA))
+        || derOidEquals(oid[0], OID_SHA512_WITH_RSA, sizeof(OID_SHA512_WITH_RSA))) {
+        scheme = SIGNATURE_RSA_PKCS1_V1_5;
+        return 0;
+    }
+
+    if (derOidEquals(oid[0], OID_EC_PUBLIC_KEY, sizeof(OID_EC_PUBLIC_KEY))
+        || derOidEquals(oid[0], OID_ECDSA_WITH_SHA1, sizeof(OID_ECDSA_WITH_SHA1))
+        || derOidEquals(oid[0], OID_ECDSA_WITH_SHA256, sizeof(OID_ECDSA_WITH_SHA256))
+        || derOidEquals(oid[0], OID_ECDSA_WITH_SHA512, sizeof(OID_ECDSA_WITH_SHA512))) {
+        scheme = SIGNATURE_ECDSA;
+        return 0;
     }
-    return parseSignerInfo(certrsa, level + 2);
+
+    return -1;
 }
 
-/**
- *Finds the element in pkcs7 by name, returns NULL if it is not found.
- *name: name of the element we look for
- *begin: beginning of the search
- */
-static element *getElement(const char *name, element *begin) {
-    if (begin == NULL)
-        begin = head;
-
-    element *p = begin;
-    while (p != NULL) {
-        if (my_strncmp(p->name, name, my_strlen(name)) == 0) {
-            return p;
-        }
+// The messageDigest attribute, which must be there whenever there are authenticated attributes
+static int findMessageDigest(const DerElement& attributes, const unsigned char*& digest, size_t& digestSize) {
+    DerCursor cursor;
+    DerElement element, fields[2];
+    derEnter(attributes, cursor);
+    while (!derAtEnd(cursor)) {
+        if (derNext(cursor, element) < 0 || derMatch<AttributeSchema>(element.header, derEncodedSize(element), fields) < 0)
+            return -1;
 
-        p = p->next;
+        if (!derOidEquals(fields[0], OID_MESSAGE_DIGEST, sizeof(OID_MESSAGE_DIGEST)))
+            continue;
+
+        DerCursor values;
+        derEnter(fields[1], values);
+        if (derOctetString(values, digest, digestSize) < 0 || !derAtEnd(values))
+            return -1;
+        return 0;
     }
 
-    LOGE("Failed to find the element \"%s\"", name);
-    return p;
+    return -1;
 }
 
-static int parse(unsigned char *certrsa, size_t length) {
-    unsigned char tag, lenbyte;
-    int len = 0;
-    int level = 0;
-    m_pos = 0;
-    m_length = length;
-
-    tag = certrsa[m_pos++];
-    if (tag != TAG_SEQUENCE) {
-        LOGE("Tag does not match ASN.1");
+int verifyPkcs7Signature(const unsigned char* data, size_t size, const unsigned char* content, size_t contentSize) {
+    Pkcs7SignedData signedData;
+    if (parsePkcs7SignedData(data, size, signedData) < 0 || signedData.fields[PKCS7_CERTIFICATES].data == NULL) {
+        LOGE("Failed to parse PKCS7 data...");
         return -1;
     }
 
-    lenbyte = certrsa[m_pos];
-    len = getLength(certrsa, lenbyte, m_pos + 1);
-    m_pos += getLengthNum(lenbyte);
-    if (m_pos + len > m_length)
+    // The 1st certificate is the one we hash, so it has to be the one that signed
+    DerCursor cursor;
+    DerElement element;
+    X509Certificate certificate;
+    derEnter(signedData.fields[PKCS7_CERTIFICATES], cursor);
+    if (derNext(cursor, element) < 0 || parseX509Certificate(element.header, derEncodedSize(element), certificate) < 0) {
+        LOGE("Failed to parse the 1st certificate");
         return -1;
+    }
 
-    //contentType
-    len = createElement(certrsa, TAG_OBJECTID, "contentType", level);
-    if (len == -1) {
-        LOGE("Failed to find contentType");
+    Pkcs7SignerInfo signerInfo;
+    derEnter(signedData.fields[PKCS7_SIGNER_INFOS], cursor);
+    if (derNext(cursor, element) < 0 || parsePkcs7SignerInfo(element, signerInfo) < 0) {
+        LOGE("Failed to parse signerInfo");
         return -1;
     }
-    m_pos += len;
 
-    //optional
-    tag = certrsa[m_pos++];
-    lenbyte = certrsa[m_pos];
-    m_pos += getLengthNum(lenbyte);
+    const DerElement& issuerAndSerialNumber = signerInfo.fields[SIGNER_ISSUER_AND_SERIAL_NUMBER];
+    DerElement signerId[2];
+    if (derMatch<IssuerAndSerialNumberSchema>(issuerAndSerialNumber.header, derEncodedSize(issuerAndSerialNumber), signerId) < 0
+        || !derEquals(signerId[0], certificate.fields[X509_ISSUER])
+        || !derEquals(signerId[1], certificate.fields[X509_SERIAL_NUMBER])) {
+        LOGE("signerInfo doesn't refer to the 1st certificate");
+        return -1;
+    }
 
-    //content-[optional]
-    len = createElement(certrsa, TAG_SEQUENCE, "content-[optional]", level);
-    if (len == -1) {
-        LOGE("Failed to find content-[optional]");
+    RsaHashType hashType;
+    SignatureScheme scheme;
+    if (getDigestAlgorithm(signerInfo.fields[SIGNER_DIGEST_ALGORITHM], hashType) < 0
+        || getSignatureScheme(signerInfo.fields[SIGNER_DIGEST_ENCRYPTION_ALGORITHM], scheme) < 0) {
+        LOGE("Unsupported signerInfo algorithms");
         return -1;
     }
 
-    return parseContent(certrsa, level + 1);
-}
+    size_t digestSize = getRsaHashSize(hashType);
+    unsigned char digest[SHA512_BYTES_SIZE];
+    RsaHash hash;
+    rsaHashInit(hash, hashType);
+    rsaHashAppend(hash, content, contentSize);
+    rsaHashFinalize(hash, digest);
+
+    // With authenticated attributes the signature covers them, as a SET, and they carry the digest of the content
+    const DerElement& attributes = signerInfo.fields[SIGNER_AUTHENTICATED_ATTRIBUTES];
+    if (attributes.data != NULL) {
+        const unsigned char* messageDigest;
+        size_t messageDigestSize;
+        if (findMessageDigest(attributes, messageDigest, messageDigestSize) < 0
+            || messageDigestSize != digestSize || my_memcmp(messageDigest, digest, digestSize) != 0) {
+            LOGE("messageDigest attribute doesn't match the signed content");
+            return -1;
+        }
 
-/**
- * Convert length information to ASN.1 length format
- * len <= 0x7f       1
- * len >= 0x80       1 + Non-zero bytes
- */
-static size_t getNumFromLen(size_t len) {
-    size_t num = 0;
-    size_t tmp = len;
-    while (tmp) {
-        num++;
-        tmp >>= 8;
+        static const unsigned char setTag = TAG_SET;
+        rsaHashInit(hash, hashType);
+        rsaHashAppend(hash, &setTag, 1);
+        rsaHashAppend(hash, attributes.header + 1, derEncodedSize(attributes) - 1);
+        rsaHashFinalize(hash, digest);
     }
-    if ((num == 1 && len >= 0x80) || (num > 1))
-        num += 1;
-    return num;
-}
 
-/**
- *Each element element is a {tag, length, data} triple, tag and length are saved by tag and len, and data is saved by [begin, begin+len].
- *
- *This function calculates the offset from the data position to the tag position
- */
-size_t getTagOffset(element *p, unsigned char *certrsa) {
-    if (p == NULL)
-        return 0;
-    size_t offset = getNumFromLen(p->len);
-    if (certrsa[p->begin - offset - 1] == p->tag)
-        return offset + 1;
-    else
-        return 0;
+    const DerElement& encryptedDigest = signerInfo.fields[SIGNER_ENCRYPTED_DIGEST];
+    if (verifyPublicKeySignature(certificate.fields[X509_SUBJECT_PUBLIC_KEY_INFO], scheme, hashType, digest,
+                                 encryptedDigest.data, encryptedDigest.size) < 0) {
+        LOGE("signerInfo signature doesn't match");
+        return -1;
+    }
+
+    return 0;
 }
 
 // Extracts the first X.509 certificate from PKCS7 DER
-int extract_cert_from_pkcs7(unsigned char * pkcs7_cert, size_t len_in, size_t *len_out, unsigned char * data) {
-    // We make sure to reset every static data
-    m_pos = 0;
-    m_length = 0;
-    element *head = NULL;
-    element *tail = NULL;
-
-    if (parse(pkcs7_cert, len_in) == -1) {
+int extract_cert_from_pkcs7(const unsigned char * pkcs7_cert, size_t len_in, size_t *len_out, unsigned char * data) {
+    Pkcs7SignedData signedData;
+    if (parsePkcs7SignedData(pkcs7_cert, len_in, signedData) < 0) {
         LOGE("Failed to parse PKCS7 data...");
         return -1;
     }
 
+    const DerElement& certificates = signedData.fields[PKCS7_CERTIFICATES];
+    if (certificates.data == NULL) {
+        LOGE("Failed to find the element \"certificates-[optional]\"");
+        return -1;
+    }
+
     // We get the 1st certificate
-    element *p_cert = getElement("certificates-[optional]", head);
-    if (!p_cert) {
+    DerCursor cursor;
+    DerElement element;
+    X509Certificate certificate;
+    derEnter(certificates, cursor);
+    if (derNext(cursor, element) < 0 || parseX509Certificate(element.header, derEncodedSize(element), certificate) < 0) {
+        LOGE("Failed to parse the 1st certificate");
         return -1;
     }
 
-    size_t offset = getTagOffset(p_cert, pkcs7_cert);
-    if (offset == 0) {
-        LOGD("Failed to find offset !");
+    *len_out = derEncodedSize(element);
+    if (*len_out > PKCS7_CERT_MAX_SIZE) {
+        LOGE("Certificate is too large: %zu bytes", *len_out);
         return -1;
     }
 
-    *len_out = p_cert->len + offset;
-    my_memcpy(data, pkcs7_cert + p_cert->begin - offset, *len_out);
+    my_memcpy(data, element.header, *len_out);
 
     return 0;
 }
-
@@ -0,0 +1,380 @@
+// RSA signature verification : https://www.rfc-editor.org/rfc/rfc8017
+// Public key operations only, so nothing here needs to run in constant time
+
+#include "rsa_helper.h"
+
+// DigestInfo : SEQUENCE { AlgorithmIdentifier { OID, NULL }, OCTET STRING digest }, everything before the digest
+static const unsigned char DIGEST_INFO_SHA1[] = {
+    0x30, 0x21, 0x30, 0x09, 0x06, 0x05, 0x2b, 0x0e, 0x03, 0x02, 0x1a, 0x05, 0x00, 0x04, 0x14 };
+static const unsigned char DIGEST_INFO_SHA256[] = {
+    0x30, 0x31, 0x30, 0x0d, 0x06, 0x09, 0x60, 0x86, 0x48, 0x01, 0x65, 0x03, 0x04, 0x02, 0x01, 0x05, 0x00, 0x04, 0x20 };
+static const unsigned char DIGEST_INFO_SHA512[] = {
+    0x30, 0x51, 0x30, 0x0d, 0x06, 0x09, 0x60, 0x86, 0x48, 0x01, 0x65, 0x03, 0x04, 0x02, 0x03, 0x05, 0x00, 0x04, 0x40 };
+
+typedef DerConstructed<TAG_SEQUENCE, DER_NO_CAPTURE,
+    DerField<TAG_INTEGER, 0>,   // modulus
+    DerField<TAG_INTEGER, 1>>   // publicExponent
+    RsaPublicKeySchema;
+
+size_t getRsaHashSize(RsaHashType type) {
+    switch (type) {
+        case RSA_HASH_SHA1:
+            return SHA1_BYTES_SIZE;
+        case RSA_HASH_SHA512:
+            return SHA512_BYTES_SIZE;
+        default:
+            return SHA256_BYTES_SIZE;
+    }
+}
+
+void rsaHashInit(RsaHash& hash, RsaHashType type) {
+    hash.type = type;
+    if (type == RSA_HASH_SHA1)
+        sha1_init(&hash.sha1);
+    else if (type == RSA_HASH_SHA512)
+        sha512_init(&hash.sha512);
+    else
+        sha256_init(&hash.sha256);
+}
+
+void rsaHashAppend(RsaHash& hash, const void* data, size_t size) {
+    if (hash.type == RSA_HASH_SHA1)
+        sha1_append(&hash.sha1, data, size);
+    else if (hash.type == RSA_HASH_SHA512)
+        sha512_append(&hash.sha512, data, size);
+    else
+        sha256_append(&hash.sha256, data, size);
+}
+
+void rsaHashFinalize(RsaHash& hash, unsigned char* digest) {
+    if (hash.type == RSA_HASH_SHA1)
+        sha1_finalize_bytes(&hash.sha1, digest);
+    else if (hash.type == RSA_HASH_SHA512)
+        sha512_finalize_bytes(&hash.sha512, digest);
+    else
+        sha256_finalize_bytes(&hash.sha256, digest);
+}
+
+static int compareLimbs(const uint64_t* a, const uint64_t* b, size_t limbs) {
+    for (size_t i = limbs; i-- > 0;) {
+        if (a[i] != b[i])
+            return a[i] < b[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+// r = a - b, returns the borrow
+static uint64_t subLimbs(uint64_t* r, const uint64_t* a, const uint64_t* b, size_t limbs) {
+    uint64_t borrow = 0;
+    for (size_t i = 0; i < limbs; i++) {
+        uint64_t d = a[i] - b[i];
+        uint64_t nextBorrow = (a[i] < b[i]) | (d < borrow);
+        r[i] = d - borrow;
+        borrow = nextBorrow;
+    }
+    return borrow;
+}
+
+// r = a * b / R mod n, coarsely integrated operand scanning (CIOS) with both products in one pass. r may alias a or b
+static void montMul(uint64_t* r, const uint64_t* a, const uint64_t* b, const RsaPublicKey& key) {
+    const size_t k = key.limbs;
+    const uint64_t* n = key.n;
+    uint64_t t[RSA_MAX_LIMBS + 1];
+    my_memset(t, 0, (k + 1) * sizeof(uint64_t));
+
+    for (size_t i = 0; i < k; i++) {
+        // t + a * b[i] + m * n, m chosen so that the lowest limb becomes zero, then dropped
+        uint64_t productCarry, reduceCarry;
+        uint64_t low = mulAdd(a[0], b[i], t[0], 0, productCarry);
+        uint64_t m = low * key.n0inv;
+        mulAdd(m, n[0], low, 0, reduceCarry);
+
+        for (size_t j = 1; j < k; j++) {
+            uint64_t sum = mulAdd(a[j], b[i], t[j], productCarry, productCarry);
+            t[j - 1] = mulAdd(m, n[j], sum, reduceCarry, reduceCarry);
+        }
+
+        uint64_t sum = t[k] + productCarry;
+        uint64_t top = sum < productCarry;
+        t[k - 1] = sum + reduceCarry;
+        t[k] = top + (t[k - 1] < reduceCarry);
+    }
+
+    // t < 2n at this point
+    if (t[k] || compareLimbs(t, n, k) >= 0)
+        subLimbs(r, t, n, k);
+    else
+        my_memcpy(r, t, k * sizeof(uint64_t));
+}
+
+// R^2 mod n. Doubling 2^(bits(n) - 1) up to 2^(64 limbs + j) with 64 limbs = j 2^s gives 2^j in Montgomery form,
+// each Montgomery squaring then doubles the power until it reaches R in Montgomery form, which is R^2 mod n
+static void computeRR(RsaPublicKey& key) {
+    const size_t k = key.limbs;
+    size_t bits = 64 * k;
+    size_t s = (size_t) __builtin_ctzll((unsigned long long) bits);
+    size_t j = bits >> s;
+
+    size_t modulusBits = 64 * (k - 1) + (64 - __builtin_clzll(key.n[k - 1]));
+
+    uint64_t* x = key.rr;
+    my_memset(x, 0, k * sizeof(uint64_t));
+    x[(modulusBits - 1) / 64] = 1ULL << ((modulusBits - 1) % 64);
+
+    for (size_t i = modulusBits - 1; i < bits + j; i++) {
+        uint64_t top = x[k - 1] >> 63;
+        for (size_t l = k - 1; l > 0; l--)
+            x[l] = (x[l] << 1) | (x[l - 1] >> 63);
+        x[0] <<= 1;
+
+        if (top || compareLimbs(x, key.n, k) >= 0)
+            subLimbs(x, x, key.n, k);
+    }
+
+    while (s--)
+        montMul(x, x, x, key);
+}
+
+static void bytesToLimbs(uint64_t* limbs, size_t count, const unsigned char* bytes, size_t size) {
+    my_memset(limbs, 0, count * sizeof(uint64_t));
+    for (size_t i = 0; i < size; i++)
+        limbs[i / 8] |= (uint64_t) bytes[size - 1 - i] << (8 * (i % 8));
+}
+
+static void limbsToBytes(unsigned char* bytes, size_t size, const uint64_t* limbs) {
+    for (size_t i = 0; i < size; i++)
+        bytes[size - 1 - i] = (unsigned char) (limbs[i / 8] >> (8 * (i % 8)));
+}
+
+int parseRsaPublicKey(const unsigned char* der, size_t size, RsaPublicKey& key) {
+    DerElement fields[2];
+    if (derMatch<RsaPublicKeySchema>(der, size, fields) < 0) {
+        LOGE("Invalid RSA public key");
+        return -1;
+    }
+
+    DerCursor cursor;
+    const unsigned char *modulus, *exponent;
+    size_t modulusSize, exponentSize;
+
+    derInit(cursor, fields[0].header, derEncodedSize(fields[0]));
+    if (derInteger(cursor, modulus, modulusSize) < 0)
+        return -1;
+
+    derInit(cursor, fields[1].header, derEncodedSize(fields[1]));
+    if (derInteger(cursor, exponent, exponentSize) < 0)
+        return -1;
+
+    size_t bits = modulusSize * 8 - (size_t) (__builtin_clz(modulus[0] | 1u) - 24);
+    if (modulus[0] == 0 || bits < RSA_MIN_BITS || bits > RSA_MAX_BITS || !(modulus[modulusSize - 1] & 1)) {
+        LOGE("Unsupported RSA modulus of %zu bits", bits);
+        return -1;
+    }
+
+    if (exponentSize > 4) {
+        LOGE("Unsupported RSA public exponent");
+        return -1;
+    }
+
+    key.e = 0;
+    for (size_t i = 0; i < exponentSize; i++)
+        key.e = (key.e << 8) | exponent[i];
+
+    if (key.e < 3 || !(key.e & 1)) {
+        LOGE("Invalid RSA public exponent %u", key.e);
+        return -1;
+    }
+
+    key.modulusSize = modulusSize;
+    key.limbs = (modulusSize + 7) / 8;
+    bytesToLimbs(key.n, key.limbs, modulus, modulusSize);
+
+    // Newton's iteration doubles the correct low bits every step, n * n = 1 mod 8 to start with
+    uint64_t inv = key.n[0];
+    for (int i = 0; i < 5; i++)
+        inv *= 2 - key.n[0] * inv;
+    key.n0inv = (uint64_t) 0 - inv;
+
+    computeRR(key);
+    return 0;
+}
+
+// em = signature^e mod n, as many bytes as the modulus
+static int rsaPublic(const RsaPublicKey& key, const unsigned char* signature, size_t signatureSize, unsigned char* em) {
+    if (signatureSize != key.modulusSize) {
+        LOGE("RSA signature size (%zu) doesn't match the modulus (%zu)", signatureSize, key.modulusSize);
+        return -1;
+    }
+
+    const size_t k = key.limbs;
+    uint64_t s[RSA_MAX_LIMBS], a[RSA_MAX_LIMBS], x[RSA_MAX_LIMBS];
+    bytesToLimbs(s, k, signature, signatureSize);
+    if (compareLimbs(s, key.n, k) >= 0)
+        return -1;
+
+    // Into Montgomery form
+    montMul(a, s, key.rr, key);
+
+    if (key.e == 65537) {
+        // Nearly every key out there, 16 squarings and a multiplication
+        my_memcpy(x, a, k * sizeof(uint64_t));
+        for (int i = 0; i < 16; i++)
+            montMul(x, x, x, key);
+        montMul(x, x, a, key);
+    } else {
+        // Fixed 4-bit windows, from the most significant one down. The table only goes as far as the largest window
+        uint32_t largest = 0;
+        for (int shift = 0; shift < 32; shift += 4) {
+            uint32_t window = (key.e >> shift) & 0xf;
+            largest = window > largest ? window : largest;
+        }
+
+        uint64_t table[16][RSA_MAX_LIMBS];
+        my_memcpy(table[1], a, k * sizeof(uint64_t));
+        for (uint32_t w = 2; w <= largest; w++)
+            montMul(table[w], table[w - 1], a, key);
+
+        int shift = 28;
+        while (((key.e >> shift) & 0xf) == 0)
+            shift -= 4;
+
+        my_memcpy(x, table[(key.e >> shift) & 0xf], k * sizeof(uint64_t));
+
+        for (shift -= 4; shift >= 0; shift -= 4) {
+            for (int i = 0; i < 4; i++)
+                montMul(x, x, x, key);
+
+            uint32_t window = (key.e >> shift) & 0xf;
+            if (window)
+                montMul(x, x, table[window], key);
+        }
+    }
+
+    // Out of Montgomery form
+    uint64_t one[RSA_MAX_LIMBS];
+    my_memset(one, 0, k * sizeof(uint64_t));
+    one[0] = 1;
+    montMul(x, x, one, key);
+
+    limbsToBytes(em, key.modulusSize, x);
+    return 0;
+}
+
+// EM = 0x00 || 0x01 || PS (0xff...) || 0x00 || DigestInfo, rebuilt and compared as a whole
+int verifyRsaPkcs1Signature(const RsaPublicKey& key, RsaHashType type, const unsigned char* digest,
+                            const unsigned char* signature, size_t signatureSize) {
+    const unsigned char* prefix;
+    size_t prefixSize;
+    switch (type) {
+        case RSA_HASH_SHA1:
+            prefix = DIGEST_INFO_SHA1;
+            prefixSize = sizeof(DIGEST_INFO_SHA1);
+            break;
+        case RSA_HASH_SHA512:
+            prefix = DIGEST_INFO_SHA512;
+            prefixSize = sizeof(DIGEST_INFO_SHA512);
+            break;
+        default:
+            prefix = DIGEST_INFO_SHA256;
+            prefixSize = sizeof(DIGEST_INFO_SHA256);
+            break;
+    }
+
+    size_t digestSize = getRsaHashSize(type);
+    size_t emSize = key.modulusSize;
+    if (emSize < prefixSize + digestSize + 11)
+        return -1;
+
+    unsigned char em[RSA_MAX_BITS / 8], expected[RSA_MAX_BITS / 8];
+    if (rsaPublic(key, signature, signatureSize, em) < 0)
+        return -1;
+
+    size_t psEnd = emSize - prefixSize - digestSize - 1;
+    expected[0] = 0x00;
+    expected[1] = 0x01;
+    my_memset(expected + 2, 0xff, psEnd - 2);
+    expected[psEnd] = 0x00;
+    my_memcpy(expected + psEnd + 1, prefix, prefixSize);
+    my_memcpy(expected + psEnd + 1 + prefixSize, digest, digestSize);
+
+    return my_memcmp(em, expected, emSize) == 0 ? 0 : -1;
+}
+
+// mask ^= MGF1(seed) over size bytes
+static void applyMgf1(RsaHashType type, const unsigned char* seed, size_t seedSize, unsigned char* mask, size_t size) {
+    size_t hashSize = getRsaHashSize(type);
+    unsigned char block[SHA512_BYTES_SIZE];
+
+    for (uint32_t counter = 0; size > 0; counter++) {
+        unsigned char c[4] = {
+            (unsigned char) (counter >> 24), (unsigned char) (counter >> 16), (unsigned char) (counter >> 8), (unsigned char) counter };
+
+        RsaHash hash;
+        rsaHashInit(hash, type);
+        rsaHashAppend(hash, seed, seedSize);
+        rsaHashAppend(hash, c, sizeof(c));
+        rsaHashFinalize(hash, block);
+
+        size_t n = size < hashSize ? size : hashSize;
+        for (size_t i = 0; i < n; i++)
+            mask[i] ^= block[i];
+        mask += n;
+        size -= n;
+    }
+}
+
+// EMSA-PSS-VERIFY, RFC 8017 section 9.1.2
+int verifyRsaPssSignature(const RsaPublicKey& key, RsaHashType type, const unsigned char* digest,
+                          const unsigned char* signature, size_t signatureSize) {
+    unsigned char em[RSA_MAX_BITS / 8];
+    if (rsaPublic(key, signature, signatureSize, em) < 0)
+        return -1;
+
+    // emBits = modBits - 1, a whole leading byte is left out when that crosses a byte boundary
+    size_t modulusBits = key.modulusSize * 8 - (size_t) (__builtin_clzll(key.n[key.limbs - 1]) % 8);
+    size_t emBits = modulusBits - 1;
+    unsigned char* encoded = em;
+    size_t emSize = (emBits + 7) / 8;
+    if (emSize < key.modulusSize) {
+        if (em[0] != 0)
+            return -1;
+        encoded++;
+    }
+
+    size_t hashSize = getRsaHashSize(type);
+    size_t saltSize = hashSize;
+    if (emSize < hashSize + saltSize + 2 || encoded[emSize - 1] != 0xbc)
+        return -1;
+
+    unsigned char* db = encoded;
+    size_t dbSize = emSize - hashSize - 1;
+    const unsigned char* h = encoded + dbSize;
+
+    unsigned char topMask = (unsigned char) (0xff >> (8 * emSize - emBits));
+    if (db[0] & ~topMask)
+        return -1;
+
+    applyMgf1(type, h, hashSize, db, dbSize);
+    db[0] &= topMask;
+
+    // DB = PS (zeros) || 0x01 || salt
+    size_t psSize = dbSize - saltSize - 1;
+    for (size_t i = 0; i < psSize; i++) {
+        if (db[i] != 0)
+            return -1;
+    }
+    if (db[psSize] != 0x01)
+        return -1;
+
+    // H' = Hash(8 zero bytes || mHash || salt)
+    static const unsigned char zeros[8] = { 0 };
+    unsigned char expected[SHA512_BYTES_SIZE];
+    RsaHash hash;
+    rsaHashInit(hash, type);
+    rsaHashAppend(hash, zeros, sizeof(zeros));
+    rsaHashAppend(hash, digest, hashSize);
+    rsaHashAppend(hash, db + psSize + 1, saltSize);
+    rsaHashFinalize(hash, expected);
+
+    return my_memcmp(expected, h, hashSize) == 0 ? 0 : -1;
+}
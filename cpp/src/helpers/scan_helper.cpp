@@ -0,0 +1,85 @@
+// Backward pattern scanner for ZIP and APK Signing Block signatures
+
+#include "scan_helper.h"
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Positions checked at once, and how many mask bits each of them takes
+#if defined(__ARM_NEON)
+#define SCAN_BLOCK_SIZE 16
+#define SCAN_MASK_STRIDE 4
+#elif defined(__SSE2__)
+#define SCAN_BLOCK_SIZE 16
+#define SCAN_MASK_STRIDE 1
+#else
+#define SCAN_BLOCK_SIZE 8
+#define SCAN_MASK_STRIDE 8
+#endif
+
+// Bit SCAN_MASK_STRIDE * i is set when position block + i may start the pattern, meaning its first byte and the
+// byte lastOffset further match. Those are the two ends of the pattern, filler made of its leading bytes ("PKPK...")
+// then doesn't turn every position into a candidate. Reads up to block[lastOffset + SCAN_BLOCK_SIZE - 1]
+static inline uint64_t candidateMask(const unsigned char* block, unsigned char first, unsigned char last, size_t lastOffset) {
+#if defined(__ARM_NEON)
+    uint8x16_t eq = vandq_u8(vceqq_u8(vld1q_u8(block), vdupq_n_u8(first)),
+                             vceqq_u8(vld1q_u8(block + lastOffset), vdupq_n_u8(last)));
+
+    // No movemask on NEON, narrowing every byte to a nibble does the same job
+    uint64_t nibbles = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+    return nibbles & 0x1111111111111111ULL;
+#elif defined(__SSE2__)
+    __m128i eq = _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) block), _mm_set1_epi8((char) first)),
+                               _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) (block + lastOffset)), _mm_set1_epi8((char) last)));
+    return (uint64_t) (uint32_t) _mm_movemask_epi8(eq);
+#else
+    // Little-endian loads put position i in byte i whatever the CPU, compilers turn them into a single load
+    uint64_t lo = readLE64(block);
+    uint64_t hi = readLE64(block + lastOffset);
+
+    // Zero bytes of x are found with the usual (x - 0x01..) & ~x & 0x80.. trick. It never misses one but
+    // may also flag a byte above a real zero, which is fine since every candidate is compared in full.
+    // The flag sits in the top bit of each byte, so shift it down to bit 8 * i
+    uint64_t x = lo ^ (0x0101010101010101ULL * first);
+    uint64_t y = hi ^ (0x0101010101010101ULL * last);
+    uint64_t zeros = ((x - 0x0101010101010101ULL) & ~x) & ((y - 0x0101010101010101ULL) & ~y) & 0x8080808080808080ULL;
+    return zeros >> 7;
+#endif
+}
+
+const unsigned char* findLastPattern(const unsigned char* data, size_t size, const void* pattern, size_t patternLength) {
+    const unsigned char* p = (const unsigned char*) pattern;
+    if (patternLength < 2 || size < patternLength)
+        return NULL;
+
+    // Candidates are the positions in [0, end)
+    size_t end = size - patternLength + 1;
+
+    // A block also reads patternLength - 1 bytes past its last position, which are the end of the last candidate
+    const size_t lastOffset = patternLength - 1;
+    while (end >= SCAN_BLOCK_SIZE) {
+        size_t block = end - SCAN_BLOCK_SIZE;
+        uint64_t mask = candidateMask(data + block, p[0], p[lastOffset], lastOffset);
+
+        // Highest candidate first
+        while (mask) {
+            int bit = 63 - __builtin_clzll(mask);
+            size_t pos = block + bit / SCAN_MASK_STRIDE;
+            if (my_memcmp(data + pos, p, patternLength) == 0)
+                return data + pos;
+            mask &= ~(1ULL << bit);
+        }
+
+        end = block;
+    }
+
+    while (end-- > 0) {
+        if (data[end] == p[0] && my_memcmp(data + end + 1, p + 1, patternLength - 1) == 0)
+            return data + end;
+    }
+
+    return NULL;
+}
@@ -0,0 +1,161 @@
+// SHA-1 implementation following the same shape as sha256_helper, only needed for legacy v1 manifests
+
+#include "sha1_helper.h"
+
+#include "mylibc.h"
+
+static inline uint32_t rotl(uint32_t x, int n){
+    return (x << n) | (x >> (32 - n));
+}
+
+static void sha1_block(uint32_t *state, const uint8_t *data, size_t n_blocks){
+    while (n_blocks--){
+        uint32_t w[16];
+        int i;
+
+        for (i = 0; i < 16; i++){
+            w[i] =
+                ((uint32_t)data[0] << 24) |
+                ((uint32_t)data[1] << 16) |
+                ((uint32_t)data[2] <<  8) |
+                ((uint32_t)data[3]);
+            data += 4;
+        }
+
+        uint32_t a = state[0];
+        uint32_t b = state[1];
+        uint32_t c = state[2];
+        uint32_t d = state[3];
+        uint32_t e = state[4];
+
+        for (i = 0; i < 80; i++){
+            // The message schedule lives in a rolling window of 16 words
+            if (i >= 16){
+                w[i & 15] = rotl(w[(i + 13) & 15] ^ w[(i + 8) & 15] ^ w[(i + 2) & 15] ^ w[i & 15], 1);
+            }
+
+            uint32_t f, k;
+            if (i < 20){
+                f = (b & c) | ((~ b) & d);
+                k = 0x5a827999;
+            }else if (i < 40){
+                f = b ^ c ^ d;
+                k = 0x6ed9eba1;
+            }else if (i < 60){
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8f1bbcdc;
+            }else{
+                f = b ^ c ^ d;
+                k = 0xca62c1d6;
+            }
+
+            uint32_t t = rotl(a, 5) + f + e + k + w[i & 15];
+            e = d;
+            d = c;
+            c = rotl(b, 30);
+            b = a;
+            a = t;
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+    }
+}
+
+void sha1_init(struct sha1 *sha){
+    sha->state[0] = 0x67452301;
+    sha->state[1] = 0xefcdab89;
+    sha->state[2] = 0x98badcfe;
+    sha->state[3] = 0x10325476;
+    sha->state[4] = 0xc3d2e1f0;
+    sha->n_bits = 0;
+    sha->buffer_counter = 0;
+}
+
+void sha1_append(struct sha1 *sha, const void *src, size_t n_bytes){
+    const uint8_t *bytes = (const uint8_t*)src;
+
+    sha->n_bits += (uint64_t)n_bytes << 3;
+
+    // Top up a partially filled buffer first
+    if (sha->buffer_counter != 0){
+        size_t n = 64 - sha->buffer_counter;
+        if (n > n_bytes) n = n_bytes;
+
+        my_memcpy(sha->buffer + sha->buffer_counter, bytes, n);
+        sha->buffer_counter += n;
+        bytes += n;
+        n_bytes -= n;
+
+        if (sha->buffer_counter != 64){
+            return;
+        }
+
+        sha1_block(sha->state, sha->buffer, 1);
+        sha->buffer_counter = 0;
+    }
+
+    // Whole blocks are compressed straight from the input
+    size_t n_blocks = n_bytes / 64;
+    if (n_blocks != 0){
+        sha1_block(sha->state, bytes, n_blocks);
+        bytes += n_blocks * 64;
+        n_bytes -= n_blocks * 64;
+    }
+
+    // Only the tail gets staged
+    if (n_bytes != 0){
+        my_memcpy(sha->buffer, bytes, n_bytes);
+        sha->buffer_counter = (uint8_t)n_bytes;
+    }
+}
+
+void sha1_finalize(struct sha1 *sha){
+    int i;
+    uint64_t n_bits = sha->n_bits;
+    uint8_t *buffer = sha->buffer;
+    int counter = sha->buffer_counter;
+
+    buffer[counter++] = 0x80;
+
+    // Not enough room left for the length, pad out this block and start another one
+    if (counter > 56){
+        while (counter < 64) buffer[counter++] = 0;
+        sha1_block(sha->state, buffer, 1);
+        counter = 0;
+    }
+
+    while (counter < 56) buffer[counter++] = 0;
+
+    for (i = 7; i >= 0; i--){
+        buffer[counter++] = (n_bits >> 8 * i) & 0xff;
+    }
+
+    sha1_block(sha->state, buffer, 1);
+    sha->buffer_counter = 0;
+}
+
+void sha1_finalize_bytes(struct sha1 *sha, void *dst_bytes20){
+    uint8_t *ptr = (uint8_t*)dst_bytes20;
+    int i, j;
+    sha1_finalize(sha);
+
+    for (i = 0; i < 5; i++){
+        for (j = 3; j >= 0; j--){
+            *ptr++ = (sha->state[i] >> j * 8) & 0xff;
+        }
+    }
+}
+
+void sha1_bytes(const void *src, size_t n_bytes, void *dst_bytes20){
+    struct sha1 sha;
+
+    sha1_init(&sha);
+
+    sha1_append(&sha, src, n_bytes);
+
+    sha1_finalize_bytes(&sha, dst_bytes20);
+}
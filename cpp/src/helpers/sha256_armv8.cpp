@@ -0,0 +1,44 @@
+// SHA-256 compression with the ARMv8 Crypto Extensions, this file is built with -march=armv8-a+crypto
+// Based on the public domain intrinsics implementation by Jeffrey Walton : https://github.com/noloader/SHA-Intrinsics
+
+#include "sha256_helper.h"
+
+#if defined(__aarch64__)
+
+#include <arm_neon.h>
+
+void sha256_block_armv8(uint32_t *state, const uint8_t *data, size_t n_blocks){
+    uint32x4_t state0 = vld1q_u32(&state[0]); // ABCD
+    uint32x4_t state1 = vld1q_u32(&state[4]); // EFGH
+
+    for (; n_blocks > 0; n_blocks--, data += 64){
+        const uint32x4_t abcd_save = state0;
+        const uint32x4_t efgh_save = state1;
+
+        uint32x4_t w[4];
+        for (int i = 0; i < 4; i++){
+            w[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16 * i)));
+        }
+
+        // Each iteration runs 4 rounds and schedules the message words needed 4 iterations later
+        for (int i = 0; i < 16; i++){
+            const uint32x4_t msg = vaddq_u32(w[i & 3], vld1q_u32(&sha256_k[4 * i]));
+
+            if (i < 12){
+                w[i & 3] = vsha256su1q_u32(vsha256su0q_u32(w[i & 3], w[(i + 1) & 3]), w[(i + 2) & 3], w[(i + 3) & 3]);
+            }
+
+            const uint32x4_t abcd = state0;
+            state0 = vsha256hq_u32(state0, state1, msg);
+            state1 = vsha256h2q_u32(state1, abcd, msg);
+        }
+
+        state0 = vaddq_u32(state0, abcd_save);
+        state1 = vaddq_u32(state1, efgh_save);
+    }
+
+    vst1q_u32(&state[0], state0);
+    vst1q_u32(&state[4], state1);
+}
+
+#endif
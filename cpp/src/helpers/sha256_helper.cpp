@@ -2,6 +2,15 @@
 
 #include "sha256_helper.h"
 
+#include "mylibc.h"
+
+#if defined(__aarch64__)
+#include <sys/auxv.h> // For AT_HWCAP
+#include <asm/hwcap.h> // For HWCAP_SHA2
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h> // For __get_cpuid, no libc involved
+#endif
+
 static inline uint32_t rotr(uint32_t x, int n){
     return (x >> n) | (x << (32 - n));
 }
@@ -34,68 +43,101 @@ static inline void update_w(uint32_t *w, int i, const uint8_t *buffer){
     }
 }
 
-static void sha256_block(struct sha256 *sha){
-    uint32_t *state = sha->state;
-
-    static const uint32_t k[8 * 8] = {
-        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
-        0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
-        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
-        0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
-        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
-        0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
-        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
-        0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
-        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
-        0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
-        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
-        0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
-        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
-        0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
-        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
-        0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
-    };
-
-    uint32_t a = state[0];
-    uint32_t b = state[1];
-    uint32_t c = state[2];
-    uint32_t d = state[3];
-    uint32_t e = state[4];
-    uint32_t f = state[5];
-    uint32_t g = state[6];
-    uint32_t h = state[7];
-
-    uint32_t w[16];
-
-    int i, j;
-    for (i = 0; i < 64; i += 16){
-        update_w(w, i, sha->buffer);
-
-        for (j = 0; j < 16; j += 4){
-            uint32_t temp;
-            temp = h + step1(e, f, g) + k[i + j + 0] + w[j + 0];
-            h = temp + d;
-            d = temp + step2(a, b, c);
-            temp = g + step1(h, e, f) + k[i + j + 1] + w[j + 1];
-            g = temp + c;
-            c = temp + step2(d, a, b);
-            temp = f + step1(g, h, e) + k[i + j + 2] + w[j + 2];
-            f = temp + b;
-            b = temp + step2(c, d, a);
-            temp = e + step1(f, g, h) + k[i + j + 3] + w[j + 3];
-            e = temp + a;
-            a = temp + step2(b, c, d);
+const uint32_t sha256_k[8 * 8] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+// Portable compression function, compresses n_blocks consecutive 64-byte blocks of data into state
+void sha256_block_scalar(uint32_t *state, const uint8_t *data, size_t n_blocks){
+    for (; n_blocks > 0; n_blocks--, data += 64){
+        uint32_t a = state[0];
+        uint32_t b = state[1];
+        uint32_t c = state[2];
+        uint32_t d = state[3];
+        uint32_t e = state[4];
+        uint32_t f = state[5];
+        uint32_t g = state[6];
+        uint32_t h = state[7];
+
+        uint32_t w[16];
+
+        int i, j;
+        for (i = 0; i < 64; i += 16){
+            update_w(w, i, data);
+
+            for (j = 0; j < 16; j += 4){
+                uint32_t temp;
+                temp = h + step1(e, f, g) + sha256_k[i + j + 0] + w[j + 0];
+                h = temp + d;
+                d = temp + step2(a, b, c);
+                temp = g + step1(h, e, f) + sha256_k[i + j + 1] + w[j + 1];
+                g = temp + c;
+                c = temp + step2(d, a, b);
+                temp = f + step1(g, h, e) + sha256_k[i + j + 2] + w[j + 2];
+                f = temp + b;
+                b = temp + step2(c, d, a);
+                temp = e + step1(f, g, h) + sha256_k[i + j + 3] + w[j + 3];
+                e = temp + a;
+                a = temp + step2(b, c, d);
+            }
         }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+}
+
+static sha256_block_fn selected_block_fn = NULL;
+
+// Pick the fastest compression kernel this CPU supports, the portable one being the fallback
+static sha256_block_fn sha256_select_block_fn(){
+#if defined(__aarch64__)
+    if (my_getauxval(AT_HWCAP) & HWCAP_SHA2){
+        return sha256_block_armv8;
     }
+#elif defined(__x86_64__) || defined(__i386__)
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_SSSE3) && (ecx & bit_SSE4_1)
+        && __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & bit_SHA)){
+        return sha256_block_shani;
+    }
+#endif
+    return sha256_block_scalar;
+}
+
+sha256_block_fn sha256_get_block_fn(){
+    sha256_block_fn fn = __atomic_load_n(&selected_block_fn, __ATOMIC_ACQUIRE);
+    if (fn == NULL){
+        // Racing threads all pick the same kernel so publishing it twice is harmless
+        fn = sha256_select_block_fn();
+        __atomic_store_n(&selected_block_fn, fn, __ATOMIC_RELEASE);
+    }
+    return fn;
+}
 
-    state[0] += a;
-    state[1] += b;
-    state[2] += c;
-    state[3] += d;
-    state[4] += e;
-    state[5] += f;
-    state[6] += g;
-    state[7] += h;
+static inline void sha256_block(uint32_t *state, const uint8_t *data, size_t n_blocks){
+    sha256_get_block_fn()(state, data, n_blocks);
 }
 
 void sha256_init(struct sha256 *sha){
@@ -117,33 +159,71 @@ void sha256_append_byte(struct sha256 *sha, uint8_t byte){
 
     if (sha->buffer_counter == 64){
         sha->buffer_counter = 0;
-        sha256_block(sha);
+        sha256_block(sha->state, sha->buffer, 1);
     }
 }
 
 void sha256_append(struct sha256 *sha, const void *src, size_t n_bytes){
     const uint8_t *bytes = (const uint8_t*)src;
-    size_t i;
 
-    for (i = 0; i < n_bytes; i++){
-        sha256_append_byte(sha, bytes[i]);
+    sha->n_bits += (uint64_t)n_bytes << 3;
+
+    // Top up a partially filled buffer first
+    if (sha->buffer_counter != 0){
+        size_t n = 64 - sha->buffer_counter;
+        if (n > n_bytes) n = n_bytes;
+
+        my_memcpy(sha->buffer + sha->buffer_counter, bytes, n);
+        sha->buffer_counter += n;
+        bytes += n;
+        n_bytes -= n;
+
+        if (sha->buffer_counter != 64){
+            return;
+        }
+
+        sha256_block(sha->state, sha->buffer, 1);
+        sha->buffer_counter = 0;
+    }
+
+    // Whole blocks are compressed straight from the input
+    size_t n_blocks = n_bytes / 64;
+    if (n_blocks != 0){
+        sha256_block(sha->state, bytes, n_blocks);
+        bytes += n_blocks * 64;
+        n_bytes -= n_blocks * 64;
+    }
+
+    // Only the tail gets staged
+    if (n_bytes != 0){
+        my_memcpy(sha->buffer, bytes, n_bytes);
+        sha->buffer_counter = (uint8_t)n_bytes;
     }
 }
 
 void sha256_finalize(struct sha256 *sha){
     int i;
     uint64_t n_bits = sha->n_bits;
+    uint8_t *buffer = sha->buffer;
+    int counter = sha->buffer_counter;
 
-    sha256_append_byte(sha, 0x80);
+    buffer[counter++] = 0x80;
 
-    while (sha->buffer_counter != 56){
-        sha256_append_byte(sha, 0);
+    // Not enough room left for the length, pad out this block and start another one
+    if (counter > 56){
+        while (counter < 64) buffer[counter++] = 0;
+        sha256_block(sha->state, buffer, 1);
+        counter = 0;
     }
 
+    while (counter < 56) buffer[counter++] = 0;
+
     for (i = 7; i >= 0; i--){
-        uint8_t byte = (n_bits >> 8 * i) & 0xff;
-        sha256_append_byte(sha, byte);
+        buffer[counter++] = (n_bits >> 8 * i) & 0xff;
     }
+
+    sha256_block(sha->state, buffer, 1);
+    sha->buffer_counter = 0;
 }
 
 void sha256_finalize_hex(struct sha256 *sha, char *dst_hex65){
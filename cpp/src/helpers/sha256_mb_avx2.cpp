@@ -0,0 +1,116 @@
+// 8-lane SHA-256 compression with AVX2, this file is built with -mavx2
+
+#include "sha256_mb_helper.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+
+#define ROTR(x, n) _mm256_or_si256(_mm256_srli_epi32((x), (n)), _mm256_slli_epi32((x), 32 - (n)))
+
+static inline __m256i sigma0(__m256i x){
+    return _mm256_xor_si256(_mm256_xor_si256(ROTR(x, 7), ROTR(x, 18)), _mm256_srli_epi32(x, 3));
+}
+
+static inline __m256i sigma1(__m256i x){
+    return _mm256_xor_si256(_mm256_xor_si256(ROTR(x, 17), ROTR(x, 19)), _mm256_srli_epi32(x, 10));
+}
+
+// Load 8 big-endian words from every lane and transpose them so that w[j] holds word j of all 8 lanes
+static inline void load_words(__m256i *w, const uint8_t *const *p, size_t offset){
+    const __m256i byteswap = _mm256_set_epi8(
+        12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+        12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+
+    __m256i r[8], t[8];
+    for (int i = 0; i < 8; i++){
+        r[i] = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *) (p[i] + offset)), byteswap);
+    }
+
+    t[0] = _mm256_unpacklo_epi32(r[0], r[1]);
+    t[1] = _mm256_unpackhi_epi32(r[0], r[1]);
+    t[2] = _mm256_unpacklo_epi32(r[2], r[3]);
+    t[3] = _mm256_unpackhi_epi32(r[2], r[3]);
+    t[4] = _mm256_unpacklo_epi32(r[4], r[5]);
+    t[5] = _mm256_unpackhi_epi32(r[4], r[5]);
+    t[6] = _mm256_unpacklo_epi32(r[6], r[7]);
+    t[7] = _mm256_unpackhi_epi32(r[6], r[7]);
+
+    r[0] = _mm256_unpacklo_epi64(t[0], t[2]);
+    r[1] = _mm256_unpackhi_epi64(t[0], t[2]);
+    r[2] = _mm256_unpacklo_epi64(t[1], t[3]);
+    r[3] = _mm256_unpackhi_epi64(t[1], t[3]);
+    r[4] = _mm256_unpacklo_epi64(t[4], t[6]);
+    r[5] = _mm256_unpackhi_epi64(t[4], t[6]);
+    r[6] = _mm256_unpacklo_epi64(t[5], t[7]);
+    r[7] = _mm256_unpackhi_epi64(t[5], t[7]);
+
+    for (int i = 0; i < 4; i++){
+        w[i] = _mm256_permute2x128_si256(r[i], r[i + 4], 0x20);
+        w[i + 4] = _mm256_permute2x128_si256(r[i], r[i + 4], 0x31);
+    }
+}
+
+void sha256_mb_block_avx2(uint32_t *const *states, const uint8_t *const *data, size_t n_blocks){
+    __m256i s[8];
+    for (int j = 0; j < 8; j++){
+        s[j] = _mm256_set_epi32(
+            (int) states[7][j], (int) states[6][j], (int) states[5][j], (int) states[4][j],
+            (int) states[3][j], (int) states[2][j], (int) states[1][j], (int) states[0][j]);
+    }
+
+    for (size_t block = 0; block < n_blocks; block++){
+        __m256i w[16];
+        load_words(w, data, block * 64);
+        load_words(w + 8, data, block * 64 + 32);
+
+        __m256i a = s[0], b = s[1], c = s[2], d = s[3];
+        __m256i e = s[4], f = s[5], g = s[6], h = s[7];
+
+        for (int i = 0; i < 64; i++){
+            if (i >= 16){
+                w[i & 15] = _mm256_add_epi32(
+                    _mm256_add_epi32(w[i & 15], sigma0(w[(i + 1) & 15])),
+                    _mm256_add_epi32(w[(i + 9) & 15], sigma1(w[(i + 14) & 15])));
+            }
+
+            __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(ROTR(e, 6), ROTR(e, 11)), ROTR(e, 25));
+            __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+            __m256i t1 = _mm256_add_epi32(
+                _mm256_add_epi32(_mm256_add_epi32(h, s1), _mm256_add_epi32(ch, w[i & 15])),
+                _mm256_set1_epi32((int) sha256_k[i]));
+
+            __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(ROTR(a, 2), ROTR(a, 13)), ROTR(a, 22));
+            __m256i maj = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+            __m256i t2 = _mm256_add_epi32(s0, maj);
+
+            h = g;
+            g = f;
+            f = e;
+            e = _mm256_add_epi32(d, t1);
+            d = c;
+            c = b;
+            b = a;
+            a = _mm256_add_epi32(t1, t2);
+        }
+
+        s[0] = _mm256_add_epi32(s[0], a);
+        s[1] = _mm256_add_epi32(s[1], b);
+        s[2] = _mm256_add_epi32(s[2], c);
+        s[3] = _mm256_add_epi32(s[3], d);
+        s[4] = _mm256_add_epi32(s[4], e);
+        s[5] = _mm256_add_epi32(s[5], f);
+        s[6] = _mm256_add_epi32(s[6], g);
+        s[7] = _mm256_add_epi32(s[7], h);
+    }
+
+    for (int j = 0; j < 8; j++){
+        uint32_t lanes[8];
+        _mm256_storeu_si256((__m256i *) lanes, s[j]);
+        for (int i = 0; i < 8; i++){
+            states[i][j] = lanes[i];
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,245 @@
+// Multi-buffer SHA-256 : independent messages are hashed side by side, one message per SIMD lane
+
+#include "sha256_mb_helper.h"
+
+#include "mylibc.h"
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h> // For __get_cpuid, no libc involved
+#endif
+
+#if defined(__ARM_NEON)
+
+#define ROTR(x, n) vsriq_n_u32(vshlq_n_u32((x), 32 - (n)), (x), (n))
+
+// Load 4 big-endian words from every lane and transpose them so that w[j] holds word j of all 4 lanes
+static inline void load_words(uint32x4_t *w, const uint8_t *const *p, size_t offset){
+    uint32x4_t r[4];
+    for (int i = 0; i < 4; i++){
+        r[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(p[i] + offset)));
+    }
+
+    uint32x4x2_t t0 = vtrnq_u32(r[0], r[1]);
+    uint32x4x2_t t1 = vtrnq_u32(r[2], r[3]);
+
+    w[0] = vcombine_u32(vget_low_u32(t0.val[0]), vget_low_u32(t1.val[0]));
+    w[1] = vcombine_u32(vget_low_u32(t0.val[1]), vget_low_u32(t1.val[1]));
+    w[2] = vcombine_u32(vget_high_u32(t0.val[0]), vget_high_u32(t1.val[0]));
+    w[3] = vcombine_u32(vget_high_u32(t0.val[1]), vget_high_u32(t1.val[1]));
+}
+
+void sha256_mb_block_neon(uint32_t *const *states, const uint8_t *const *data, size_t n_blocks){
+    uint32x4_t s[8];
+    for (int j = 0; j < 8; j++){
+        const uint32_t lanes[4] = { states[0][j], states[1][j], states[2][j], states[3][j] };
+        s[j] = vld1q_u32(lanes);
+    }
+
+    for (size_t block = 0; block < n_blocks; block++){
+        uint32x4_t w[16];
+        for (int j = 0; j < 4; j++){
+            load_words(w + 4 * j, data, block * 64 + 16 * j);
+        }
+
+        uint32x4_t a = s[0], b = s[1], c = s[2], d = s[3];
+        uint32x4_t e = s[4], f = s[5], g = s[6], h = s[7];
+
+        for (int i = 0; i < 64; i++){
+            if (i >= 16){
+                uint32x4_t w1 = w[(i + 1) & 15];
+                uint32x4_t w14 = w[(i + 14) & 15];
+                uint32x4_t s0 = veorq_u32(veorq_u32(ROTR(w1, 7), ROTR(w1, 18)), vshrq_n_u32(w1, 3));
+                uint32x4_t s1 = veorq_u32(veorq_u32(ROTR(w14, 17), ROTR(w14, 19)), vshrq_n_u32(w14, 10));
+                w[i & 15] = vaddq_u32(vaddq_u32(w[i & 15], s0), vaddq_u32(w[(i + 9) & 15], s1));
+            }
+
+            uint32x4_t s1 = veorq_u32(veorq_u32(ROTR(e, 6), ROTR(e, 11)), ROTR(e, 25));
+            uint32x4_t ch = vbslq_u32(e, f, g);
+            uint32x4_t t1 = vaddq_u32(vaddq_u32(vaddq_u32(h, s1), vaddq_u32(ch, w[i & 15])), vdupq_n_u32(sha256_k[i]));
+
+            uint32x4_t s0 = veorq_u32(veorq_u32(ROTR(a, 2), ROTR(a, 13)), ROTR(a, 22));
+            uint32x4_t maj = vbslq_u32(veorq_u32(a, b), c, b);
+            uint32x4_t t2 = vaddq_u32(s0, maj);
+
+            h = g;
+            g = f;
+            f = e;
+            e = vaddq_u32(d, t1);
+            d = c;
+            c = b;
+            b = a;
+            a = vaddq_u32(t1, t2);
+        }
+
+        s[0] = vaddq_u32(s[0], a);
+        s[1] = vaddq_u32(s[1], b);
+        s[2] = vaddq_u32(s[2], c);
+        s[3] = vaddq_u32(s[3], d);
+        s[4] = vaddq_u32(s[4], e);
+        s[5] = vaddq_u32(s[5], f);
+        s[6] = vaddq_u32(s[6], g);
+        s[7] = vaddq_u32(s[7], h);
+    }
+
+    for (int j = 0; j < 8; j++){
+        uint32_t lanes[4];
+        vst1q_u32(lanes, s[j]);
+        for (int i = 0; i < 4; i++){
+            states[i][j] = lanes[i];
+        }
+    }
+}
+
+#endif
+
+typedef struct sha256_mb_engine {
+    sha256_mb_block_fn block_fn;
+    size_t lanes;
+} sha256_mb_engine;
+
+static sha256_mb_engine selected_engine = { NULL, 0 };
+
+#if defined(__x86_64__) || defined(__i386__)
+// AVX2 needs both the CPU flag and the OS saving the YMM registers on context switches
+static bool cpu_has_avx2(){
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_OSXSAVE) || !(ecx & bit_AVX)){
+        return false;
+    }
+
+    unsigned int xcr0_lo, xcr0_hi;
+    __asm__ volatile("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+    if ((xcr0_lo & 0x6) != 0x6){
+        return false;
+    }
+
+    return __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & bit_AVX2);
+}
+#endif
+
+/*
+ * A dedicated SHA instruction retires a round far faster than any number of lanes of plain SIMD
+ * arithmetic, so when the CPU has one every message simply goes through sha256_append and the
+ * multi-lane kernels are only used on CPUs without SHA extensions.
+ */
+static sha256_mb_engine sha256_mb_select_engine(){
+    sha256_mb_engine engine = { NULL, 1 };
+
+    if (sha256_get_block_fn() != sha256_block_scalar){
+        return engine;
+    }
+
+#if defined(__ARM_NEON)
+    engine.block_fn = sha256_mb_block_neon;
+    engine.lanes = 4;
+#elif defined(__x86_64__) || defined(__i386__)
+    if (cpu_has_avx2()){
+        engine.block_fn = sha256_mb_block_avx2;
+        engine.lanes = 8;
+    }
+#endif
+
+    return engine;
+}
+
+static sha256_mb_engine sha256_mb_get_engine(){
+    if (__atomic_load_n(&selected_engine.lanes, __ATOMIC_ACQUIRE) == 0){
+        // Racing threads all pick the same engine so publishing it twice is harmless
+        sha256_mb_engine engine = sha256_mb_select_engine();
+        selected_engine.block_fn = engine.block_fn;
+        __atomic_store_n(&selected_engine.lanes, engine.lanes, __ATOMIC_RELEASE);
+    }
+    return selected_engine;
+}
+
+// Advance up to engine.lanes messages, the longest common run of whole blocks goes through the multi-lane kernel
+static void sha256_mb_append_group(const sha256_mb_engine *engine, struct sha256 *shas, const sha256_span *spans, size_t count){
+    const uint8_t *data[SHA256_MB_MAX_LANES] = {};
+    size_t remaining[SHA256_MB_MAX_LANES];
+    uint32_t *states[SHA256_MB_MAX_LANES] = {};
+    size_t n_blocks = SIZE_MAX;
+
+    for (size_t i = 0; i < count; i++){
+        data[i] = (const uint8_t *) spans[i].data;
+        remaining[i] = spans[i].n_bytes;
+
+        // Flush whatever is staged in the buffer so that the lane starts on a block boundary
+        if (shas[i].buffer_counter != 0){
+            size_t n = 64 - shas[i].buffer_counter;
+            if (n > remaining[i]) n = remaining[i];
+
+            sha256_append(&shas[i], data[i], n);
+            data[i] += n;
+            remaining[i] -= n;
+        }
+
+        states[i] = shas[i].state;
+        if (remaining[i] / 64 < n_blocks){
+            n_blocks = remaining[i] / 64;
+        }
+    }
+
+    if (n_blocks != 0){
+        // Unused lanes hash a copy of lane 0 into a scratch state
+        uint32_t scratch[SHA256_MB_MAX_LANES][8];
+        for (size_t i = count; i < engine->lanes; i++){
+            my_memcpy(scratch[i], shas[0].state, sizeof(scratch[i]));
+            states[i] = scratch[i];
+            data[i] = data[0];
+        }
+
+        engine->block_fn(states, data, n_blocks);
+
+        for (size_t i = 0; i < count; i++){
+            shas[i].n_bits += (uint64_t) n_blocks * 512;
+            data[i] += n_blocks * 64;
+            remaining[i] -= n_blocks * 64;
+        }
+    }
+
+    for (size_t i = 0; i < count; i++){
+        sha256_append(&shas[i], data[i], remaining[i]);
+    }
+}
+
+size_t sha256_mb_lanes(){
+    return sha256_mb_get_engine().lanes;
+}
+
+void sha256_mb_append(struct sha256 *shas, const sha256_span *spans, size_t count){
+    sha256_mb_engine engine = sha256_mb_get_engine();
+
+    size_t i = 0;
+    if (engine.block_fn != NULL){
+        // A group needs at least two messages for the extra lanes to pay off
+        while (count - i >= 2){
+            size_t n = count - i < engine.lanes ? count - i : engine.lanes;
+            sha256_mb_append_group(&engine, shas + i, spans + i, n);
+            i += n;
+        }
+    }
+
+    for (; i < count; i++){
+        sha256_append(&shas[i], spans[i].data, spans[i].n_bytes);
+    }
+}
+
+void sha256_mb_bytes(const sha256_span *spans, size_t count, uint8_t (*dst_bytes32)[SHA256_BYTES_SIZE]){
+    struct sha256 shas[SHA256_MB_MAX_LANES];
+
+    for (size_t i = 0; i < count; i += SHA256_MB_MAX_LANES){
+        size_t n = count - i < SHA256_MB_MAX_LANES ? count - i : SHA256_MB_MAX_LANES;
+
+        for (size_t j = 0; j < n; j++){
+            sha256_init(&shas[j]);
+        }
+
+        sha256_mb_append(shas, spans + i, n);
+
+        for (size_t j = 0; j < n; j++){
+            sha256_finalize_bytes(&shas[j], dst_bytes32[i + j]);
+        }
+    }
+}
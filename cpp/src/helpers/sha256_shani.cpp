@@ -0,0 +1,58 @@
+// SHA-256 compression with the Intel SHA extensions, this file is built with -msha -msse4.1
+// Based on the public domain intrinsics implementation by Jeffrey Walton : https://github.com/noloader/SHA-Intrinsics
+
+#include "sha256_helper.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+
+void sha256_block_shani(uint32_t *state, const uint8_t *data, size_t n_blocks){
+    const __m128i byteswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    // Load initial values, the SHA-NI instructions want them as ABEF and CDGH
+    __m128i tmp = _mm_loadu_si128((const __m128i *) &state[0]);
+    __m128i state1 = _mm_loadu_si128((const __m128i *) &state[4]);
+
+    tmp = _mm_shuffle_epi32(tmp, 0xB1);           // CDAB
+    state1 = _mm_shuffle_epi32(state1, 0x1B);     // EFGH
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8); // ABEF
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);  // CDGH
+
+    for (; n_blocks > 0; n_blocks--, data += 64){
+        const __m128i abef_save = state0;
+        const __m128i cdgh_save = state1;
+
+        __m128i w[4];
+        for (int i = 0; i < 4; i++){
+            w[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (data + 16 * i)), byteswap);
+        }
+
+        // Each iteration runs 4 rounds and schedules the message words needed 4 iterations later
+        for (int i = 0; i < 16; i++){
+            __m128i msg = _mm_add_epi32(w[i & 3], _mm_loadu_si128((const __m128i *) &sha256_k[4 * i]));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(msg, 0x0E));
+
+            if (i < 12){
+                __m128i next = _mm_sha256msg1_epu32(w[i & 3], w[(i + 1) & 3]);
+                next = _mm_add_epi32(next, _mm_alignr_epi8(w[(i + 3) & 3], w[(i + 2) & 3], 4));
+                w[i & 3] = _mm_sha256msg2_epu32(next, w[(i + 3) & 3]);
+            }
+        }
+
+        state0 = _mm_add_epi32(state0, abef_save);
+        state1 = _mm_add_epi32(state1, cdgh_save);
+    }
+
+    // Back to ABCD and EFGH
+    tmp = _mm_shuffle_epi32(state0, 0x1B);        // FEBA
+    state1 = _mm_shuffle_epi32(state1, 0xB1);     // DCHG
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);  // DCBA
+    state1 = _mm_alignr_epi8(state1, tmp, 8);     // ABEF
+
+    _mm_storeu_si128((__m128i *) &state[0], state0);
+    _mm_storeu_si128((__m128i *) &state[4], state1);
+}
+
+#endif
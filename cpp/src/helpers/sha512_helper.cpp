@@ -0,0 +1,287 @@
+// SHA-512 implementation following the same shape as sha256_helper
+
+#include "sha512_helper.h"
+
+#include "mylibc.h"
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static const uint64_t sha512_k[80] = {
+    0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+    0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL, 0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+    0xd807aa98a3030242ULL, 0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+    0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+    0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL, 0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+    0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+    0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+    0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL, 0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+    0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+    0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+    0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL, 0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+    0xd192e819d6ef5218ULL, 0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+    0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+    0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL, 0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+    0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+    0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+    0xca273eceea26619cULL, 0xd186b8c721c0c207ULL, 0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+    0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+    0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+    0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL, 0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL,
+};
+
+static inline uint64_t rotr(uint64_t x, int n){
+    return (x >> n) | (x << (64 - n));
+}
+
+static inline uint64_t step1(uint64_t e, uint64_t f, uint64_t g){
+    return (rotr(e, 14) ^ rotr(e, 18) ^ rotr(e, 41)) + ((e & f) ^ ((~ e) & g));
+}
+
+static inline uint64_t step2(uint64_t a, uint64_t b, uint64_t c){
+    return (rotr(a, 28) ^ rotr(a, 34) ^ rotr(a, 39)) + ((a & b) ^ (a & c) ^ (b & c));
+}
+
+static inline uint64_t load_be64(const uint8_t *p){
+    return ((uint64_t)p[0] << 56) | ((uint64_t)p[1] << 48) |
+           ((uint64_t)p[2] << 40) | ((uint64_t)p[3] << 32) |
+           ((uint64_t)p[4] << 24) | ((uint64_t)p[5] << 16) |
+           ((uint64_t)p[6] <<  8) | ((uint64_t)p[7]);
+}
+
+/*
+ * Expand the whole 80-word message schedule up front. W[t] only depends on words at least two
+ * positions back, so W[t] and W[t + 1] are computed together in the two 64-bit lanes of a vector.
+ */
+static inline void expand_w(uint64_t *w, const uint8_t *block){
+    int t;
+    for (t = 0; t < 16; t++){
+        w[t] = load_be64(block + 8 * t);
+    }
+
+#if defined(__ARM_NEON)
+    for (t = 16; t < 80; t += 2){
+        uint64x2_t x2 = vld1q_u64(w + t - 2);
+        uint64x2_t x15 = vld1q_u64(w + t - 15);
+
+        uint64x2_t s1 = veorq_u64(veorq_u64(
+            vsriq_n_u64(vshlq_n_u64(x2, 45), x2, 19),
+            vsriq_n_u64(vshlq_n_u64(x2, 3), x2, 61)),
+            vshrq_n_u64(x2, 6));
+        uint64x2_t s0 = veorq_u64(veorq_u64(
+            vsriq_n_u64(vshlq_n_u64(x15, 63), x15, 1),
+            vsriq_n_u64(vshlq_n_u64(x15, 56), x15, 8)),
+            vshrq_n_u64(x15, 7));
+
+        uint64x2_t sum = vaddq_u64(vaddq_u64(s1, vld1q_u64(w + t - 7)), vaddq_u64(s0, vld1q_u64(w + t - 16)));
+        vst1q_u64(w + t, sum);
+    }
+#elif defined(__SSE2__)
+    for (t = 16; t < 80; t += 2){
+        __m128i x2 = _mm_loadu_si128((const __m128i *) (w + t - 2));
+        __m128i x15 = _mm_loadu_si128((const __m128i *) (w + t - 15));
+
+        __m128i s1 = _mm_xor_si128(_mm_xor_si128(
+            _mm_or_si128(_mm_srli_epi64(x2, 19), _mm_slli_epi64(x2, 45)),
+            _mm_or_si128(_mm_srli_epi64(x2, 61), _mm_slli_epi64(x2, 3))),
+            _mm_srli_epi64(x2, 6));
+        __m128i s0 = _mm_xor_si128(_mm_xor_si128(
+            _mm_or_si128(_mm_srli_epi64(x15, 1), _mm_slli_epi64(x15, 63)),
+            _mm_or_si128(_mm_srli_epi64(x15, 8), _mm_slli_epi64(x15, 56))),
+            _mm_srli_epi64(x15, 7));
+
+        __m128i sum = _mm_add_epi64(
+            _mm_add_epi64(s1, _mm_loadu_si128((const __m128i *) (w + t - 7))),
+            _mm_add_epi64(s0, _mm_loadu_si128((const __m128i *) (w + t - 16))));
+        _mm_storeu_si128((__m128i *) (w + t), sum);
+    }
+#else
+    for (t = 16; t < 80; t++){
+        uint64_t a = w[t - 15];
+        uint64_t b = w[t - 2];
+        uint64_t s0 = (rotr(a,  1) ^ rotr(a,  8) ^ (a >> 7));
+        uint64_t s1 = (rotr(b, 19) ^ rotr(b, 61) ^ (b >> 6));
+        w[t] = w[t - 16] + s0 + w[t - 7] + s1;
+    }
+#endif
+}
+
+// Compress n_blocks consecutive 128-byte blocks of data into state
+static void sha512_block(uint64_t *state, const uint8_t *data, size_t n_blocks){
+    uint64_t w[80];
+
+    for (; n_blocks > 0; n_blocks--, data += 128){
+        expand_w(w, data);
+
+        uint64_t a = state[0];
+        uint64_t b = state[1];
+        uint64_t c = state[2];
+        uint64_t d = state[3];
+        uint64_t e = state[4];
+        uint64_t f = state[5];
+        uint64_t g = state[6];
+        uint64_t h = state[7];
+
+        int i;
+        for (i = 0; i < 80; i += 4){
+            uint64_t temp;
+            temp = h + step1(e, f, g) + sha512_k[i + 0] + w[i + 0];
+            h = temp + d;
+            d = temp + step2(a, b, c);
+            temp = g + step1(h, e, f) + sha512_k[i + 1] + w[i + 1];
+            g = temp + c;
+            c = temp + step2(d, a, b);
+            temp = f + step1(g, h, e) + sha512_k[i + 2] + w[i + 2];
+            f = temp + b;
+            b = temp + step2(c, d, a);
+            temp = e + step1(f, g, h) + sha512_k[i + 3] + w[i + 3];
+            e = temp + a;
+            a = temp + step2(b, c, d);
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+}
+
+void sha512_init(struct sha512 *sha){
+    sha->state[0] = 0x6a09e667f3bcc908ULL;
+    sha->state[1] = 0xbb67ae8584caa73bULL;
+    sha->state[2] = 0x3c6ef372fe94f82bULL;
+    sha->state[3] = 0xa54ff53a5f1d36f1ULL;
+    sha->state[4] = 0x510e527fade682d1ULL;
+    sha->state[5] = 0x9b05688c2b3e6c1fULL;
+    sha->state[6] = 0x1f83d9abfb41bd6bULL;
+    sha->state[7] = 0x5be0cd19137e2179ULL;
+    sha->n_bits = 0;
+    sha->buffer_counter = 0;
+}
+
+void sha512_append_byte(struct sha512 *sha, uint8_t byte){
+    sha->buffer[sha->buffer_counter++] = byte;
+    sha->n_bits += 8;
+
+    if (sha->buffer_counter == 128){
+        sha->buffer_counter = 0;
+        sha512_block(sha->state, sha->buffer, 1);
+    }
+}
+
+void sha512_append(struct sha512 *sha, const void *src, size_t n_bytes){
+    const uint8_t *bytes = (const uint8_t*)src;
+
+    sha->n_bits += (uint64_t)n_bytes << 3;
+
+    // Top up a partially filled buffer first
+    if (sha->buffer_counter != 0){
+        size_t n = 128 - sha->buffer_counter;
+        if (n > n_bytes) n = n_bytes;
+
+        my_memcpy(sha->buffer + sha->buffer_counter, bytes, n);
+        sha->buffer_counter += n;
+        bytes += n;
+        n_bytes -= n;
+
+        if (sha->buffer_counter != 128){
+            return;
+        }
+
+        sha512_block(sha->state, sha->buffer, 1);
+        sha->buffer_counter = 0;
+    }
+
+    // Whole blocks are compressed straight from the input
+    size_t n_blocks = n_bytes / 128;
+    if (n_blocks != 0){
+        sha512_block(sha->state, bytes, n_blocks);
+        bytes += n_blocks * 128;
+        n_bytes -= n_blocks * 128;
+    }
+
+    // Only the tail gets staged
+    if (n_bytes != 0){
+        my_memcpy(sha->buffer, bytes, n_bytes);
+        sha->buffer_counter = (uint8_t)n_bytes;
+    }
+}
+
+void sha512_finalize(struct sha512 *sha){
+    int i;
+    uint64_t n_bits = sha->n_bits;
+    uint8_t *buffer = sha->buffer;
+    int counter = sha->buffer_counter;
+
+    buffer[counter++] = 0x80;
+
+    // Not enough room left for the 128-bit length, pad out this block and start another one
+    if (counter > 112){
+        while (counter < 128) buffer[counter++] = 0;
+        sha512_block(sha->state, buffer, 1);
+        counter = 0;
+    }
+
+    // Upper 64 bits of the length are always 0 since n_bits is 64 bits wide
+    while (counter < 120) buffer[counter++] = 0;
+
+    for (i = 7; i >= 0; i--){
+        buffer[counter++] = (n_bits >> 8 * i) & 0xff;
+    }
+
+    sha512_block(sha->state, buffer, 1);
+    sha->buffer_counter = 0;
+}
+
+void sha512_finalize_hex(struct sha512 *sha, char *dst_hex129){
+    int i, j;
+    sha512_finalize(sha);
+
+    for (i = 0; i < 8; i++){
+        for (j = 15; j >= 0; j--){
+            uint8_t nibble = (sha->state[i] >> j * 4) & 0xf;
+            *dst_hex129++ = "0123456789abcdef"[nibble];
+        }
+    }
+
+    *dst_hex129 = '\0';
+}
+
+void sha512_finalize_bytes(struct sha512 *sha, void *dst_bytes64){
+    uint8_t *ptr = (uint8_t*)dst_bytes64;
+    int i, j;
+    sha512_finalize(sha);
+
+    for (i = 0; i < 8; i++){
+        for (j = 7; j >= 0; j--){
+            *ptr++ = (sha->state[i] >> j * 8) & 0xff;
+        }
+    }
+}
+
+void sha512_hex(const void *src, size_t n_bytes, char *dst_hex129){
+    struct sha512 sha;
+
+    sha512_init(&sha);
+
+    sha512_append(&sha, src, n_bytes);
+
+    sha512_finalize_hex(&sha, dst_hex129);
+}
+
+void sha512_bytes(const void *src, size_t n_bytes, void *dst_bytes64){
+    struct sha512 sha;
+
+    sha512_init(&sha);
+
+    sha512_append(&sha, src, n_bytes);
+
+    sha512_finalize_bytes(&sha, dst_bytes64);
+}
@@ -1,163 +1,357 @@
 #include "unzip_helper.h"
 
-// Read the last N bytes of the file to locate EOCD
-off_t findEOCDOffset(int fd) {
-    char buffer[BUFFER_SIZE];
+// Scan the last 64 KiB + 22 bytes of the file backwards for an EOCD whose comment runs exactly to the end
+off_t findEOCDOffset(const ApkView& view) {
+    static const unsigned char signature[4] = { 0x50, 0x4b, 0x05, 0x06 };
 
-    off_t fileSize = my_lseek(fd, 0, SEEK_END);
-    off_t offset = fileSize - BUFFER_SIZE;
+    off_t offset = view.size - EOCD_SEARCH_SIZE;
     if (offset < 0) offset = 0;
 
-    my_lseek(fd, offset, SEEK_SET);
-    ssize_t bytesRead = my_read(fd, buffer, BUFFER_SIZE);
+    size_t size = (size_t) (view.size - offset);
+    if (size < EOCD_MIN_SIZE) {
+        return -1;
+    }
+
+    const unsigned char* data = acquireApkSpan(view, offset, size);
+    if (data == NULL) {
+        return -1;
+    }
 
-    for (int i = (int) bytesRead - EOCD_MIN_SIZE; i >= 0; --i) {
-        if (*(uint32_t*)(buffer + i) == EOCD_SIGNATURE) {
-            return offset + i;
+    // The signature can also show up inside the comment, keep looking until the comment length checks out
+    off_t eocdOffset = -1;
+    size_t end = size - EOCD_MIN_SIZE + sizeof(signature);
+    const unsigned char* eocd;
+    while ((eocd = findLastPattern(data, end, signature, sizeof(signature))) != NULL) {
+        size_t pos = (size_t) (eocd - data);
+        if (readLE16(eocd + 20) == size - pos - EOCD_MIN_SIZE) {
+            eocdOffset = offset + (off_t) pos;
+            break;
         }
+        end = pos + sizeof(signature) - 1;
     }
 
-    return -1; // EOCD not found
+    return eocdOffset;
 }
 
 // Parse EOCD and get the central directory offset
-off_t getCentralDirectoryOffset(int fd, off_t eocdOffset) {
-    char eocdBuffer[EOCD_MIN_SIZE];
-    
-    my_lseek(fd, eocdOffset, SEEK_SET);
-    my_read(fd, eocdBuffer, EOCD_MIN_SIZE);
-    
-    off_t centralDirectoryOffset = (off_t) readLE32(eocdBuffer + 16); // Central Directory offset
+off_t getCentralDirectoryOffset(const ApkView& view, off_t eocdOffset) {
+    unsigned char eocdBuffer[EOCD_MIN_SIZE];
+
+    const unsigned char* eocd = getApkSpan(view, eocdOffset, EOCD_MIN_SIZE, eocdBuffer);
+    if (eocd == NULL) {
+        return -1;
+    }
+
+    off_t centralDirectoryOffset = (off_t) readLE32(eocd + 16); // Central Directory offset
     LOGD("Central Directory Offset : %ld", centralDirectoryOffset);
 
     return centralDirectoryOffset;
 }
 
-// Extract Central Directory and find META-INF/*.RSA or META-INF/*.DSA
-int findCertificateFile(int fd, off_t centralDirOffset, char* certFileName, off_t& fileOffset, size_t& fileSize) {
-    LOGD("Trying to find certificate file from Central Directory...");
+// Get the whole Central Directory as a span, valid until the view is closed
+int readCentralDirectory(const ApkView& view, off_t eocdOffset, const unsigned char*& data, size_t& size) {
+    unsigned char eocdBuffer[EOCD_MIN_SIZE];
+    const unsigned char* eocd = getApkSpan(view, eocdOffset, sizeof(eocdBuffer), eocdBuffer);
+    if (eocd == NULL) {
+        LOGE("Failed to read EOCD");
+        return -1;
+    }
 
-    my_lseek(fd, centralDirOffset, SEEK_SET);
-    char buffer[46]; // Central Directory file header size
+    size = readLE32(eocd + 12); // Central Directory size
+    off_t centralDirOffset = (off_t) readLE32(eocd + 16);
 
-    while (my_read(fd, buffer, sizeof(buffer)) > 0) {
-        uint32_t signature = readLE32(buffer);
-        if (signature != CENTRAL_DIRECTORY_SIGNATURE) {
-            LOGE("Central Directory signature mismatch");
-            break;
-        }
+    if (size > CENTRAL_DIRECTORY_MAX_SIZE || centralDirOffset + (off_t) size > eocdOffset) {
+        LOGE("Invalid Central Directory size: %zu", size);
+        return -1;
+    }
 
-        uint16_t fileNameLength = readLE16(buffer + 28);
-        uint16_t extraFieldLength = readLE16(buffer + 30);
-        uint16_t commentLength = readLE16(buffer + 32);
+    data = acquireApkSpan(view, centralDirOffset, size);
+    if (data == NULL) {
+        LOGE("Failed to read Central Directory");
+        return -1;
+    }
 
-        // Read file name
-        char fileName[256];
-        my_read(fd, fileName, fileNameLength);
-        fileName[fileNameLength] = '\0';
+    return 0;
+}
 
-        // LOGD("Central Directory entry found : %s", fileName);
+// Parse the record at pos and move past it. Returns 1 for an entry, 0 at the end, -1 on malformed data
+int nextCentralDirectoryEntry(const unsigned char* data, size_t size, size_t& pos, ZipEntry& entry) {
+    if (pos == size)
+        return 0;
 
-        if (my_strstr(fileName, "META-INF/") && (my_strstr(fileName, ".RSA") || my_strstr(fileName, ".DSA"))) {
-            LOGD("Central Directory - Found certificate file : %s", fileName);
+    if (size - pos < CENTRAL_DIRECTORY_HEADER_SIZE || readLE32(data + pos) != CENTRAL_DIRECTORY_SIGNATURE) {
+        LOGE("Central Directory signature mismatch");
+        return -1;
+    }
 
-            my_strlcpy(certFileName, fileName, my_strlen(fileName));
-            fileOffset = (off_t) readLE32(buffer + 42); // Local header offset
-            fileSize = readLE32(buffer + 24); // decompressed size
+    const unsigned char* header = data + pos;
+    uint16_t fileNameLength = readLE16(header + 28);
+    uint16_t extraFieldLength = readLE16(header + 30);
+    uint16_t commentLength = readLE16(header + 32);
 
-            LOGD("File Offset: %ld", fileOffset);
-            LOGD("File Size: %zu", fileSize);
+    size_t recordSize = CENTRAL_DIRECTORY_HEADER_SIZE + fileNameLength + extraFieldLength + commentLength;
+    if (size - pos < recordSize) {
+        LOGE("Central Directory record runs past its end");
+        return -1;
+    }
 
-            return 0; // Found
-        }
+    entry.name = (const char*) header + CENTRAL_DIRECTORY_HEADER_SIZE;
+    entry.nameLength = fileNameLength;
+    entry.compressionMethod = readLE16(header + 10);
+    entry.nameHash = hashZipName(entry.name, fileNameLength);
+    entry.crc32 = readLE32(header + 16);
+    entry.compressedSize = readLE32(header + 20);
+    entry.uncompressedSize = readLE32(header + 24);
+    entry.localHeaderOffset = readLE32(header + 42);
+
+    pos += recordSize;
+    return 1;
+}
 
-        // Skip extra fields and comments
-        my_lseek(fd, extraFieldLength + commentLength, SEEK_CUR);
+uint32_t hashZipName(const char* name, size_t length) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= (uint8_t) name[i];
+        hash *= 16777619u;
     }
+    return hash;
+}
+
+static bool hasExtension(const ZipEntry& entry, const char* extension) {
+    size_t extensionLength = my_strlen(extension);
+    if (entry.nameLength < extensionLength)
+        return false;
 
-    return -1; // Not found
+    const char* end = entry.name + entry.nameLength - extensionLength;
+    for (size_t i = 0; i < extensionLength; ++i) {
+        if (my_tolower(end[i]) != my_tolower(extension[i]))
+            return false;
+    }
+    return true;
 }
 
-// Extract the certificate file data
-int extractCertFile(int fd, off_t fileOffset, size_t& certSize, unsigned char* certData) {
-    LOGD("Trying to extract certificate file data...");
+// Only files right inside META-INF take part in signing
+static int classifyZipEntry(const ZipEntry& entry) {
+    size_t prefixLength = sizeof(ZIP_META_INF_PREFIX) - 1;
+    if (entry.nameLength <= prefixLength || my_memcmp(entry.name, ZIP_META_INF_PREFIX, prefixLength) != 0)
+        return -1;
 
-    my_lseek(fd, fileOffset, SEEK_SET);
-    char header[30]; // Local file header size
-    my_read(fd, header, sizeof(header));
+    for (size_t i = prefixLength; i < entry.nameLength; ++i) {
+        if (entry.name[i] == '/')
+            return -1;
+    }
 
-    uint32_t signature = readLE32(header);
-    if (signature != LOCAL_FILE_HEADER_SIGNATURE) {
-        LOGE("Invalid Local File Header signature");
+    if (hasExtension(entry, ".SF"))
+        return ZIP_CLASS_SIGNATURE_FILE;
+    if (hasExtension(entry, ".RSA") || hasExtension(entry, ".DSA") || hasExtension(entry, ".EC"))
+        return ZIP_CLASS_SIGNATURE_BLOCK;
+    return -1;
+}
+
+static const ZipEntry* findZipEntry(const ZipIndex& index, const char* name, size_t nameLength, uint32_t nameHash) {
+    size_t bucket = nameHash & index.bucketMask;
+
+    while (index.buckets[bucket]) {
+        const ZipEntry* entry = &index.entries[index.buckets[bucket] - 1];
+        if (entry->nameLength == nameLength && my_memcmp(entry->name, name, nameLength) == 0)
+            return entry;
+        bucket = (bucket + 1) & index.bucketMask;
+    }
+
+    return NULL;
+}
+
+// Index every Central Directory record in one pass. The index points into the Central Directory span and the view's arena
+int buildZipIndex(const ApkView& view, off_t eocdOffset, ZipIndex& index) {
+    index.centralDir = NULL;
+    index.entries = NULL;
+    index.buckets = NULL;
+    index.count = 0;
+    for (int i = 0; i < ZIP_CLASS_COUNT; i++)
+        index.classes[i] = -1;
+
+    unsigned char eocdBuffer[EOCD_MIN_SIZE];
+    const unsigned char* eocd = getApkSpan(view, eocdOffset, sizeof(eocdBuffer), eocdBuffer);
+    if (eocd == NULL)
+        return -1;
+
+    // The entry count sizes the arrays, it can't exceed what the Central Directory has room for
+    size_t declaredCount = readLE16(eocd + 10);
+    size_t centralDirSize;
+    if (readCentralDirectory(view, eocdOffset, index.centralDir, centralDirSize) < 0)
+        return -1;
+
+    if (declaredCount > centralDirSize / CENTRAL_DIRECTORY_HEADER_SIZE) {
+        LOGE("EOCD declares %zu entries, more than the Central Directory holds", declaredCount);
         return -1;
     }
 
-    uint16_t compressionMethod = readLE16(header + 8);
-    const char* compressionMethodStr = "UNKNOWN";
-    switch (compressionMethod) {
-        case 0:
-            compressionMethodStr = "NONE";
-            break;
-        case 8:
-            compressionMethodStr = "DEFLATE";
+    size_t bucketCount = 16;
+    while (bucketCount < declaredCount * 2)
+        bucketCount <<= 1;
+
+    void* memory = my_arena_alloc(view.arena, declaredCount * sizeof(ZipEntry) + bucketCount * sizeof(uint32_t));
+    if (memory == NULL) {
+        LOGE("Failed to allocate Central Directory index for %zu entries", declaredCount);
+        return -1;
+    }
+
+    index.entries = (ZipEntry*) memory;
+    index.buckets = (uint32_t*) (index.entries + declaredCount);
+    index.bucketMask = bucketCount - 1;
+
+    size_t pos = 0;
+    ZipEntry entry;
+    int ret;
+    while ((ret = nextCentralDirectoryEntry(index.centralDir, centralDirSize, pos, entry)) == 1) {
+        // Records past the declared count would be invisible to readers that trust the EOCD
+        if (index.count == declaredCount) {
+            LOGE("Central Directory holds more entries than declared (%zu)", declaredCount);
+            ret = -1;
             break;
-        default:
+        }
+
+        // Two entries with the same name could be read differently by different parsers
+        if (findZipEntry(index, entry.name, entry.nameLength, entry.nameHash) != NULL) {
+            LOGE("Duplicate entry %.*s", (int) entry.nameLength, entry.name);
+            ret = -1;
             break;
+        }
+
+        size_t bucket = entry.nameHash & index.bucketMask;
+        while (index.buckets[bucket])
+            bucket = (bucket + 1) & index.bucketMask;
+
+        int entryClass = classifyZipEntry(entry);
+        if (entryClass >= 0 && index.classes[entryClass] < 0)
+            index.classes[entryClass] = (int32_t) index.count;
+
+        index.entries[index.count] = entry;
+        index.buckets[bucket] = (uint32_t) ++index.count;
     }
-    LOGD("Local File Header - Compression Method: %u => %s", compressionMethod, compressionMethodStr);
 
-    size_t compressedSize = (size_t) readLE32(header + 18);
-    size_t decompressedSize = (size_t) readLE32(header + 22);
-    uint16_t fileNameLength = readLE16(header + 26);
-    uint16_t extraLength = readLE16(header + 28);
+    if (ret < 0 || index.count != declaredCount) {
+        LOGE("Central Directory doesn't match the EOCD");
+        return -1;
+    }
 
-    LOGD("Local File Header - Compressed Data Size: %zu", compressedSize);
-    LOGD("Local File Header - Decompressed Data Size: %zu", decompressedSize);
-    LOGD("Local File Header - File Name Length: %u", fileNameLength);
-    LOGD("Local File Header - File Extra Length: %u", extraLength);
+    LOGD("Central Directory lists %zu entries", index.count);
+    return 0;
+}
 
-    // Confirming file name
-    char fileName[256];
-    my_read(fd, fileName, fileNameLength);
-    fileName[fileNameLength] = '\0';
+const ZipEntry* findZipEntry(const ZipIndex& index, const char* name, size_t nameLength) {
+    return findZipEntry(index, name, nameLength, hashZipName(name, nameLength));
+}
 
-    LOGD("Filename: %s", fileName);
+const ZipEntry* findZipEntryByClass(const ZipIndex& index, ZipEntryClass entryClass) {
+    int32_t i = index.classes[entryClass];
+    return i < 0 ? NULL : &index.entries[i];
+}
 
-    my_lseek(fd, extraLength, SEEK_CUR); // Skip to file data
+// Check the Local File Header of an entry against its Central Directory record and find its data
+off_t getLocalFileDataOffset(const ApkView& view, const ZipEntry& entry) {
+    unsigned char headerBuffer[LOCAL_FILE_HEADER_SIZE + 256];
+    size_t toRead = LOCAL_FILE_HEADER_SIZE + (entry.nameLength < 256 ? entry.nameLength : 256);
+    const unsigned char* header = getApkSpan(view, entry.localHeaderOffset, toRead, headerBuffer);
 
-    unsigned char * compressedPkcs7RawData = (unsigned char *) malloc(compressedSize);
-    ssize_t compressedPkcs7RawDataSize = my_read(fd, compressedPkcs7RawData, (size_t) compressedSize);
+    if (header == NULL || readLE32(header) != LOCAL_FILE_HEADER_SIGNATURE) {
+        LOGE("Invalid Local File Header signature");
+        return -1;
+    }
+
+    uint16_t fileNameLength = readLE16(header + 26);
+    uint16_t extraLength = readLE16(header + 28);
 
-    if (compressedPkcs7RawDataSize != compressedSize) {
-        LOGE("Failed to read certificate file, expected: %zu, got: %zd", compressedSize, compressedPkcs7RawDataSize);
-        delete[] compressedPkcs7RawData;
+    // The name must agree with the Central Directory, at least as far as we read it
+    if (fileNameLength != entry.nameLength
+        || my_memcmp(header + LOCAL_FILE_HEADER_SIZE, entry.name, toRead - LOCAL_FILE_HEADER_SIZE) != 0) {
+        LOGE("Local File Header doesn't match its Central Directory record");
         return -1;
     }
 
-    LOGD("Inflating the compressed DER encoded PKCS#7 raw data");
-    unsigned char* pkcs7RawData = new unsigned char[decompressedSize];
-    size_t pkcs7RawDataSize = decompressedSize;
-    int ret = inflate(pkcs7RawData, &pkcs7RawDataSize, compressedPkcs7RawData, compressedPkcs7RawDataSize);
+    return (off_t) entry.localHeaderOffset + LOCAL_FILE_HEADER_SIZE + fileNameLength + extraLength;
+}
+
+// Hand the uncompressed data of an entry to sink one window at a time, without ever holding all of it
+int streamZipEntry(const ApkView& view, const ZipEntry& entry, ZipStreamWorkspace* workspace, ZipEntrySink sink, void* ctx) {
+    off_t offset = getLocalFileDataOffset(view, entry);
+    if (offset < 0)
+        return -1;
 
-    if (ret < 0) {
-        LOGE("Inflating data failed with error %d", ret);
+    if (entry.compressionMethod != 0 && entry.compressionMethod != 8) {
+        LOGE("Unsupported compression method: %u", entry.compressionMethod);
         return -1;
     }
 
-    if (pkcs7RawDataSize != decompressedSize) {
-        LOGE("Inflated file size (%zu) doesn't match expected size (%zu)", pkcs7RawDataSize, decompressedSize);
+    bool stored = entry.compressionMethod == 0;
+    if (stored && entry.compressedSize != entry.uncompressedSize) {
+        LOGE("Stored entry sizes don't match");
         return -1;
     }
 
-    LOGD("Extracting certificate from DER encoded PKCS#7 raw data");
+    if (!stored)
+        inflateStreamInit(&workspace->stream, workspace->window, sizeof(workspace->window), true);
+
+    prefetchApkSpan(view, offset, entry.compressedSize);
+
+    size_t remaining = entry.compressedSize;
+    size_t produced = 0;
+    InflateResult ret = INFLATE_NEED_INPUT;
+
+    for (;;) {
+        if (ret == INFLATE_NEED_INPUT) {
+            // Mapped data is handed over in one piece, otherwise it goes through the input buffer
+            size_t toRead = view.data || remaining < sizeof(workspace->input) ? remaining : sizeof(workspace->input);
+            const unsigned char* input = getApkSpan(view, offset, toRead, workspace->input);
+            if (input == NULL) {
+                LOGE("Failed to read entry data");
+                return -1;
+            }
+
+            offset += toRead;
+            remaining -= toRead;
+
+            if (stored) {
+                if (toRead)
+                    sink(ctx, input, toRead);
+                produced += toRead;
+
+                if (remaining == 0)
+                    break;
+                continue;
+            }
+
+            inflateStreamInput(&workspace->stream, input, toRead, remaining == 0);
+        }
+
+        const uint8_t* out;
+        size_t outLen;
+        ret = inflateStreamNext(&workspace->stream, &out, &outLen);
+
+        if (ret < 0) {
+            LOGE("Inflating entry failed with error %d", ret);
+            return -1;
+        }
+
+        // Stop as soon as the entry grows past its declared size
+        produced += outLen;
+        if (produced > entry.uncompressedSize) {
+            LOGE("Entry inflates past its declared size (%u)", entry.uncompressedSize);
+            return -1;
+        }
 
-    extract_cert_from_pkcs7(pkcs7RawData, pkcs7RawDataSize, &certSize, certData);
+        if (outLen)
+            sink(ctx, out, outLen);
 
-    if (certData == NULL) {
-        LOGE("Could not find cert data in DER encoded PKCS#7 raw data");
+        if (ret == INFLATE_END)
+            break;
+    }
+
+    if (produced != entry.uncompressedSize) {
+        LOGE("Inflated entry size (%zu) doesn't match expected size (%u)", produced, entry.uncompressedSize);
         return -1;
     }
-    
-    LOGD("Found cert data in DER encoded PKCS#7 raw data");
+
     return 0;
-}
\ No newline at end of file
+}
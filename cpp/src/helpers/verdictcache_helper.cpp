@@ -0,0 +1,70 @@
+#include "verdictcache_helper.h"
+
+#include <sys/mman.h> // For PROT_READ, MAP_PRIVATE
+
+typedef struct {
+    ApkPathList apks;
+    ApkIdentity identities[APK_MAX_FILES];
+    char directory[PATH_SIZE]; // A split added next to the APKs changes it
+} VerdictCache;
+
+// Filled before it is published and never written again, so readers need nothing more than the acquire load.
+// A newer verdict gets a mapping of its own rather than reusing one another thread may still be reading,
+// that only happens when an APK changed under a running process
+static VerdictCache* publishedVerdict = nullptr;
+
+static bool isUnchanged(const char* path, const ApkIdentity& identity) {
+    struct stat st;
+    if (my_fstatat(AT_FDCWD, path, &st, 0) < 0) {
+        return false;
+    }
+
+    ApkIdentity current;
+    getApkIdentity(st, current);
+    return my_memcmp(&current, &identity, sizeof(current)) == 0;
+}
+
+bool isVerdictCached() {
+    const VerdictCache* cache = __atomic_load_n(&publishedVerdict, __ATOMIC_ACQUIRE);
+    if (cache == nullptr) {
+        return false;
+    }
+
+    for (size_t i = 0; i < cache->apks.count; i++) {
+        if (!isUnchanged(cache->apks.paths[i], cache->identities[i])) {
+            LOGW("%s changed since it was verified", cache->apks.paths[i]);
+            return false;
+        }
+    }
+
+    if (!isUnchanged(cache->directory, cache->apks.directoryIdentity)) {
+        LOGW("%s changed since it was verified", cache->directory);
+        return false;
+    }
+
+    return true;
+}
+
+void cacheVerdict(const ApkPathList& apks, const ApkIdentity* identities) {
+    const char* lastSlash = apks.count ? my_strrchr(apks.paths[0], '/') : nullptr;
+    if (lastSlash == nullptr) {
+        return;
+    }
+
+    void* memory = my_mmap(NULL, sizeof(VerdictCache), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        LOGW("Failed to map verdict cache, the next check starts over");
+        return;
+    }
+    VerdictCache* cache = (VerdictCache*) memory;
+
+    // The directory identity comes along with the list, only its path is kept to stat it again
+    my_memcpy(&cache->apks, &apks, sizeof(apks));
+    my_memcpy(cache->identities, identities, apks.count * sizeof(ApkIdentity));
+
+    size_t directoryLength = (size_t) (lastSlash - apks.paths[0]) + 1;
+    my_memcpy(cache->directory, apks.paths[0], directoryLength);
+    cache->directory[directoryLength] = '\0';
+
+    __atomic_store_n(&publishedVerdict, cache, __ATOMIC_RELEASE);
+}
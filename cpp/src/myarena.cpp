@@ -0,0 +1,98 @@
+#include "myarena.h"
+
+#include <sys/mman.h> // For PROT_READ, MAP_PRIVATE
+
+// Start of every mapping, blocks are chained so that they can all be unmapped at the end
+typedef struct MyArenaBlock {
+    struct MyArenaBlock* next;
+    size_t size; // Whole mapping, header included
+} MyArenaBlock;
+
+// Lives in the first block, right after its header
+struct MyArena {
+    MyArenaBlock* blocks;
+    uintptr_t cursor;
+    uintptr_t end;
+};
+
+static inline size_t alignUp(size_t size) {
+    return (size + MY_ARENA_ALIGNMENT - 1) & ~(size_t) (MY_ARENA_ALIGNMENT - 1);
+}
+
+#define BLOCK_HEADER_SIZE alignUp(sizeof(MyArenaBlock))
+
+static MyArenaBlock* mapBlock(size_t size) {
+    void* memory = my_mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        return NULL;
+    }
+
+    MyArenaBlock* block = (MyArenaBlock*) memory;
+    block->size = size;
+    return block;
+}
+
+MyArena* my_arena_create() {
+    MyArenaBlock* block = mapBlock(MY_ARENA_BLOCK_SIZE);
+    if (block == NULL) {
+        return NULL;
+    }
+    block->next = NULL;
+
+    MyArena* arena = (MyArena*) ((uintptr_t) block + BLOCK_HEADER_SIZE);
+    arena->blocks = block;
+    arena->cursor = (uintptr_t) arena + alignUp(sizeof(MyArena));
+    arena->end = (uintptr_t) block + MY_ARENA_BLOCK_SIZE;
+    return arena;
+}
+
+void* my_arena_alloc(MyArena* arena, size_t size) {
+    // Anonymous mappings are zero-filled and nothing is ever handed out twice, so every allocation starts zeroed
+    if (size > (size_t) -1 - BLOCK_HEADER_SIZE - MY_ARENA_ALIGNMENT) {
+        return NULL;
+    }
+    size = alignUp(size ? size : 1);
+
+    if (size <= arena->end - arena->cursor) {
+        void* memory = (void*) arena->cursor;
+        arena->cursor += size;
+        return memory;
+    }
+
+    // Large ones would waste most of a block, they get a mapping of their own and the current block stays in use
+    if (size > MY_ARENA_BLOCK_SIZE / 4) {
+        MyArenaBlock* block = mapBlock(BLOCK_HEADER_SIZE + size);
+        if (block == NULL) {
+            return NULL;
+        }
+        block->next = arena->blocks;
+        arena->blocks = block;
+        return (void*) ((uintptr_t) block + BLOCK_HEADER_SIZE);
+    }
+
+    MyArenaBlock* block = mapBlock(MY_ARENA_BLOCK_SIZE);
+    if (block == NULL) {
+        return NULL;
+    }
+    block->next = arena->blocks;
+    arena->blocks = block;
+
+    uintptr_t memory = (uintptr_t) block + BLOCK_HEADER_SIZE;
+    arena->cursor = memory + size;
+    arena->end = (uintptr_t) block + MY_ARENA_BLOCK_SIZE;
+    return (void*) memory;
+}
+
+void my_arena_destroy(MyArena* arena) {
+    if (arena == NULL) {
+        return;
+    }
+
+    // The arena is in the last block of the list, nothing reads it once the walk has started
+    MyArenaBlock* block = arena->blocks;
+    while (block) {
+        MyArenaBlock* next = block->next;
+        my_munmap(block, block->size);
+        block = next;
+    }
+}
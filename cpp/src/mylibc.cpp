@@ -1,19 +1,310 @@
 #include "mylibc.h"
 
+#include <errno.h> // For errno, only where my_raw_syscall falls back to syscall()
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Word loads and stores at any alignment. Going through these rather than a memcpy of 8 bytes means there's no
+// call into bionic to hook, this file is also built with -fno-builtin so that our loops aren't turned into one
+typedef uint64_t __attribute__((may_alias, aligned(1))) unaligned_uint64_t;
+typedef uint64_t __attribute__((may_alias)) aligned_uint64_t;
+
+#define ONES_64 0x0101010101010101ULL
+#define HIGHS_64 0x8080808080808080ULL
+
+// Blocks handled at once, and how many mask bits each byte takes in zeroMask
+#if defined(__ARM_NEON)
+#define BLOCK_SIZE 16
+#define MASK_STRIDE 4
+
+static inline bool blocksEqual(const unsigned char *p1, const unsigned char *p2) {
+    uint8x16_t eq = vceqq_u8(vld1q_u8(p1), vld1q_u8(p2));
+    // No horizontal min on ARMv7, folding the halves together works on both
+    uint8x8_t folded = vand_u8(vget_low_u8(eq), vget_high_u8(eq));
+    return vget_lane_u64(vreinterpret_u64_u8(folded), 0) == ~0ULL;
+}
+
+static inline void copyBlock(unsigned char *d, const unsigned char *s) {
+    vst1q_u8(d, vld1q_u8(s));
+}
+
+static inline void fillBlock(unsigned char *d, unsigned char c) {
+    vst1q_u8(d, vdupq_n_u8(c));
+}
+
+// Bit MASK_STRIDE * i is set when block[i] is zero, same narrowing as the ZIP scanner since NEON has no movemask.
+// The load is where my_strlen reads past the terminator, so this is what ASan must leave alone
+__attribute__((no_sanitize("address", "hwaddress")))
+static inline uint64_t zeroMask(const unsigned char *block) {
+    uint8x16_t zeros = vceqq_u8(vld1q_u8(block), vdupq_n_u8(0));
+    uint64_t nibbles = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(zeros), 4)), 0);
+    return nibbles & 0x1111111111111111ULL;
+}
+#elif defined(__SSE2__)
+#define BLOCK_SIZE 16
+#define MASK_STRIDE 1
+
+static inline bool blocksEqual(const unsigned char *p1, const unsigned char *p2) {
+    __m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) p1), _mm_loadu_si128((const __m128i *) p2));
+    return _mm_movemask_epi8(eq) == 0xffff;
+}
+
+static inline void copyBlock(unsigned char *d, const unsigned char *s) {
+    _mm_storeu_si128((__m128i *) d, _mm_loadu_si128((const __m128i *) s));
+}
+
+static inline void fillBlock(unsigned char *d, unsigned char c) {
+    _mm_storeu_si128((__m128i *) d, _mm_set1_epi8((char) c));
+}
+
+// Bit MASK_STRIDE * i is set when block[i] is zero, block has to be aligned. The load is where my_strlen reads
+// past the terminator, so this is what ASan must leave alone
+__attribute__((no_sanitize("address", "hwaddress")))
+static inline uint64_t zeroMask(const unsigned char *block) {
+    __m128i zeros = _mm_cmpeq_epi8(_mm_load_si128((const __m128i *) block), _mm_setzero_si128());
+    return (uint64_t) (uint32_t) _mm_movemask_epi8(zeros);
+}
+#endif
+
+long my_raw_syscall(long nr, long a, long b, long c, long d, long e, long f) {
+#if defined(__aarch64__)
+    register long x8 __asm__("x8") = nr;
+    register long x0 __asm__("x0") = a;
+    register long x1 __asm__("x1") = b;
+    register long x2 __asm__("x2") = c;
+    register long x3 __asm__("x3") = d;
+    register long x4 __asm__("x4") = e;
+    register long x5 __asm__("x5") = f;
+    __asm__ volatile("svc #0" : "+r"(x0) : "r"(x8), "r"(x1), "r"(x2), "r"(x3), "r"(x4), "r"(x5) : "memory", "cc");
+    return x0;
+#elif defined(__arm__)
+    // r7 is the frame pointer in Thumb code, so it's saved around the call rather than bound to a variable
+    register long r0 __asm__("r0") = a;
+    register long r1 __asm__("r1") = b;
+    register long r2 __asm__("r2") = c;
+    register long r3 __asm__("r3") = d;
+    register long r4 __asm__("r4") = e;
+    register long r5 __asm__("r5") = f;
+    __asm__ volatile(
+        "push {r7}\n\t"
+        "mov r7, %[nr]\n\t"
+        "svc #0\n\t"
+        "pop {r7}"
+        : "+r"(r0)
+        : [nr] "r"(nr), "r"(r1), "r"(r2), "r"(r3), "r"(r4), "r"(r5)
+        : "memory", "cc");
+    return r0;
+#elif defined(__x86_64__)
+    register long r10 __asm__("r10") = d;
+    register long r8 __asm__("r8") = e;
+    register long r9 __asm__("r9") = f;
+    long ret;
+    __asm__ volatile(
+        "syscall"
+        : "=a"(ret)
+        : "a"(nr), "D"(a), "S"(b), "d"(c), "r"(r10), "r"(r8), "r"(r9)
+        : "rcx", "r11", "memory");
+    return ret;
+#elif defined(__i386__)
+    // ebx may hold the GOT pointer and ebp the frame pointer, with every other register taken by an argument they're
+    // loaded from memory through eax and given back afterwards
+    long args[3] = { nr, a, f };
+    long ret;
+    __asm__ volatile(
+        "push %%ebp\n\t"
+        "push %%ebx\n\t"
+        "mov 4(%%eax), %%ebx\n\t"
+        "mov 8(%%eax), %%ebp\n\t"
+        "mov 0(%%eax), %%eax\n\t"
+        "int $0x80\n\t"
+        "pop %%ebx\n\t"
+        "pop %%ebp"
+        : "=a"(ret)
+        : "0"(args), "c"(b), "d"(c), "S"(d), "D"(e)
+        : "memory");
+    return ret;
+#else
+    long ret = syscall(nr, a, b, c, d, e, f);
+    return ret == -1 ? -errno : ret;
+#endif
+}
+
+// Kernel errors come back as -4095 to -1, turned into -1 like libc does
+static inline long sysResult(long ret) {
+    return (unsigned long) ret > (unsigned long) -4096 ? -1 : ret;
+}
+
 int my_openat(int dirfd, const char* path, int flags) {
-    return (int) syscall(__NR_openat, dirfd, path, flags);
+    return (int) sysResult(my_raw_syscall(__NR_openat, dirfd, (long) path, flags));
 }
 
 ssize_t my_read(int fd, void* buf, size_t count) {
-    return (ssize_t) syscall(__NR_read, fd, buf, count);
+    return (ssize_t) sysResult(my_raw_syscall(__NR_read, fd, (long) buf, count));
 }
 
 int my_close(int fd) {
-    return (int) syscall(__NR_close, fd);
+    return (int) sysResult(my_raw_syscall(__NR_close, fd));
+}
+
+// The link target isn't null-terminated, same as readlinkat
+ssize_t my_readlinkat(int dirfd, const char* path, char* buf, size_t size) {
+    return (ssize_t) sysResult(my_raw_syscall(__NR_readlinkat, dirfd, (long) path, (long) buf, size));
+}
+
+long my_getdents64(int fd, void* buf, size_t count) {
+    return sysResult(my_raw_syscall(__NR_getdents64, fd, (long) buf, count));
 }
 
 off_t my_lseek(int fd, off_t offset, int whence) {
-    return (off_t) syscall(__NR_lseek, fd, offset, whence);
+    return (off_t) sysResult(my_raw_syscall(__NR_lseek, fd, offset, whence));
+}
+
+ssize_t my_pread64(int fd, void* buf, size_t count, off64_t offset) {
+#if defined(__LP64__)
+    return (ssize_t) sysResult(my_raw_syscall(__NR_pread64, fd, (long) buf, count, offset));
+#elif defined(__arm__)
+    // ARM EABI passes 64-bit arguments in an even/odd register pair, hence the padding argument
+    return (ssize_t) sysResult(my_raw_syscall(__NR_pread64, fd, (long) buf, count, 0, (uint32_t) offset, (uint32_t) (offset >> 32)));
+#else
+    return (ssize_t) sysResult(my_raw_syscall(__NR_pread64, fd, (long) buf, count, (uint32_t) offset, (uint32_t) (offset >> 32)));
+#endif
+}
+
+// The offset goes in two longs on every ABI, so no register pair alignment on ARM EABI. 64-bit kernels ignore the high one
+ssize_t my_preadv(int fd, const struct iovec* iov, int iovcnt, off64_t offset) {
+#if defined(__LP64__)
+    return (ssize_t) sysResult(my_raw_syscall(__NR_preadv, fd, (long) iov, iovcnt, offset, 0));
+#else
+    return (ssize_t) sysResult(my_raw_syscall(__NR_preadv, fd, (long) iov, iovcnt, (uint32_t) offset, (uint32_t) (offset >> 32)));
+#endif
+}
+
+// Bionic's struct stat has the layout of the kernel's stat64 on 32-bit ABIs
+int my_fstat(int fd, struct stat* st) {
+#if defined(__LP64__)
+    return (int) sysResult(my_raw_syscall(__NR_fstat, fd, (long) st));
+#else
+    return (int) sysResult(my_raw_syscall(__NR_fstat64, fd, (long) st));
+#endif
+}
+
+int my_fstatat(int dirfd, const char* path, struct stat* st, int flags) {
+#if defined(__LP64__)
+    return (int) sysResult(my_raw_syscall(__NR_newfstatat, dirfd, (long) path, (long) st, flags));
+#else
+    return (int) sysResult(my_raw_syscall(__NR_fstatat64, dirfd, (long) path, (long) st, flags));
+#endif
+}
+
+int my_statx(int dirfd, const char* path, int flags, unsigned int mask, struct statx* stx) {
+#if defined(__NR_statx)
+    return (int) sysResult(my_raw_syscall(__NR_statx, dirfd, (long) path, flags, mask, (long) stx));
+#else
+    return -1;
+#endif
+}
+
+ssize_t my_readahead(int fd, off64_t offset, size_t count) {
+#if defined(__LP64__)
+    return (ssize_t) sysResult(my_raw_syscall(__NR_readahead, fd, offset, count));
+#elif defined(__arm__)
+    return (ssize_t) sysResult(my_raw_syscall(__NR_readahead, fd, 0, (uint32_t) offset, (uint32_t) (offset >> 32), count));
+#else
+    return (ssize_t) sysResult(my_raw_syscall(__NR_readahead, fd, (uint32_t) offset, (uint32_t) (offset >> 32), count));
+#endif
+}
+
+int my_fadvise64(int fd, off64_t offset, off64_t len, int advice) {
+#if defined(__LP64__)
+    return (int) sysResult(my_raw_syscall(__NR_fadvise64, fd, offset, len, advice));
+#elif defined(__arm__)
+    // ARM moved advice up front so that the 64-bit arguments land on register pairs
+    return (int) sysResult(my_raw_syscall(__NR_arm_fadvise64_64, fd, advice, (uint32_t) offset, (uint32_t) (offset >> 32),
+                                          (uint32_t) len, (uint32_t) (len >> 32)));
+#else
+    return (int) sysResult(my_raw_syscall(__NR_fadvise64_64, fd, (uint32_t) offset, (uint32_t) (offset >> 32),
+                                          (uint32_t) len, (uint32_t) (len >> 32), advice));
+#endif
+}
+
+void* my_mmap(void* addr, size_t length, int prot, int flags, int fd, off64_t offset) {
+#if defined(__LP64__)
+    return (void*) sysResult(my_raw_syscall(__NR_mmap, (long) addr, length, prot, flags, fd, offset));
+#else
+    // 32-bit ABIs only have mmap2 which takes the offset in 4096-byte pages
+    if (offset & 4095) {
+        return (void*) -1;
+    }
+    return (void*) sysResult(my_raw_syscall(__NR_mmap2, (long) addr, length, prot, flags, fd, (unsigned long) (offset >> 12)));
+#endif
+}
+
+int my_munmap(void* addr, size_t length) {
+    return (int) sysResult(my_raw_syscall(__NR_munmap, (long) addr, length));
+}
+
+int my_mprotect(void* addr, size_t length, int prot) {
+    return (int) sysResult(my_raw_syscall(__NR_mprotect, (long) addr, length, prot));
+}
+
+int my_madvise(void* addr, size_t length, int advice) {
+    return (int) sysResult(my_raw_syscall(__NR_madvise, (long) addr, length, advice));
+}
+
+// Number of CPUs this thread is allowed to run on
+int my_nprocs() {
+    unsigned long mask[1024 / (8 * sizeof(unsigned long))];
+    long bytes = sysResult(my_raw_syscall(__NR_sched_getaffinity, 0, sizeof(mask), (long) mask));
+    if (bytes <= 0) {
+        return 1;
+    }
+
+    int count = 0;
+    for (size_t i = 0; i < (size_t) bytes / sizeof(unsigned long); i++) {
+        count += __builtin_popcountl(mask[i]);
+    }
+
+    return count > 0 ? count : 1;
+}
+
+// Same as getauxval but reads the auxiliary vector from /proc/self/auxv so that it can't be hooked
+unsigned long my_getauxval(unsigned long type) {
+    int fd = my_openat(AT_FDCWD, "/proc/self/auxv", O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+
+    unsigned long entries[2 * 32];
+    ssize_t bytes_read;
+    size_t pending = 0;
+
+    while ((bytes_read = my_read(fd, (char *)entries + pending, sizeof(entries) - pending)) > 0) {
+        pending += (size_t) bytes_read;
+
+        size_t count = pending / (2 * sizeof(unsigned long));
+        for (size_t i = 0; i < count; i++) {
+            if (entries[2 * i] == 0) { // AT_NULL
+                my_close(fd);
+                return 0;
+            }
+            if (entries[2 * i] == type) {
+                my_close(fd);
+                return entries[2 * i + 1];
+            }
+        }
+
+        // Keep a partially read entry for the next round
+        size_t consumed = count * 2 * sizeof(unsigned long);
+        my_memcpy(entries, (char *)entries + consumed, pending - consumed);
+        pending -= consumed;
+    }
+
+    my_close(fd);
+    return 0;
 }
 
 __attribute__((always_inline))
@@ -39,12 +330,39 @@ size_t my_strlcpy(char *dst, const char *src, size_t size)
     return(s - src - 1);	/* count does not include NUL */
 }
 
-__attribute__((always_inline))
+// Reads whole aligned blocks, which can go past the terminator but never across a page, hence no ASan
+__attribute__((always_inline, no_sanitize("address", "hwaddress")))
 size_t my_strlen(const char *s)
 {
-    size_t len = 0;
-    while(*s++) len++;
-    return len;
+#if defined(BLOCK_SIZE)
+    uintptr_t misalignment = (uintptr_t) s & (BLOCK_SIZE - 1);
+    const unsigned char *block = (const unsigned char *) s - misalignment;
+
+    // Bytes before s are shifted out of the first mask
+    uint64_t mask = zeroMask(block) >> (misalignment * MASK_STRIDE);
+    if (mask)
+        return __builtin_ctzll(mask) / MASK_STRIDE;
+
+    for (;;) {
+        block += BLOCK_SIZE;
+        mask = zeroMask(block);
+        if (mask)
+            return (const char *) block - s + __builtin_ctzll(mask) / MASK_STRIDE;
+    }
+#else
+    const char *p = s;
+    for (; (uintptr_t) p & 7; p++) {
+        if (*p == '\0')
+            return p - s;
+    }
+
+    // The lowest byte flagged by the zero byte trick is always a real zero
+    for (const aligned_uint64_t *w = (const aligned_uint64_t *) p;; w++) {
+        uint64_t zeros = (*w - ONES_64) & ~*w & HIGHS_64;
+        if (zeros)
+            return (const char *) w - s + __builtin_ctzll(zeros) / 8;
+    }
+#endif
 }
 
 __attribute__((always_inline))
@@ -83,27 +401,105 @@ char* my_strstr(const char *s, const char *find)
 __attribute__((always_inline))
 int my_memcmp(const void *s1, const void *s2, size_t n)
 {
-    if (n != 0) {
-        const auto *p1 = (const unsigned char *)s1;
-        const auto *p2 = (const unsigned char *)s2;
+    const unsigned char *p1 = (const unsigned char *)s1;
+    const unsigned char *p2 = (const unsigned char *)s2;
+    size_t i = 0;
+
+#if defined(BLOCK_SIZE)
+    // Only finds the block that differs, the word loop below tells which byte it is
+    for (; i + 2 * BLOCK_SIZE <= n; i += 2 * BLOCK_SIZE) {
+        if (!blocksEqual(p1 + i, p2 + i) || !blocksEqual(p1 + i + BLOCK_SIZE, p2 + i + BLOCK_SIZE))
+            break;
+    }
+    for (; i + BLOCK_SIZE <= n; i += BLOCK_SIZE) {
+        if (!blocksEqual(p1 + i, p2 + i))
+            break;
+    }
+#endif
+
+    for (; i + 8 <= n; i += 8) {
+        uint64_t diff = *(const unaligned_uint64_t *) (p1 + i) ^ *(const unaligned_uint64_t *) (p2 + i);
+        if (diff) {
+            // Little-endian, the lowest set bit is in the first byte that differs
+            i += __builtin_ctzll(diff) / 8;
+            return p1[i] - p2[i];
+        }
+    }
 
-        do {
-            if (*p1++ != *p2++)
-                return (*--p1 - *--p2);
-        } while (--n != 0);
+    for (; i < n; i++) {
+        if (p1[i] != p2[i])
+            return p1[i] - p2[i];
     }
-    return (0);
+
+    return 0;
 }
 
+// Copies front to back like the byte loop it replaces, so dest may still overlap src as long as it comes first
 __attribute__((always_inline))
 void * my_memcpy(void *dest, const void *src, size_t len) {
-    // Typecast src and dest addresses to (char *)
-    char *csrc = (char *)src;
-    char *cdest = (char *)dest;
+    unsigned char *d = (unsigned char *)dest;
+    const unsigned char *s = (const unsigned char *)src;
+
+    // The last block overlaps the one before it instead of finishing byte by byte. It's loaded before anything is
+    // stored, in case the stores reach it
+#if defined(BLOCK_SIZE)
+    if (len >= BLOCK_SIZE) {
+        unsigned char last[BLOCK_SIZE];
+        copyBlock(last, s + len - BLOCK_SIZE);
+        size_t i = 0;
+        for (; i + 2 * BLOCK_SIZE < len; i += 2 * BLOCK_SIZE) {
+            copyBlock(d + i, s + i);
+            copyBlock(d + i + BLOCK_SIZE, s + i + BLOCK_SIZE);
+        }
+        if (i + BLOCK_SIZE < len) {
+            copyBlock(d + i, s + i);
+        }
+        copyBlock(d + len - BLOCK_SIZE, last);
+        return dest;
+    }
+#endif
+
+    if (len >= 8) {
+        uint64_t last = *(const unaligned_uint64_t *) (s + len - 8);
+        for (size_t i = 0; i + 8 < len; i += 8) {
+            *(unaligned_uint64_t *) (d + i) = *(const unaligned_uint64_t *) (s + i);
+        }
+        *(unaligned_uint64_t *) (d + len - 8) = last;
+        return dest;
+    }
+
+    for (size_t i = 0; i < len; i++) {
+        d[i] = s[i];
+    }
+
+    return dest;
+}
+
+void * my_memset(void *dest, int c, size_t len) {
+    unsigned char *d = (unsigned char *)dest;
+
+    // Same shape as my_memcpy, the last block overlaps the one before it
+#if defined(BLOCK_SIZE)
+    if (len >= BLOCK_SIZE) {
+        for (size_t i = 0; i + BLOCK_SIZE < len; i += BLOCK_SIZE) {
+            fillBlock(d + i, (unsigned char) c);
+        }
+        fillBlock(d + len - BLOCK_SIZE, (unsigned char) c);
+        return dest;
+    }
+#endif
+
+    if (len >= 8) {
+        uint64_t word = ONES_64 * (unsigned char) c;
+        for (size_t i = 0; i + 8 < len; i += 8) {
+            *(unaligned_uint64_t *) (d + i) = word;
+        }
+        *(unaligned_uint64_t *) (d + len - 8) = word;
+        return dest;
+    }
 
-    // Copy contents of src[] to dest[]
-    for (int i=0; i<len; i++) {
-        cdest[i] = csrc[i];
+    for (size_t i = 0; i < len; i++) {
+        d[i] = (unsigned char) c;
     }
 
     return dest;
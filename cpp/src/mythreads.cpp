@@ -0,0 +1,521 @@
+#include "mythreads.h"
+
+#include <sys/mman.h> // For PROT_READ, MAP_PRIVATE
+#include <sched.h> // For CLONE_VM, CLONE_THREAD...
+#include <signal.h> // For SIG_SETMASK
+#include <limits.h> // For INT_MAX
+#include <linux/futex.h> // For FUTEX_WAIT_PRIVATE, FUTEX_WAKE_PRIVATE
+#if defined(__i386__)
+#include <asm/ldt.h> // For struct user_desc
+#endif
+
+#define POOL_DEQUE_SIZE 64 // Has to be a power of two
+#define POOL_STACK_SIZE (256 * 1024)
+#define POOL_GUARD_SIZE (64 * 1024) // At least one page whatever the page size
+#define POOL_TLS_SIZE 4096 // Above the stack, the thread pointer sits near its top
+
+// Same flags pthread_create uses, minus the tid bookkeeping that only bionic cares about
+#define POOL_CLONE_FLAGS (CLONE_VM | CLONE_FS | CLONE_FILES | CLONE_SIGHAND | CLONE_THREAD | CLONE_SYSVSEM | CLONE_SETTLS)
+
+// Bionic's TLS slots around the thread pointer, from MIN_TLS_SLOT to MAX_TLS_SLOT. They hold the stack guard on x86,
+// which the stack protector reads through %fs or %gs
+#if defined(__aarch64__) || defined(__arm__)
+#define POOL_TLS_SLOTS_BELOW 2
+#define POOL_TLS_SLOTS_ABOVE 8
+#else
+#define POOL_TLS_SLOTS_BELOW 0
+#define POOL_TLS_SLOTS_ABOVE 10
+#endif
+
+// Only ABIs where workers have been seen running get a clone, anything else runs every task on the calling thread.
+// On ARM the thread pointer sits right below the ELF static TLS block, which isn't copied along with the slots, so
+// any thread_local or emulated TLS a task reaches would be another thread's. Define MYTHREADS_ARM_CLONE to try it
+#if defined(__x86_64__) || defined(__i386__) || (defined(MYTHREADS_ARM_CLONE) && (defined(__aarch64__) || defined(__arm__)))
+#define POOL_HAS_CLONE
+#endif
+
+typedef struct PoolJob PoolJob;
+
+// One share of a job. Whoever takes it runs tasks until there is none left, worker is handed to them
+typedef struct {
+    PoolJob* job;
+    size_t worker;
+} PoolSlot;
+
+struct PoolJob {
+    MyPoolTask task;
+    void* ctx;
+    size_t count;
+    size_t next; // Next task index to hand out
+    int pending; // Slots not finished yet, the submitter waits on it
+    PoolSlot slots[MY_POOL_MAX_THREADS];
+};
+
+// Chase-Lev work-stealing deque : the owner pushes and pops at the bottom, other threads steal from the top
+typedef struct {
+    alignas(64) long top;
+    alignas(64) long bottom;
+    PoolSlot* items[POOL_DEQUE_SIZE];
+} PoolDeque;
+
+typedef struct {
+    uintptr_t stackLow;
+    uintptr_t stackHigh;
+} PoolThread;
+
+typedef enum {
+    POOL_IDLE = 0,
+    POOL_STARTING = 1,
+    POOL_READY = 2
+} PoolState;
+
+// Deque 0 belongs to whichever outside thread is running a job, the others to the workers
+static struct {
+    int state;
+    size_t threads; // Outside thread included
+    int wakeups; // Bumped on every submission, idle workers sleep on it
+    int callerTid; // Outside thread owning deque 0, 0 when none
+    int callerDepth;
+    PoolThread workers[MY_POOL_MAX_THREADS];
+    PoolDeque deques[MY_POOL_MAX_THREADS];
+} pool;
+
+#if defined(POOL_HAS_CLONE)
+// Starts entry(arg) on a new thread running on the stack below stackTop, which has to be 16 bytes aligned, with tls
+// as its thread pointer. The child never returns into C code : entry and arg are popped off its new stack and it exits
+// once entry returns
+static long cloneThread(void* stackTop, void* tls, void (*entry)(void*), void* arg) {
+#if defined(__aarch64__)
+    void** sp = (void**) stackTop - 2;
+    sp[0] = (void*) entry;
+    sp[1] = arg;
+
+    register long x8 __asm__("x8") = __NR_clone;
+    register long x0 __asm__("x0") = POOL_CLONE_FLAGS;
+    register long x1 __asm__("x1") = (long) sp;
+    register long x2 __asm__("x2") = 0;
+    register long x3 __asm__("x3") = (long) tls;
+    register long x4 __asm__("x4") = 0;
+    __asm__ volatile(
+        "svc #0\n\t"
+        "cbnz x0, 1f\n\t"
+        "ldp x1, x0, [sp], #16\n\t"
+        "mov x29, xzr\n\t"
+        "mov x30, xzr\n\t"
+        "blr x1\n\t"
+        "mov x8, %[exit]\n\t"
+        "mov x0, xzr\n\t"
+        "svc #0\n"
+        "1:"
+        : "+r"(x0)
+        : "r"(x8), "r"(x1), "r"(x2), "r"(x3), "r"(x4), [exit] "i"(__NR_exit)
+        : "memory", "cc");
+    return x0;
+#elif defined(__arm__)
+    void** sp = (void**) stackTop - 2;
+    sp[0] = (void*) entry;
+    sp[1] = arg;
+
+    register long r0 __asm__("r0") = POOL_CLONE_FLAGS;
+    register long r1 __asm__("r1") = (long) sp;
+    register long r2 __asm__("r2") = 0;
+    register long r3 __asm__("r3") = (long) tls;
+    register long r4 __asm__("r4") = 0;
+    __asm__ volatile(
+        "push {r7}\n\t"
+        "mov r7, %[nr]\n\t"
+        "svc #0\n\t"
+        "cmp r0, #0\n\t"
+        "bne 1f\n\t"
+        "ldr r1, [sp]\n\t"
+        "ldr r0, [sp, #4]\n\t"
+        "blx r1\n\t"
+        "mov r7, %[exit]\n\t"
+        "mov r0, #0\n\t"
+        "svc #0\n"
+        "1:\n\t"
+        "pop {r7}"
+        : "+r"(r0)
+        : "r"(r1), "r"(r2), "r"(r3), "r"(r4), [nr] "r"(__NR_clone), [exit] "i"(__NR_exit)
+        : "memory", "cc");
+    return r0;
+#elif defined(__x86_64__)
+    void** sp = (void**) stackTop - 2;
+    sp[0] = (void*) entry;
+    sp[1] = arg;
+
+    register long r10 __asm__("r10") = 0;
+    register long r8 __asm__("r8") = (long) tls;
+    long ret;
+    __asm__ volatile(
+        "syscall\n\t"
+        "test %%rax, %%rax\n\t"
+        "jnz 1f\n\t"
+        "xor %%ebp, %%ebp\n\t"
+        "pop %%rax\n\t"
+        "pop %%rdi\n\t"
+        "call *%%rax\n\t"
+        "mov %[exit], %%eax\n\t"
+        "xor %%edi, %%edi\n\t"
+        "syscall\n\t"
+        "hlt\n"
+        "1:"
+        : "=a"(ret)
+        : "0"((long) __NR_clone), "D"((long) POOL_CLONE_FLAGS), "S"(sp), "d"(0L), "r"(r10), "r"(r8), [exit] "i"(__NR_exit)
+        : "rcx", "r11", "memory");
+    return ret;
+#elif defined(__i386__)
+    // entry is popped, leaving arg on top and the stack 16 bytes aligned for the call
+    void** sp = (void**) stackTop - 5;
+    sp[0] = (void*) entry;
+    sp[1] = arg;
+
+    long ret;
+    __asm__ volatile(
+        "push %%ebx\n\t"
+        "mov %[flags], %%ebx\n\t"
+        "int $0x80\n\t"
+        "test %%eax, %%eax\n\t"
+        "jnz 1f\n\t"
+        "xor %%ebp, %%ebp\n\t"
+        "pop %%eax\n\t"
+        "call *%%eax\n\t"
+        "mov %[exit], %%eax\n\t"
+        "xor %%ebx, %%ebx\n\t"
+        "int $0x80\n\t"
+        "hlt\n"
+        "1:\n\t"
+        "pop %%ebx"
+        : "=a"(ret)
+        : "0"((long) __NR_clone), [flags] "i"(POOL_CLONE_FLAGS), "c"(sp), "d"(0), "S"(tls), "D"(0), [exit] "i"(__NR_exit)
+        : "memory", "cc");
+    return ret;
+#endif
+}
+
+// Thread pointer of the calling thread. x86 keeps a pointer to it in its first slot, which is how it's read there
+static uintptr_t getThreadPointer() {
+    uintptr_t tp;
+#if defined(__aarch64__)
+    __asm__("mrs %0, tpidr_el0" : "=r"(tp));
+#elif defined(__arm__)
+    __asm__("mrc p15, 0, %0, c13, c0, 3" : "=r"(tp));
+#elif defined(__x86_64__)
+    __asm__("mov %%fs:0, %0" : "=r"(tp));
+#else
+    __asm__("mov %%gs:0, %0" : "=r"(tp));
+#endif
+    return tp;
+}
+
+// Copies the TLS slots of the thread starting the pool into the block at tlsLow, so that a worker has a stack guard
+// of its own that stays valid once that thread is gone. Returns what clone takes with CLONE_SETTLS, NULL on failure
+static void* setUpWorkerTls(uintptr_t tlsLow) {
+    const uintptr_t* slots = (const uintptr_t*) getThreadPointer();
+    uintptr_t tp = (tlsLow + POOL_TLS_SIZE - POOL_TLS_SLOTS_ABOVE * sizeof(uintptr_t)) & ~(uintptr_t) 63;
+    uintptr_t* copy = (uintptr_t*) tp;
+    for (int i = -POOL_TLS_SLOTS_BELOW; i < POOL_TLS_SLOTS_ABOVE; i++) {
+        // Slots pointing at the thread pointer itself have to point at the copy
+        copy[i] = slots[i] == (uintptr_t) slots ? tp : slots[i];
+    }
+
+#if defined(__i386__)
+    // i386 takes a descriptor of the gs segment rather than the thread pointer, the same entry as ours with another base
+    unsigned int selector;
+    __asm__("mov %%gs, %0" : "=r"(selector));
+    struct user_desc* desc = (struct user_desc*) tlsLow;
+    desc->entry_number = selector >> 3;
+    if (my_raw_syscall(__NR_get_thread_area, (long) desc) < 0) {
+        return NULL;
+    }
+    desc->base_addr = tp;
+    return desc;
+#else
+    return (void*) tp;
+#endif
+}
+#endif
+
+static inline void futexWait(int* address, int expected) {
+    my_raw_syscall(__NR_futex, (long) address, FUTEX_WAIT_PRIVATE, expected);
+}
+
+static inline void futexWake(int* address, int count) {
+    my_raw_syscall(__NR_futex, (long) address, FUTEX_WAKE_PRIVATE, count);
+}
+
+// Owner only. The release store of bottom publishes the slot, and the job behind it, to thieves
+static bool dequePush(PoolDeque* deque, PoolSlot* slot) {
+    long bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED);
+    long top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    if (bottom - top >= POOL_DEQUE_SIZE) {
+        return false;
+    }
+
+    __atomic_store_n(&deque->items[bottom & (POOL_DEQUE_SIZE - 1)], slot, __ATOMIC_RELAXED);
+    __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+// Owner only, takes the most recently pushed slot
+static PoolSlot* dequePop(PoolDeque* deque) {
+    long bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&deque->bottom, bottom, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    long top = __atomic_load_n(&deque->top, __ATOMIC_RELAXED);
+
+    if (top > bottom) {
+        __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    PoolSlot* slot = __atomic_load_n(&deque->items[bottom & (POOL_DEQUE_SIZE - 1)], __ATOMIC_RELAXED);
+    if (top == bottom) {
+        // Last one left, thieves may be after it too
+        if (!__atomic_compare_exchange_n(&deque->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+            slot = NULL;
+        }
+        __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+    }
+    return slot;
+}
+
+// Any thread, takes the oldest slot. Losing the race to another thread sets retry
+static PoolSlot* dequeSteal(PoolDeque* deque, bool& retry) {
+    long top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    long bottom = __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE);
+    if (top >= bottom) {
+        return NULL;
+    }
+
+    PoolSlot* slot = __atomic_load_n(&deque->items[top & (POOL_DEQUE_SIZE - 1)], __ATOMIC_RELAXED);
+    if (!__atomic_compare_exchange_n(&deque->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+        retry = true;
+        return NULL;
+    }
+    return slot;
+}
+
+// Our own deque first, then the others in turn
+static PoolSlot* takeWork(size_t self) {
+    PoolSlot* slot = dequePop(&pool.deques[self]);
+    if (slot) {
+        return slot;
+    }
+
+    size_t threads = __atomic_load_n(&pool.threads, __ATOMIC_ACQUIRE);
+    for (size_t i = 1; i < threads; i++) {
+        PoolDeque* victim = &pool.deques[(self + i) % threads];
+        bool retry;
+        do {
+            retry = false;
+            slot = dequeSteal(victim, retry);
+        } while (retry);
+
+        if (slot) {
+            return slot;
+        }
+    }
+
+    return NULL;
+}
+
+static void runSlot(PoolSlot* slot) {
+    PoolJob* job = slot->job;
+    for (;;) {
+        size_t index = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+        if (index >= job->count) {
+            break;
+        }
+        job->task(job->ctx, index, slot->worker);
+    }
+
+    // The submitter may return as soon as this reaches zero, only the address is used after that
+    int* pending = &job->pending;
+    if (__atomic_sub_fetch(pending, 1, __ATOMIC_RELEASE) == 0) {
+        futexWake(pending, INT_MAX);
+    }
+}
+
+#if defined(POOL_HAS_CLONE)
+static void runWorker(void* arg) {
+    size_t self = (size_t) (uintptr_t) arg;
+
+    // Signals sent to the process must not land on a thread bionic doesn't know about
+    uint64_t blocked = ~0ULL;
+    my_raw_syscall(__NR_rt_sigprocmask, SIG_SETMASK, (long) &blocked, 0, sizeof(blocked));
+
+    for (;;) {
+        PoolSlot* slot = takeWork(self);
+        if (slot) {
+            runSlot(slot);
+            continue;
+        }
+
+        // Look again after reading the counter, a submission in between changes it and the wait returns at once
+        int seen = __atomic_load_n(&pool.wakeups, __ATOMIC_SEQ_CST);
+        slot = takeWork(self);
+        if (slot) {
+            runSlot(slot);
+            continue;
+        }
+        futexWait(&pool.wakeups, seen);
+    }
+}
+#endif
+
+static void startPool() {
+    size_t threads = (size_t) my_nprocs();
+    if (threads > MY_POOL_MAX_THREADS) threads = MY_POOL_MAX_THREADS;
+
+    __atomic_store_n(&pool.threads, 1, __ATOMIC_RELEASE);
+
+#if defined(POOL_HAS_CLONE)
+    for (size_t i = 1; i < threads; i++) {
+        // The guard sits below the stack, overflowing it faults rather than running into another mapping.
+        // The TLS block goes above, out of the way of the stack growing down
+        size_t size = POOL_GUARD_SIZE + POOL_STACK_SIZE + POOL_TLS_SIZE;
+        void* mapping = my_mmap(NULL, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+        if (mapping == MAP_FAILED) {
+            break;
+        }
+
+        uintptr_t stackLow = (uintptr_t) mapping + POOL_GUARD_SIZE;
+        if (my_mprotect((void*) stackLow, POOL_STACK_SIZE + POOL_TLS_SIZE, PROT_READ | PROT_WRITE) < 0) {
+            my_munmap(mapping, size);
+            break;
+        }
+
+        pool.workers[i].stackLow = stackLow;
+        pool.workers[i].stackHigh = stackLow + POOL_STACK_SIZE;
+
+        void* tls = setUpWorkerTls(pool.workers[i].stackHigh);
+        if (tls == NULL || cloneThread((void*) pool.workers[i].stackHigh, tls, runWorker, (void*) (uintptr_t) i) < 0) {
+            my_munmap(mapping, size);
+            break;
+        }
+
+        __atomic_store_n(&pool.threads, i + 1, __ATOMIC_RELEASE);
+    }
+#endif
+}
+
+size_t my_pool_threads() {
+    for (;;) {
+        int state = __atomic_load_n(&pool.state, __ATOMIC_ACQUIRE);
+        if (state == POOL_READY) {
+            return pool.threads;
+        }
+
+        int expected = POOL_IDLE;
+        if (state == POOL_IDLE && __atomic_compare_exchange_n(&pool.state, &expected, POOL_STARTING, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            startPool();
+            __atomic_store_n(&pool.state, POOL_READY, __ATOMIC_RELEASE);
+            return pool.threads;
+        }
+
+        // Someone else is starting it, every caller has to agree on the thread count
+        my_raw_syscall(__NR_sched_yield);
+    }
+}
+
+// Index of the worker running on this stack, 0 for any other thread. Workers are told apart by their stacks since
+// their TLS is a copy of another thread's
+static size_t workerIndex() {
+    char marker;
+    uintptr_t sp = (uintptr_t) &marker;
+    size_t threads = __atomic_load_n(&pool.threads, __ATOMIC_ACQUIRE);
+    for (size_t i = 1; i < threads; i++) {
+        if (sp >= pool.workers[i].stackLow && sp < pool.workers[i].stackHigh) {
+            return i;
+        }
+    }
+    return 0;
+}
+
+bool my_pool_is_worker() {
+    return workerIndex() != 0;
+}
+
+// Deque this thread owns, outside threads share deque 0 one at a time. Returns -1 when it's taken
+static int acquireDeque() {
+    size_t worker = workerIndex();
+    if (worker != 0) {
+        return (int) worker;
+    }
+
+    int tid = (int) my_raw_syscall(__NR_gettid);
+    int owner = 0;
+    if (!__atomic_compare_exchange_n(&pool.callerTid, &owner, tid, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED) && owner != tid) {
+        return -1;
+    }
+
+    // Only the owner gets here, a task it runs may submit again
+    pool.callerDepth++;
+    return 0;
+}
+
+static void releaseDeque(int self) {
+    if (self == 0 && --pool.callerDepth == 0) {
+        __atomic_store_n(&pool.callerTid, 0, __ATOMIC_RELEASE);
+    }
+}
+
+void my_pool_run(MyPoolTask task, void* ctx, size_t count) {
+    if (count == 0) {
+        return;
+    }
+
+    size_t threads = my_pool_threads();
+    if (threads > count) threads = count;
+
+    int self = threads > 1 ? acquireDeque() : -1;
+    if (self < 0) {
+        for (size_t i = 0; i < count; i++) {
+            task(ctx, i, 0);
+        }
+        return;
+    }
+
+    PoolJob job;
+    job.task = task;
+    job.ctx = ctx;
+    job.count = count;
+    job.next = 0;
+    job.pending = (int) threads;
+    for (size_t i = 0; i < threads; i++) {
+        job.slots[i].job = &job;
+        job.slots[i].worker = i;
+    }
+
+    // Slot 0 is ours, the others wait in our deque for whoever comes first, which may be us again
+    for (size_t i = 1; i < threads; i++) {
+        if (!dequePush(&pool.deques[self], &job.slots[i])) {
+            __atomic_sub_fetch(&job.pending, (int) (threads - i), __ATOMIC_RELEASE);
+            break;
+        }
+    }
+
+    __atomic_fetch_add(&pool.wakeups, 1, __ATOMIC_SEQ_CST);
+    futexWake(&pool.wakeups, (int) threads - 1);
+
+    runSlot(&job.slots[0]);
+
+    // Slots taken by other threads may still be running, help with whatever work there is in the meantime
+    for (;;) {
+        int pending = __atomic_load_n(&job.pending, __ATOMIC_ACQUIRE);
+        if (pending == 0) {
+            break;
+        }
+
+        PoolSlot* slot = takeWork((size_t) self);
+        if (slot) {
+            runSlot(slot);
+            continue;
+        }
+        futexWait(&job.pending, pending);
+    }
+
+    releaseDeque(self);
+}
@@ -0,0 +1,220 @@
+// Checks the mylibc syscall wrappers against glibc on the host: same results on success, -1 on failure where glibc
+// sets errno, and errno left alone. Offsets past 4 GiB go through the split 64-bit arguments of 32-bit ABIs
+//
+// Linux only, built with the host tools (see CMakeLists.txt)
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/mman.h>
+
+#include "mylibc.h"
+
+#define PAGE 4096
+#define HIGH_OFFSET (5LL * 1024 * 1024 * 1024 + 3 * PAGE) // Past 4 GiB and page aligned, for mmap
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        failures++; \
+    } \
+} while (0)
+
+// A failing wrapper must not touch errno, it's the calling thread's and workers have none
+#define CHECK_FAILS_QUIETLY(call) do { \
+    errno = 12345; \
+    CHECK((call) == -1); \
+    CHECK(errno == 12345); \
+} while (0)
+
+static unsigned char pattern(off64_t offset) {
+    return (unsigned char) (offset * 131 + (offset >> 12));
+}
+
+static void fillPattern(unsigned char* buffer, size_t size, off64_t offset) {
+    for (size_t i = 0; i < size; i++)
+        buffer[i] = pattern(offset + (off64_t) i);
+}
+
+// Three pages and a bit at the start, two pages at HIGH_OFFSET with a hole in between
+static int createTestFile(char* path) {
+    int fd = mkstemp(path);
+    if (fd < 0)
+        return -1;
+
+    unsigned char buffer[3 * PAGE + 100];
+    fillPattern(buffer, sizeof(buffer), 0);
+    if (pwrite64(fd, buffer, sizeof(buffer), 0) != (ssize_t) sizeof(buffer))
+        return -1;
+
+    fillPattern(buffer, 2 * PAGE, HIGH_OFFSET);
+    if (pwrite64(fd, buffer, 2 * PAGE, HIGH_OFFSET) != 2 * PAGE)
+        return -1;
+
+    return fd;
+}
+
+static void testPread(int fd) {
+    static const off64_t offsets[] = { 0, 1, PAGE - 7, 3 * PAGE, HIGH_OFFSET, HIGH_OFFSET + PAGE + 11 };
+    for (off64_t offset : offsets) {
+        unsigned char mine[PAGE + 64], theirs[PAGE + 64];
+        ssize_t expected = pread64(fd, theirs, sizeof(theirs), offset);
+        CHECK(my_pread64(fd, mine, sizeof(mine), offset) == expected);
+        CHECK(expected > 0 && memcmp(mine, theirs, (size_t) expected) == 0);
+    }
+
+    // Past the end
+    unsigned char byte;
+    CHECK(my_pread64(fd, &byte, 1, HIGH_OFFSET + 2 * PAGE) == 0);
+
+    CHECK_FAILS_QUIETLY(my_pread64(-1, &byte, 1, 0));
+    CHECK_FAILS_QUIETLY(my_pread64(fd, &byte, 1, -1));
+}
+
+static void testPreadv(int fd) {
+    static const off64_t offsets[] = { 5, HIGH_OFFSET + 3 };
+    for (off64_t offset : offsets) {
+        unsigned char mine[3][700], theirs[3][700];
+        struct iovec mineIov[3], theirsIov[3];
+        for (int i = 0; i < 3; i++) {
+            mineIov[i] = { mine[i], (size_t) (300 + 200 * i) };
+            theirsIov[i] = { theirs[i], (size_t) (300 + 200 * i) };
+        }
+
+        ssize_t expected = preadv64(fd, theirsIov, 3, offset);
+        CHECK(expected == 1500);
+        CHECK(my_preadv(fd, mineIov, 3, offset) == expected);
+        for (int i = 0; i < 3; i++)
+            CHECK(memcmp(mine[i], theirs[i], mineIov[i].iov_len) == 0);
+    }
+
+    struct iovec iov = { NULL, 0 };
+    CHECK_FAILS_QUIETLY(my_preadv(-1, &iov, 1, 0));
+}
+
+static void testFstat(int fd) {
+    struct stat mine, theirs;
+    CHECK(fstat(fd, &theirs) == 0);
+    CHECK(my_fstat(fd, &mine) == 0);
+    CHECK(mine.st_dev == theirs.st_dev);
+    CHECK(mine.st_ino == theirs.st_ino);
+    CHECK(mine.st_mode == theirs.st_mode);
+    CHECK(mine.st_size == theirs.st_size);
+    CHECK(mine.st_size == HIGH_OFFSET + 2 * PAGE);
+    CHECK(mine.st_mtim.tv_sec == theirs.st_mtim.tv_sec && mine.st_mtim.tv_nsec == theirs.st_mtim.tv_nsec);
+
+    CHECK_FAILS_QUIETLY(my_fstat(-1, &mine));
+}
+
+static void testStatx(int fd, const char* path) {
+    struct statx mine, theirs;
+    if (statx(AT_FDCWD, path, 0, STATX_BASIC_STATS, &theirs) < 0) {
+        // Nothing to compare with, the wrapper has to fail the same way
+        CHECK_FAILS_QUIETLY(my_statx(AT_FDCWD, path, 0, STATX_BASIC_STATS, &mine));
+        return;
+    }
+
+    CHECK(my_statx(AT_FDCWD, path, 0, STATX_BASIC_STATS, &mine) == 0);
+    CHECK(mine.stx_ino == theirs.stx_ino);
+    CHECK(mine.stx_size == theirs.stx_size);
+    CHECK(mine.stx_dev_major == theirs.stx_dev_major && mine.stx_dev_minor == theirs.stx_dev_minor);
+    CHECK(mine.stx_mtime.tv_sec == theirs.stx_mtime.tv_sec && mine.stx_mtime.tv_nsec == theirs.stx_mtime.tv_nsec);
+
+    // Through the descriptor, the way APKs are checked
+    CHECK(my_statx(fd, "", AT_EMPTY_PATH, STATX_BASIC_STATS, &mine) == 0);
+    CHECK(mine.stx_ino == theirs.stx_ino);
+
+    CHECK_FAILS_QUIETLY(my_statx(AT_FDCWD, "/nonexistent/droidgrity", 0, STATX_BASIC_STATS, &mine));
+}
+
+static void testMmap(int fd) {
+    static const off64_t offsets[] = { 0, PAGE, HIGH_OFFSET };
+    for (off64_t offset : offsets) {
+        void* mine = my_mmap(NULL, 2 * PAGE, PROT_READ, MAP_PRIVATE, fd, offset);
+        void* theirs = mmap64(NULL, 2 * PAGE, PROT_READ, MAP_PRIVATE, fd, offset);
+        CHECK(mine != MAP_FAILED && theirs != MAP_FAILED);
+        if (mine != MAP_FAILED && theirs != MAP_FAILED)
+            CHECK(memcmp(mine, theirs, 2 * PAGE) == 0);
+
+        CHECK(my_munmap(mine, 2 * PAGE) == 0);
+        munmap(theirs, 2 * PAGE);
+    }
+
+    // Unaligned offset, MAP_FAILED is -1 as well
+    errno = 12345;
+    CHECK(my_mmap(NULL, PAGE, PROT_READ, MAP_PRIVATE, fd, 1) == MAP_FAILED);
+    CHECK(errno == 12345);
+}
+
+static void testMadvise(int fd) {
+    void* data = my_mmap(NULL, 3 * PAGE, PROT_READ, MAP_PRIVATE, fd, 0);
+    CHECK(data != MAP_FAILED);
+
+    static const int advices[] = { MADV_SEQUENTIAL, MADV_WILLNEED, MADV_NORMAL };
+    for (int advice : advices) {
+        CHECK(madvise(data, 3 * PAGE, advice) == 0);
+        CHECK(my_madvise(data, 3 * PAGE, advice) == 0);
+    }
+
+    // Unaligned address
+    CHECK(madvise((char*) data + 1, PAGE, MADV_WILLNEED) == -1);
+    CHECK_FAILS_QUIETLY(my_madvise((char*) data + 1, PAGE, MADV_WILLNEED));
+
+    my_munmap(data, 3 * PAGE);
+}
+
+static void testReadahead(int fd) {
+    static const off64_t offsets[] = { 0, HIGH_OFFSET };
+    for (off64_t offset : offsets) {
+        CHECK(readahead(fd, offset, 2 * PAGE) == 0);
+        CHECK(my_readahead(fd, offset, 2 * PAGE) == 0);
+    }
+
+    CHECK(readahead(-1, 0, PAGE) == -1);
+    CHECK_FAILS_QUIETLY(my_readahead(-1, 0, PAGE));
+}
+
+static void testFadvise(int fd) {
+    static const int advices[] = { POSIX_FADV_SEQUENTIAL, POSIX_FADV_WILLNEED, POSIX_FADV_NORMAL };
+    for (int advice : advices) {
+        // posix_fadvise returns the error rather than setting errno
+        CHECK(posix_fadvise64(fd, HIGH_OFFSET, 2 * PAGE, advice) == 0);
+        CHECK(my_fadvise64(fd, HIGH_OFFSET, 2 * PAGE, advice) == 0);
+    }
+
+    CHECK(posix_fadvise64(-1, 0, PAGE, POSIX_FADV_NORMAL) == EBADF);
+    CHECK_FAILS_QUIETLY(my_fadvise64(-1, 0, PAGE, POSIX_FADV_NORMAL));
+    CHECK(posix_fadvise64(fd, 0, PAGE, 12345) == EINVAL);
+    CHECK_FAILS_QUIETLY(my_fadvise64(fd, 0, PAGE, 12345));
+}
+
+int main() {
+    char path[] = "/tmp/mylibc_syscalls_XXXXXX";
+    int fd = createTestFile(path);
+    if (fd < 0) {
+        perror("Failed to create the test file");
+        return 1;
+    }
+
+    testPread(fd);
+    testPreadv(fd);
+    testFstat(fd);
+    testStatx(fd, path);
+    testMmap(fd);
+    testMadvise(fd);
+    testReadahead(fd);
+    testFadvise(fd);
+
+    close(fd);
+    unlink(path);
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+
+    printf("All syscall wrappers match glibc\n");
+    return 0;
+}